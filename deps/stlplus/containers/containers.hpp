@@ -14,7 +14,9 @@
 #include "digraph.hpp"
 #include "hash.hpp"
 #include "matrix.hpp"
+#include "sparse_matrix.hpp"
 #include "ntree.hpp"
+#include "task_pool.hpp"
 
 #include "smart_ptr.hpp"
 #include "simple_ptr.hpp"
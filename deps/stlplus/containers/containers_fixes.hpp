@@ -36,5 +36,24 @@
 #pragma warn -8027
 #endif
 
+////////////////////////////////////////////////////////////////////////////////
+// Rules for testing whether this compiler has C++11 extensions (especially threads and atomics)
+// Specifically I only support use of these extensions in their final, standard form
+////////////////////////////////////////////////////////////////////////////////
+
+// gcc
+// in normal mode, the extensions are not supported
+// However, gcc has a C++11 mode and then they are supported
+// C++11 mode is switched on from the command line using the -std=c++11 flag and that sets the following macro
+#if defined(__GNUC__) && (__cplusplus > 201100)
+#define STLPLUS_HAS_CXX11 1
+#endif
+
+// Visual Studio
+// Microsoft only incorporated the threading extensions from Visual Studio 2012 (v17.00)
+#if defined(_MSC_VER) && (_MSC_VER >= 1700)
+#define STLPLUS_HAS_CXX11 1
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////
 #endif
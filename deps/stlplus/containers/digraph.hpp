@@ -14,6 +14,8 @@
 #include "containers_fixes.hpp"
 #include "safe_iterator.hpp"
 #include "exceptions.hpp"
+#include "task_pool.hpp"
+#include "triple.hpp"
 #include <vector>
 #include <map>
 #include <set>
@@ -28,6 +30,7 @@ namespace stlplus
   template<typename NT, typename AT> class digraph_node;
   template<typename NT, typename AT> class digraph_arc;
   template<typename NT, typename AT> class digraph;
+  template<typename T> class digraph_pool;
 
   ////////////////////////////////////////////////////////////////////////////////
   // The Digraph iterator classes
@@ -163,6 +166,56 @@ namespace stlplus
     explicit digraph_arc_iterator(const safe_iterator<digraph<NT,AT>, digraph_arc<NT,AT> >& iterator);
   };
 
+  ////////////////////////////////////////////////////////////////////////////////
+  // The Digraph path enumerator
+  // steps through the paths from one node to another one at a time, rather than
+  // collecting every path as all_paths does - only the current path is held, so
+  // the memory used depends on the length of a path, not on the number of paths
+  // Create one with digraph<NT,AT>::paths() and use it in the form:
+  //   for (digraph<NT,AT>::path_enumerator p = graph.paths(from,to); p.next(); )
+  //     ... p.path() ...
+  // The enumeration can be abandoned at any point
+  // The graph must not be changed whilst an enumeration is in progress
+
+  template<typename NT, typename AT>
+  class digraph_path_enumerator
+  {
+  public:
+    typedef std::vector<digraph_arc_iterator<NT,AT,const AT&,const AT*> > const_arc_vector;
+    typedef bool (*arc_select_fn) (const digraph<NT,AT>&, digraph_arc_iterator<NT,AT,const AT&,const AT*>);
+
+    // create an enumerator with no paths
+    digraph_path_enumerator(void);
+
+    // step on to the next path
+    // returns false when there are no more paths or the path limit has been reached
+    bool next(void);
+
+    // the current path - only valid after next() has returned true
+    const const_arc_vector& path(void) const;
+
+    // the number of paths found so far
+    unsigned count(void) const;
+
+  private:
+    friend class digraph<NT,AT>;
+
+    digraph_path_enumerator(const digraph<NT,AT>* graph, digraph_node<NT,AT>* from, digraph_node<NT,AT>* to,
+                            arc_select_fn select, unsigned max_length, unsigned max_paths);
+
+    const digraph<NT,AT>* m_graph;
+    digraph_node<NT,AT>* m_to;
+    arc_select_fn m_select;
+    unsigned m_max_length;
+    unsigned m_max_paths;
+    unsigned m_count;
+    // the depth-first traversal: each node on the current route and the next of its outputs to try
+    std::vector<std::pair<digraph_node<NT,AT>*,unsigned> > m_stack;
+    // the arcs of the current route, one fewer than the nodes on the stack
+    std::vector<digraph_arc<NT,AT>*> m_route;
+    const_arc_vector m_path;
+  };
+
   ////////////////////////////////////////////////////////////////////////////////
   // The Graph class
   // NT is the Node type and AT is the Arc type
@@ -216,6 +269,19 @@ namespace stlplus
     // exceptions: wrong_object,null_dereference,end_dereference
     node_vector deconstify_nodes(const const_node_vector&) const;
 
+    // a component vector is a vector of node sets used to represent a partitioning of the graph
+    typedef std::vector<node_vector> component_vector;
+    typedef std::vector<const_node_vector> const_component_vector;
+
+    // enumerator for stepping through the paths between two nodes, see paths()
+    typedef digraph_path_enumerator<NT,AT> path_enumerator;
+
+    // the condensation is a graph of the strongly connected components of this graph
+    // each node contains the set of nodes in one component and each arc
+    // contains the set of arcs going from one component to another
+    typedef digraph<const_node_vector,const_arc_vector> const_condensation;
+    typedef digraph<node_vector,arc_vector> condensation;
+
     // callback used in the path algorithms to select which arcs to consider
     typedef bool (*arc_select_fn) (const digraph<NT,AT>&, const_arc_iterator);
 
@@ -256,6 +322,19 @@ namespace stlplus
     // remove all nodes
     void clear(void);
 
+    // a list of arcs for building a graph in one go - each edge contains the
+    // positions of its from and to nodes in the node data and the arc data
+    typedef triple<unsigned,unsigned,AT> edge_type;
+    typedef std::vector<edge_type> edge_vector;
+
+    // replace the contents of the graph with the given nodes and arcs
+    // this is much faster than inserting each node and arc in turn because the
+    // space for all of them and for every node's inputs and outputs is
+    // allocated up front
+    // returns the new nodes in the same order as the node data
+    // exceptions: std::out_of_range if an edge refers to a node that doesn't exist
+    node_vector build(const std::vector<NT>& nodes, const edge_vector& edges);
+
     // traverse all the nodes in no particular order using STL-style iteration
     const_iterator begin(void) const;
     iterator begin(void);
@@ -399,6 +478,25 @@ namespace stlplus
     // exceptions: wrong_object,null_dereference,end_dereference
     node_vector output_adjacencies(iterator from);
 
+    ////////////////////////////////////////////////////////////////////////////////
+    // Strongly Connected Components
+    // A strongly connected component is a maximal set of nodes in which every
+    // node has a path to every other node. Every cycle in the graph lies
+    // within one component, so a DAG has one component per node.
+    // These algorithms run in linear time and are not recursive, so are safe on very large graphs.
+
+    // get the set of strongly connected components
+    // the components are in topographical order, i.e. no arc goes from a component to an earlier one
+    const_component_vector strongly_connected_components(arc_select_fn = 0) const;
+    component_vector strongly_connected_components(arc_select_fn = 0);
+
+    // get the condensation of the graph, which is the DAG formed by collapsing
+    // each strongly connected component into a single node
+    // the nodes of the condensation are in the same order as strongly_connected_components()
+    // arcs within a component are not represented in the condensation
+    const_condensation condense(arc_select_fn = 0) const;
+    condensation condense(arc_select_fn = 0);
+
     ////////////////////////////////////////////////////////////////////////////////
     // Topographical Sort Algorithm
     // This generates a node ordering such that each node is visited after its fanin nodes.
@@ -410,6 +508,10 @@ namespace stlplus
     //  - the arc vector is the set of backward arcs that were broken to achieve the sort
     // If the arc vector is empty then the graph formed a DAG.
 
+    // The sort is based on the condensation so runs in linear time even if
+    // the graph has large cycles. Only arcs within a strongly connected
+    // component are ever broken.
+
     // The arc selection callback can be used to ignore arcs that are not part
     // of the ordering, i.e. arcs that are meant to be backwards arcs
 
@@ -424,6 +526,36 @@ namespace stlplus
     const_node_vector dag_sort(arc_select_fn = 0) const;
     node_vector dag_sort(arc_select_fn = 0);
 
+    ////////////////////////////////////////////////////////////////////////////////
+    // Levelling and Parallel Execution of a DAG
+    // These use Kahn's algorithm, which repeatedly removes the nodes that have
+    // no remaining fanin. Like dag_sort they only work on a Directed Acyclic Graph.
+
+    // get the levels of the graph - level 0 is the nodes with no fanin and
+    // every other node is in the level after the last of its fanin nodes
+    // no arc connects two nodes in the same level, so all the nodes in a level
+    // can be processed at once when the earlier levels are complete
+    // If the graph is not a DAG, the result is empty
+    const_component_vector levels(arc_select_fn = 0) const;
+    component_vector levels(arc_select_fn = 0);
+
+    // call fn(graph,iterator) once for every node, each node only being called
+    // when all of its fanin nodes have completed
+    // Nodes are run on a pool of worker threads (0 means one per hardware
+    // thread) as soon as they become ready rather than level by level, so a
+    // slow node only holds up the nodes that depend on it.
+    // fn and the arc select callback are called from several threads at once
+    // and must not change the structure of the graph
+    // Iterators to a node or arc share a reference count that is not
+    // thread-safe, so fn may use the iterator it is given but must not make
+    // iterators to other nodes or arcs, such as its inputs, that other calls
+    // may be using at the same time
+    // If fn throws, no more nodes are started and the first exception is rethrown
+    // Without C++11 threads the nodes are called in turn in dag_sort order
+    // exceptions: std::invalid_argument if the graph is not a DAG
+    template<typename F>
+    void parallel_execute(F fn, unsigned threads = 0, arc_select_fn = 0);
+
     ////////////////////////////////////////////////////////////////////////////////
     // Basic Path Algorithms
     // A path is a series of arcs - you can use arc_from and arc_to to convert
@@ -452,6 +584,19 @@ namespace stlplus
     // exceptions: wrong_object,null_dereference,end_dereference
     path_vector all_paths(iterator from, iterator to, arc_select_fn = 0);
 
+    // step through the same paths as all_paths one at a time, so that the
+    // paths can be processed without storing them all and the search can be
+    // stopped early
+    // max_length limits the number of arcs in a path and max_paths limits the
+    // number of paths found, with 0 meaning no limit
+    // the paths are of const arcs - use deconstify_arcs to convert them
+    // exceptions: wrong_object,null_dereference,end_dereference
+    path_enumerator paths(const_iterator from, const_iterator to, arc_select_fn = 0,
+                          unsigned max_length = 0, unsigned max_paths = 0) const;
+    // exceptions: wrong_object,null_dereference,end_dereference
+    path_enumerator paths(iterator from, iterator to, arc_select_fn = 0,
+                          unsigned max_length = 0, unsigned max_paths = 0);
+
     // get the set of all nodes that can be reached by any path from from
     // exceptions: wrong_object,null_dereference,end_dereference
     const_node_vector reachable_nodes(const_iterator from, arc_select_fn = 0) const;
@@ -487,6 +632,44 @@ namespace stlplus
     // exceptions: wrong_object,null_dereference,end_dereference
     path_vector shortest_paths(iterator from, arc_select_fn = 0);
 
+    ////////////////////////////////////////////////////////////////////////////////
+    // Weighted Shortest path algorithms
+
+    // callback used in the weighted path algorithms to give the cost of traversing an arc
+    // weights must not be negative
+    typedef double (*arc_weight_fn) (const digraph<NT,AT>&, const_arc_iterator);
+
+    // callback used in the A* algorithm to estimate the cost of the remaining path from node to target
+    // the estimate must never exceed the real cost, otherwise the path found may not be the shortest
+    typedef double (*node_heuristic_fn) (const digraph<NT,AT>&, const_iterator node, const_iterator target);
+
+    // ready-made weight callback for graphs where the arc data is the weight
+    // AT must be convertible to double. Use in the form digraph<NT,AT>::arc_data_weight
+    static double arc_data_weight(const digraph<NT,AT>&, const_arc_iterator);
+
+    // find the lowest-cost path from from to to using Dijkstra's algorithm
+    // if there is more than one lowest-cost path it returns the first one found
+    // If there are no paths, returns an empty path
+    // exceptions: wrong_object,null_dereference,end_dereference,std::invalid_argument
+    const_arc_vector weighted_shortest_path(const_iterator from, const_iterator to, arc_weight_fn, arc_select_fn = 0) const;
+    // exceptions: wrong_object,null_dereference,end_dereference,std::invalid_argument
+    arc_vector weighted_shortest_path(iterator from, iterator to, arc_weight_fn, arc_select_fn = 0);
+
+    // find the set of lowest-cost paths from from to every other node that is reachable
+    // If there are no paths, returns an empty list
+    // exceptions: wrong_object,null_dereference,end_dereference,std::invalid_argument
+    const_path_vector weighted_shortest_paths(const_iterator from, arc_weight_fn, arc_select_fn = 0) const;
+    // exceptions: wrong_object,null_dereference,end_dereference,std::invalid_argument
+    path_vector weighted_shortest_paths(iterator from, arc_weight_fn, arc_select_fn = 0);
+
+    // find the lowest-cost path from from to to using the A* algorithm, which
+    // uses the heuristic to visit the most promising nodes first
+    // If there are no paths, returns an empty path
+    // exceptions: wrong_object,null_dereference,end_dereference,std::invalid_argument
+    const_arc_vector astar_path(const_iterator from, const_iterator to, arc_weight_fn, node_heuristic_fn, arc_select_fn = 0) const;
+    // exceptions: wrong_object,null_dereference,end_dereference,std::invalid_argument
+    arc_vector astar_path(iterator from, iterator to, arc_weight_fn, node_heuristic_fn, arc_select_fn = 0);
+
   private:
     friend class digraph_iterator<NT,AT,NT&,NT*>;
     friend class digraph_iterator<NT,AT,const NT&,const NT*>;
@@ -499,19 +682,50 @@ namespace stlplus
     // exceptions: wrong_object,null_dereference,end_dereference
     bool path_exists_r(const_iterator from, const_iterator to, const_iterator_set& visited, arc_select_fn) const;
 
-    // exceptions: wrong_object,null_dereference,end_dereference
-    void all_paths_r(const_iterator from, const_iterator to, const_arc_vector& so_far, const_path_vector& result, arc_select_fn) const;
-
     // exceptions: wrong_object,null_dereference,end_dereference
     void reachable_nodes_r(const_iterator from, const_iterator_set& visited, arc_select_fn) const;
 
     // exceptions: wrong_object,null_dereference,end_dereference
     void reaching_nodes_r(const_iterator to, const_iterator_set& visited, arc_select_fn) const;
 
+    // common part of the strongly connected component algorithms - numbers
+    // the component of every node, indexed by node index, in topographical
+    // order and returns the number of components
+    unsigned strong_components(std::vector<unsigned>& components, arc_select_fn) const;
+
+    // common part of the levelling algorithms - finds the level and the
+    // number of selected inputs of every node, indexed by node index, and
+    // returns the number of levels or npos if the graph is not a DAG
+    unsigned kahn_levels(std::vector<unsigned>& levels, std::vector<unsigned>& fanins, arc_select_fn) const;
+
+    // common part of the weighted path algorithms - finds the lowest-cost
+    // predecessor arc of every node visited, indexed by node index
+    // the search stops early when to is reached, pass end() to visit the whole graph
+    // exceptions: wrong_object,null_dereference,end_dereference,std::invalid_argument
+    void weighted_search(const_iterator from, const_iterator to, arc_weight_fn, node_heuristic_fn, arc_select_fn,
+                         std::vector<digraph_arc<NT,AT>*>& predecessors) const;
+    // convert the predecessors found by weighted_search into the path ending at to
+    const_arc_vector weighted_path(const_iterator to, const std::vector<digraph_arc<NT,AT>*>& predecessors) const;
+
+    // allocate and free nodes and arcs from the graph's pools
+    digraph_node<NT,AT>* create_node(const NT& node_data);
+    void destroy_node(digraph_node<NT,AT>*);
+    digraph_arc<NT,AT>* create_arc(digraph_node<NT,AT>* from, digraph_node<NT,AT>* to, const AT& arc_data);
+    void destroy_arc(digraph_arc<NT,AT>*);
+    // add a new node or arc to the end of the lists
+    void link_node(digraph_node<NT,AT>*);
+    void link_arc(digraph_arc<NT,AT>*);
+
     digraph_node<NT,AT>* m_nodes_begin;
     digraph_node<NT,AT>* m_nodes_end;
     digraph_arc<NT,AT>* m_arcs_begin;
     digraph_arc<NT,AT>* m_arcs_end;
+    // table of all the nodes, so that each node has a dense index in the range 0..size-1
+    // this is what allows the graph algorithms to use flat arrays rather than maps
+    std::vector<digraph_node<NT,AT>*> m_node_table;
+    // the nodes and arcs are allocated in blocks from these pools rather than one at a time
+    digraph_pool<digraph_node<NT,AT> > m_node_pool;
+    digraph_pool<digraph_arc<NT,AT> > m_arc_pool;
   };
 
   ////////////////////////////////////////////////////////////////////////////////
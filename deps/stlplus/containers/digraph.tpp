@@ -25,6 +25,9 @@
 ////////////////////////////////////////////////////////////////////////////////
 #include <algorithm>
 #include <deque>
+#include <limits>
+#include <new>
+#include <stdexcept>
 
 ////////////////////////////////////////////////////////////////////////////////
 // Internals
@@ -44,8 +47,10 @@ namespace stlplus
     digraph_node<NT,AT>* m_next;
     std::vector<digraph_arc<NT,AT>*> m_inputs;
     std::vector<digraph_arc<NT,AT>*> m_outputs;
+    // position of this node in the owner's node table
+    unsigned m_index;
     digraph_node(const digraph<NT,AT>* owner, const NT& d = NT()) :
-      m_master(owner,this), m_data(d), m_prev(0), m_next(0)
+      m_master(owner,this), m_data(d), m_prev(0), m_next(0), m_index(0)
       {
       }
     ~digraph_node(void)
@@ -71,6 +76,242 @@ namespace stlplus
       }
   };
 
+  // indexed priority queue used by the weighted path algorithms
+  // it holds node indices ordered by a key, smallest key first, and keeps a
+  // table of where each node is in the heap so that the key of a queued node
+  // can be reduced in place - the decrease-key operation of Dijkstra's algorithm
+  // It is a 4-ary heap rather than a binary heap since that is shallower and
+  // the children of a heap entry are adjacent, which suits large graphs better
+  class digraph_heap
+  {
+  public:
+    digraph_heap(unsigned nodes) :
+      m_keys(nodes), m_positions(nodes, npos())
+      {
+      }
+
+    bool empty(void) const
+      {
+        return m_heap.empty();
+      }
+
+    // add a node to the heap, or reduce its key if it is already queued
+    // a node that has been popped can be pushed again
+    void push(unsigned node, double key)
+      {
+        if (m_positions[node] == npos())
+        {
+          m_positions[node] = (unsigned)m_heap.size();
+          m_heap.push_back(node);
+        }
+        else if (key >= m_keys[node])
+          return;
+        m_keys[node] = key;
+        sift_up(m_positions[node]);
+      }
+
+    // remove and return the node with the smallest key
+    unsigned pop(void)
+      {
+        unsigned top = m_heap.front();
+        m_positions[top] = npos();
+        unsigned last = m_heap.back();
+        m_heap.pop_back();
+        if (!m_heap.empty())
+        {
+          m_heap[0] = last;
+          m_positions[last] = 0;
+          sift_down(0);
+        }
+        return top;
+      }
+
+  private:
+    static unsigned npos(void)
+      {
+        return (unsigned)-1;
+      }
+
+    // move an entry towards the root until its parent has a smaller key
+    void sift_up(unsigned i)
+      {
+        unsigned node = m_heap[i];
+        double key = m_keys[node];
+        while (i > 0)
+        {
+          unsigned parent = (i - 1) / 4;
+          if (m_keys[m_heap[parent]] <= key) break;
+          m_heap[i] = m_heap[parent];
+          m_positions[m_heap[i]] = i;
+          i = parent;
+        }
+        m_heap[i] = node;
+        m_positions[node] = i;
+      }
+
+    // move an entry towards the leaves until all its children have larger keys
+    void sift_down(unsigned i)
+      {
+        unsigned node = m_heap[i];
+        double key = m_keys[node];
+        unsigned size = (unsigned)m_heap.size();
+        for (;;)
+        {
+          unsigned first = 4 * i + 1;
+          if (first >= size) break;
+          unsigned last = std::min(first + 4, size);
+          unsigned smallest = first;
+          for (unsigned c = first + 1; c < last; c++)
+            if (m_keys[m_heap[c]] < m_keys[m_heap[smallest]])
+              smallest = c;
+          if (key <= m_keys[m_heap[smallest]]) break;
+          m_heap[i] = m_heap[smallest];
+          m_positions[m_heap[i]] = i;
+          i = smallest;
+        }
+        m_heap[i] = node;
+        m_positions[node] = i;
+      }
+
+    std::vector<double> m_keys;
+    std::vector<unsigned> m_positions;
+    std::vector<unsigned> m_heap;
+  };
+
+  // slab allocator used for the nodes and arcs of a graph
+  // objects are carved out of large blocks rather than being allocated one at
+  // a time, and the space of destroyed objects is kept on a free list for
+  // reuse. Blocks are only released by clear() or the destructor, which must
+  // only be called when all the objects have been destroyed. One pool can take
+  // over all the blocks of another, which is how move() takes over the nodes
+  // and arcs of the source graph without copying them
+  template<typename T>
+  class digraph_pool
+  {
+  public:
+    digraph_pool(void) :
+      m_free(0), m_next(0), m_end(0), m_block_size(16)
+      {
+      }
+
+    ~digraph_pool(void)
+      {
+        clear();
+      }
+
+    // get uninitialised space for one object
+    void* allocate(void)
+      {
+        if (m_free)
+        {
+          slot* result = m_free;
+          m_free = m_free->m_next;
+          return result;
+        }
+        if (m_next == m_end)
+        {
+          new_block(m_block_size);
+          // grow the blocks geometrically so a large graph needs few of them
+          if (m_block_size < 4096) m_block_size *= 2;
+        }
+        return m_next++;
+      }
+
+    // return the space of a destroyed object to the pool
+    void deallocate(void* object)
+      {
+        slot* freed = static_cast<slot*>(object);
+        freed->m_next = m_free;
+        m_free = freed;
+      }
+
+    // make sure that the next n allocations come from one block
+    void reserve(unsigned n)
+      {
+        if ((unsigned)(m_end - m_next) >= n) return;
+        release_remainder();
+        new_block(n);
+      }
+
+    // take over all the space in the source pool, leaving it empty
+    void splice(digraph_pool<T>& source)
+      {
+        source.release_remainder();
+        m_blocks.insert(m_blocks.end(), source.m_blocks.begin(), source.m_blocks.end());
+        source.m_blocks.clear();
+        while (source.m_free)
+        {
+          slot* freed = source.m_free;
+          source.m_free = freed->m_next;
+          deallocate(freed);
+        }
+      }
+
+    // release all the blocks
+    void clear(void)
+      {
+        for (unsigned i = 0; i < m_blocks.size(); i++)
+          ::operator delete(m_blocks[i]);
+        m_blocks.clear();
+        m_free = 0;
+        m_next = 0;
+        m_end = 0;
+        m_block_size = 16;
+      }
+
+  private:
+    // each slot holds either an object or a link in the free list
+    // the extra members make the slot suitably aligned for any fundamental type
+    // and, where alignas is available, for an over-aligned object too
+    union slot
+    {
+      slot* m_next;
+#ifdef STLPLUS_HAS_CXX11
+      alignas(T) char m_data[sizeof(T)];
+#else
+      char m_data[sizeof(T)];
+#endif
+      long m_align_long;
+      double m_align_double;
+      long double m_align_long_double;
+      void* m_align_pointer;
+    };
+
+#ifdef STLPLUS_HAS_CXX11
+    enum {slot_alignment = alignof(slot)};
+#else
+    enum {slot_alignment = 1};
+#endif
+
+    void new_block(unsigned n)
+      {
+        // operator new only aligns for the fundamental types, so an over-aligned
+        // slot is found by rounding up inside a slightly larger block
+        char* block = static_cast<char*>(::operator new(n * sizeof(slot) + slot_alignment - 1));
+        m_blocks.push_back(block);
+        size_t misalignment = reinterpret_cast<size_t>(block) % slot_alignment;
+        m_next = reinterpret_cast<slot*>(misalignment ? block + slot_alignment - misalignment : block);
+        m_end = m_next + n;
+      }
+
+    // put the unused part of the current block on the free list
+    void release_remainder(void)
+      {
+        while (m_next != m_end)
+          deallocate(m_next++);
+      }
+
+    std::vector<char*> m_blocks;
+    slot* m_free;
+    slot* m_next;
+    slot* m_end;
+    unsigned m_block_size;
+
+    // make this class uncopyable
+    digraph_pool(const digraph_pool<T>&);
+    digraph_pool<T>& operator=(const digraph_pool<T>&);
+  };
+
   ////////////////////////////////////////////////////////////////////////////////
   // Iterators
   ////////////////////////////////////////////////////////////////////////////////
@@ -327,6 +568,81 @@ namespace stlplus
     return &(operator*());
   }
 
+  ////////////////////////////////////////////////////////////////////////////////
+  // Path enumerator
+
+  template<typename NT, typename AT>
+  digraph_path_enumerator<NT,AT>::digraph_path_enumerator(void) :
+    m_graph(0), m_to(0), m_select(0), m_max_length(0), m_max_paths(0), m_count(0)
+  {
+  }
+
+  template<typename NT, typename AT>
+  digraph_path_enumerator<NT,AT>::digraph_path_enumerator(const digraph<NT,AT>* graph,
+                                                          digraph_node<NT,AT>* from,
+                                                          digraph_node<NT,AT>* to,
+                                                          typename digraph_path_enumerator<NT,AT>::arc_select_fn select,
+                                                          unsigned max_length,
+                                                          unsigned max_paths) :
+    m_graph(graph), m_to(to), m_select(select), m_max_length(max_length), m_max_paths(max_paths), m_count(0)
+  {
+    m_stack.push_back(std::make_pair(from, 0u));
+  }
+
+  template<typename NT, typename AT>
+  bool digraph_path_enumerator<NT,AT>::next(void)
+  {
+    // This is the depth-first traversal of all_paths with an explicit stack
+    // in place of the recursion, so that it can be suspended whenever a path
+    // is found and resumed from the same place. As in all_paths, an arc may
+    // only be used once in a path, which stops the traversal going round
+    // cycles, and the path ends when the to node is reached.
+    m_path.clear();
+    if (m_max_paths != 0 && m_count >= m_max_paths)
+      m_stack.clear();
+    while (!m_stack.empty())
+    {
+      digraph_node<NT,AT>* current = m_stack.back().first;
+      if (m_stack.back().second >= current->m_outputs.size())
+      {
+        // all outputs tried so backtrack
+        m_stack.pop_back();
+        if (!m_route.empty()) m_route.pop_back();
+        continue;
+      }
+      digraph_arc<NT,AT>* arc = current->m_outputs[m_stack.back().second++];
+      if (m_select && !m_select(*m_graph, digraph_arc_iterator<NT,AT,const AT&,const AT*>(arc))) continue;
+      if (std::find(m_route.begin(), m_route.end(), arc) != m_route.end()) continue;
+      if (arc->m_to == m_to)
+      {
+        for (unsigned i = 0; i < m_route.size(); i++)
+          m_path.push_back(digraph_arc_iterator<NT,AT,const AT&,const AT*>(m_route[i]));
+        m_path.push_back(digraph_arc_iterator<NT,AT,const AT&,const AT*>(arc));
+        m_count++;
+        return true;
+      }
+      // only descend if a path through this arc could still be short enough
+      if (m_max_length == 0 || m_route.size()+1 < m_max_length)
+      {
+        m_route.push_back(arc);
+        m_stack.push_back(std::make_pair(arc->m_to, 0u));
+      }
+    }
+    return false;
+  }
+
+  template<typename NT, typename AT>
+  const typename digraph_path_enumerator<NT,AT>::const_arc_vector& digraph_path_enumerator<NT,AT>::path(void) const
+  {
+    return m_path;
+  }
+
+  template<typename NT, typename AT>
+  unsigned digraph_path_enumerator<NT,AT>::count(void) const
+  {
+    return m_count;
+  }
+
   ////////////////////////////////////////////////////////////////////////////////
   // subtype utilities
 
@@ -487,29 +803,14 @@ namespace stlplus
   template<typename NT, typename AT>
   unsigned digraph<NT,AT>::size(void) const
   {
-    unsigned count = 0;
-    for (digraph_iterator<NT,AT,const NT&,const NT*> i = begin(); i != end(); i++)
-      count++;
-    return count;
+    return (unsigned)m_node_table.size();
   }
 
   template<typename NT, typename AT>
   typename digraph<NT,AT>::iterator digraph<NT,AT>::insert(const NT& node_data)
   {
-    digraph_node<NT,AT>* new_node = new digraph_node<NT,AT>(this,node_data);
-    if (!m_nodes_end)
-    {
-      // insert into an empty list
-      m_nodes_begin = new_node;
-      m_nodes_end = new_node;
-    }
-    else
-    {
-      // insert at the end of the list
-      new_node->m_prev = m_nodes_end;
-      m_nodes_end->m_next = new_node;
-      m_nodes_end = new_node;
-    }
+    digraph_node<NT,AT>* new_node = create_node(node_data);
+    link_node(new_node);
     return digraph_iterator<NT,AT,NT&,NT*>(new_node);
   }
 
@@ -533,8 +834,13 @@ namespace stlplus
       m_nodes_begin = iter.node()->m_next;
     if (iter.node() == m_nodes_end)
       m_nodes_end = iter.node()->m_prev;
+    // keep the node table dense by moving the last node into the erased node's slot
+    digraph_node<NT,AT>* last = m_node_table.back();
+    last->m_index = iter.node()->m_index;
+    m_node_table[last->m_index] = last;
+    m_node_table.pop_back();
     digraph_node<NT,AT>* next = iter.node()->m_next;
-    delete iter.node();
+    destroy_node(iter.node());
     // return the next node in the list
     if (next)
       return digraph_iterator<NT,AT,NT&,NT*>(next);
@@ -553,20 +859,150 @@ namespace stlplus
     for (digraph_node<NT,AT>* node = m_nodes_begin; node != 0; )
     {
       digraph_node<NT,AT>* next = node->m_next;
-      delete node;
+      // no need to return the space to the pool since the whole pool is released below
+      node->~digraph_node<NT,AT>();
       node = next;
     }
     m_nodes_begin = 0;
     m_nodes_end = 0;
+    m_node_table.clear();
     // delete all the arcs
     for (digraph_arc<NT,AT>* arc = m_arcs_begin; arc != 0; )
     {
       digraph_arc<NT,AT>* next = arc->m_next;
-      delete arc;
+      arc->~digraph_arc<NT,AT>();
       arc = next;
     }
     m_arcs_begin = 0;
     m_arcs_end = 0;
+    // everything has been destroyed so the space can be released
+    m_node_pool.clear();
+    m_arc_pool.clear();
+  }
+
+  template<typename NT, typename AT>
+  typename digraph<NT,AT>::node_vector digraph<NT,AT>::build(const std::vector<NT>& nodes,
+                                                             const typename digraph<NT,AT>::edge_vector& edges)
+  {
+    // check the edges before changing anything
+    for (unsigned e = 0; e < edges.size(); e++)
+      if (edges[e].first >= nodes.size() || edges[e].second >= nodes.size())
+        throw std::out_of_range("digraph::build: edge refers to a node that does not exist");
+    clear();
+    // counting pass so that every node's inputs and outputs are allocated exactly once
+    std::vector<unsigned> fanins(nodes.size(), 0);
+    std::vector<unsigned> fanouts(nodes.size(), 0);
+    for (unsigned e = 0; e < edges.size(); e++)
+    {
+      fanouts[edges[e].first]++;
+      fanins[edges[e].second]++;
+    }
+    // now create the nodes and arcs, all from one block each
+    m_node_pool.reserve((unsigned)nodes.size());
+    m_arc_pool.reserve((unsigned)edges.size());
+    m_node_table.reserve(nodes.size());
+    // the nodes and arcs are linked in directly rather than using insert and
+    // arc_insert, so that no iterators are created in the inner loops
+    for (unsigned n = 0; n < nodes.size(); n++)
+    {
+      digraph_node<NT,AT>* node = create_node(nodes[n]);
+      link_node(node);
+      node->m_inputs.reserve(fanins[n]);
+      node->m_outputs.reserve(fanouts[n]);
+    }
+    for (unsigned e = 0; e < edges.size(); e++)
+      link_arc(create_arc(m_node_table[edges[e].first], m_node_table[edges[e].second], edges[e].third));
+    node_vector result;
+    result.reserve(nodes.size());
+    for (unsigned n = 0; n < nodes.size(); n++)
+      result.push_back(digraph_iterator<NT,AT,NT&,NT*>(m_node_table[n]));
+    return result;
+  }
+
+  template<typename NT, typename AT>
+  digraph_node<NT,AT>* digraph<NT,AT>::create_node(const NT& node_data)
+  {
+    void* space = m_node_pool.allocate();
+    try
+    {
+      return new(space) digraph_node<NT,AT>(this,node_data);
+    }
+    catch(...)
+    {
+      m_node_pool.deallocate(space);
+      throw;
+    }
+  }
+
+  template<typename NT, typename AT>
+  void digraph<NT,AT>::destroy_node(digraph_node<NT,AT>* node)
+  {
+    node->~digraph_node<NT,AT>();
+    m_node_pool.deallocate(node);
+  }
+
+  template<typename NT, typename AT>
+  digraph_arc<NT,AT>* digraph<NT,AT>::create_arc(digraph_node<NT,AT>* from, digraph_node<NT,AT>* to, const AT& arc_data)
+  {
+    void* space = m_arc_pool.allocate();
+    try
+    {
+      return new(space) digraph_arc<NT,AT>(this, from, to, arc_data);
+    }
+    catch(...)
+    {
+      m_arc_pool.deallocate(space);
+      throw;
+    }
+  }
+
+  template<typename NT, typename AT>
+  void digraph<NT,AT>::destroy_arc(digraph_arc<NT,AT>* arc)
+  {
+    arc->~digraph_arc<NT,AT>();
+    m_arc_pool.deallocate(arc);
+  }
+
+  template<typename NT, typename AT>
+  void digraph<NT,AT>::link_node(digraph_node<NT,AT>* node)
+  {
+    if (!m_nodes_end)
+    {
+      // insert into an empty list
+      m_nodes_begin = node;
+      m_nodes_end = node;
+    }
+    else
+    {
+      // insert at the end of the list
+      node->m_prev = m_nodes_end;
+      m_nodes_end->m_next = node;
+      m_nodes_end = node;
+    }
+    // add to the end of the node table
+    node->m_index = (unsigned)m_node_table.size();
+    m_node_table.push_back(node);
+  }
+
+  template<typename NT, typename AT>
+  void digraph<NT,AT>::link_arc(digraph_arc<NT,AT>* arc)
+  {
+    if (!m_arcs_end)
+    {
+      // insert into an empty list
+      m_arcs_begin = arc;
+      m_arcs_end = arc;
+    }
+    else
+    {
+      // insert at the end of the list
+      arc->m_prev = m_arcs_end;
+      m_arcs_end->m_next = arc;
+      m_arcs_end = arc;
+    }
+    // add this arc to the inputs and outputs of the end nodes
+    arc->m_from->m_outputs.push_back(arc);
+    arc->m_to->m_inputs.push_back(arc);
   }
 
   template<typename NT, typename AT>
@@ -789,23 +1225,8 @@ namespace stlplus
     from.assert_valid(this);
     to.assert_valid(this);
     // create the new arc and link it in to the arc list
-    digraph_arc<NT,AT>* new_arc = new digraph_arc<NT,AT>(this, from.node(), to.node(), arc_data);
-    if (!m_arcs_end)
-    {
-      // insert into an empty list
-      m_arcs_begin = new_arc;
-      m_arcs_end = new_arc;
-    }
-    else
-    {
-      // insert at the end of the list
-      new_arc->m_prev = m_arcs_end;
-      m_arcs_end->m_next = new_arc;
-      m_arcs_end = new_arc;
-    }
-    // add this arc to the inputs and outputs of the end nodes
-    from.node()->m_outputs.push_back(new_arc);
-    to.node()->m_inputs.push_back(new_arc);
+    digraph_arc<NT,AT>* new_arc = create_arc(from.node(), to.node(), arc_data);
+    link_arc(new_arc);
     return digraph_arc_iterator<NT,AT,AT&,AT*>(new_arc);
   }
 
@@ -839,7 +1260,7 @@ namespace stlplus
     if (iter.node() == m_arcs_end)
       m_arcs_end = iter.node()->m_prev;
     digraph_arc<NT,AT>* next = iter.node()->m_next;
-    delete iter.node();
+    destroy_arc(iter.node());
     if (next)
       return digraph_arc_iterator<NT,AT,AT&,AT*>(next);
     else
@@ -979,8 +1400,13 @@ namespace stlplus
 
     // change the ownership of the nodes/arcs - this will also change ownership of any iterators
     // do this before the move so the traversal is easier to calculate
+    // also append the nodes to this graph's node table
     for (digraph_node<NT,AT>* node = source.m_nodes_begin; node != 0; node = node->m_next)
+    {
       node->m_master.change_owner(this);
+      node->m_index = (unsigned)m_node_table.size();
+      m_node_table.push_back(node);
+    }
     for (digraph_arc<NT,AT>* arc = source.m_arcs_begin; arc != 0; arc = arc->m_next)
       arc->m_master.change_owner(this);
 
@@ -1005,6 +1431,7 @@ namespace stlplus
     // unhook from the source
     source.m_nodes_begin = 0;
     source.m_nodes_end = 0;
+    source.m_node_table.clear();
 
     // move the arcs
     // do nothing if the source is empty
@@ -1027,6 +1454,10 @@ namespace stlplus
     // unhook from the source
     source.m_arcs_begin = 0;
     source.m_arcs_end = 0;
+
+    // and take over the space they occupy
+    m_node_pool.splice(source.m_node_pool);
+    m_arc_pool.splice(source.m_arc_pool);
   }
 
   ////////////////////////////////////////////////////////////////////////////////
@@ -1132,6 +1563,172 @@ namespace stlplus
     return deconstify_nodes(output_adjacencies(from.constify()));
   }
 
+  ////////////////////////////////////////////////////////////////////////////////
+  // Strongly Connected Component Algorithms
+
+  template<typename NT, typename AT>
+  unsigned digraph<NT,AT>::strong_components(std::vector<unsigned>& components,
+                                             typename digraph<NT,AT>::arc_select_fn select) const
+  {
+    // This is Tarjan's algorithm, which finds all the components in one
+    // depth-first traversal. Each node is numbered in the order it is first
+    // visited and also given a low-link, which is the lowest number of any node
+    // on the traversal stack that it can reach. A node whose low-link is its
+    // own number is the root of a component, which is then popped off the
+    // stack. The depth-first traversal uses an explicit stack of nodes and
+    // their next output rather than recursion, so very deep graphs cannot
+    // overflow the program stack. Components are completed in reverse
+    // topographical order so are renumbered at the end.
+    unsigned nodes = size();
+    std::vector<unsigned> number(nodes, npos());
+    std::vector<unsigned> low_link(nodes, 0);
+    std::vector<bool> on_stack(nodes, false);
+    std::vector<unsigned> stack;
+    std::vector<std::pair<digraph_node<NT,AT>*,unsigned> > traversal;
+    components.assign(nodes, npos());
+    unsigned visited = 0;
+    unsigned count = 0;
+    for (unsigned root = 0; root < nodes; root++)
+    {
+      if (number[root] != npos()) continue;
+      number[root] = low_link[root] = visited++;
+      stack.push_back(root);
+      on_stack[root] = true;
+      traversal.push_back(std::make_pair(m_node_table[root], 0u));
+      while (!traversal.empty())
+      {
+        digraph_node<NT,AT>* current = traversal.back().first;
+        unsigned c = current->m_index;
+        if (traversal.back().second < current->m_outputs.size())
+        {
+          // visit the next output of the current node
+          digraph_arc<NT,AT>* arc = current->m_outputs[traversal.back().second++];
+          if (select && !select(*this, digraph_arc_iterator<NT,AT,const AT&,const AT*>(arc))) continue;
+          unsigned next = arc->m_to->m_index;
+          if (number[next] == npos())
+          {
+            // not yet visited so descend into it
+            number[next] = low_link[next] = visited++;
+            stack.push_back(next);
+            on_stack[next] = true;
+            traversal.push_back(std::make_pair(arc->m_to, 0u));
+          }
+          else if (on_stack[next])
+            low_link[c] = std::min(low_link[c], number[next]);
+        }
+        else
+        {
+          // all outputs visited so return to the predecessor, passing back the low-link
+          traversal.pop_back();
+          if (!traversal.empty())
+          {
+            unsigned p = traversal.back().first->m_index;
+            low_link[p] = std::min(low_link[p], low_link[c]);
+          }
+          if (low_link[c] == number[c])
+          {
+            // this is the root of a component, which is everything above it on the stack
+            unsigned member = 0;
+            do
+            {
+              member = stack.back();
+              stack.pop_back();
+              on_stack[member] = false;
+              components[member] = count;
+            }
+            while (member != c);
+            count++;
+          }
+        }
+      }
+    }
+    // renumber into topographical order
+    for (unsigned n = 0; n < nodes; n++)
+      components[n] = count - 1 - components[n];
+    return count;
+  }
+
+  template<typename NT, typename AT>
+  typename digraph<NT,AT>::const_component_vector
+  digraph<NT,AT>::strongly_connected_components(typename digraph<NT,AT>::arc_select_fn select) const
+  {
+    std::vector<unsigned> components;
+    const_component_vector result(strong_components(components, select));
+    for (digraph_iterator<NT,AT,const NT&,const NT*> n = begin(); n != end(); n++)
+      result[components[n.node()->m_index]].push_back(n);
+    return result;
+  }
+
+  template<typename NT, typename AT>
+  typename digraph<NT,AT>::component_vector
+  digraph<NT,AT>::strongly_connected_components(typename digraph<NT,AT>::arc_select_fn select)
+  {
+    const_component_vector const_result = const_cast<const digraph<NT,AT>*>(this)->strongly_connected_components(select);
+    component_vector result;
+    for (unsigned i = 0; i < const_result.size(); i++)
+      result.push_back(deconstify_nodes(const_result[i]));
+    return result;
+  }
+
+  template<typename NT, typename AT>
+  typename digraph<NT,AT>::const_condensation
+  digraph<NT,AT>::condense(typename digraph<NT,AT>::arc_select_fn select) const
+  {
+    const_condensation result;
+    std::vector<unsigned> components;
+    unsigned count = strong_components(components, select);
+    // create one node per component and fill it with the component's nodes
+    std::vector<typename const_condensation::iterator> component_nodes;
+    for (unsigned c = 0; c < count; c++)
+      component_nodes.push_back(result.insert(const_node_vector()));
+    for (digraph_iterator<NT,AT,const NT&,const NT*> n = begin(); n != end(); n++)
+      component_nodes[components[n.node()->m_index]]->push_back(n);
+    // now create one arc for each pair of connected components, collecting
+    // the arcs between them. Each component is visited in turn and the arc to
+    // each successor component is remembered, along with the component it was
+    // created for, so no map lookup is needed.
+    std::vector<unsigned> created_for(count, npos());
+    std::vector<typename const_condensation::arc_iterator> component_arcs(count);
+    for (unsigned c = 0; c < count; c++)
+    {
+      const const_node_vector& members = *component_nodes[c];
+      for (unsigned m = 0; m < members.size(); m++)
+      {
+        digraph_node<NT,AT>* member = members[m].node();
+        for (unsigned i = 0; i < member->m_outputs.size(); i++)
+        {
+          digraph_arc_iterator<NT,AT,const AT&,const AT*> arc(member->m_outputs[i]);
+          if (select && !select(*this, arc)) continue;
+          unsigned successor = components[member->m_outputs[i]->m_to->m_index];
+          if (successor == c) continue;
+          if (created_for[successor] != c)
+          {
+            component_arcs[successor] = result.arc_insert(component_nodes[c], component_nodes[successor]);
+            created_for[successor] = c;
+          }
+          component_arcs[successor]->push_back(arc);
+        }
+      }
+    }
+    return result;
+  }
+
+  template<typename NT, typename AT>
+  typename digraph<NT,AT>::condensation
+  digraph<NT,AT>::condense(typename digraph<NT,AT>::arc_select_fn select)
+  {
+    const const_condensation const_result = const_cast<const digraph<NT,AT>*>(this)->condense(select);
+    // copy the structure of the condensation, using a map of cross references
+    // from the old nodes to their new equivalents, as in the assignment operator
+    condensation result;
+    std::map<typename const_condensation::const_iterator, typename condensation::iterator> xref;
+    for (typename const_condensation::const_iterator n = const_result.begin(); n != const_result.end(); n++)
+      xref[n] = result.insert(deconstify_nodes(*n));
+    for (typename const_condensation::const_arc_iterator a = const_result.arc_begin(); a != const_result.arc_end(); a++)
+      result.arc_insert(xref[const_result.arc_from(a)], xref[const_result.arc_to(a)], deconstify_arcs(*a));
+    return result;
+  }
+
   ////////////////////////////////////////////////////////////////////////////////
   // Topographical Sort Algorithms
 
@@ -1139,92 +1736,85 @@ namespace stlplus
   std::pair<typename digraph<NT,AT>::const_node_vector, typename digraph<NT,AT>::const_arc_vector>
   digraph<NT,AT>::sort(typename digraph<NT,AT>::arc_select_fn select) const
   {
+    // The strongly connected components are already in topographical order,
+    // so the sort only needs to order the nodes within each component. A
+    // component with one node needs no ordering. The nodes of a larger
+    // component are ordered by a depth-first traversal confined to the
+    // component, taking the nodes in reverse order of completion. The arcs
+    // that then point backwards are exactly the arcs that close a cycle in the
+    // traversal and these are the arcs broken to achieve the sort.
     std::vector<digraph_iterator<NT,AT,const NT&,const NT*> > result;
     std::vector<digraph_arc_iterator<NT,AT,const AT&,const AT*> > errors;
-    // build a map containing the number of fanins to each node that must be visited before this one
-    std::map<digraph_iterator<NT,AT,const NT&,const NT*>,unsigned> fanin_map;
-    for (digraph_iterator<NT,AT,const NT&,const NT*> n = begin(); n != end(); n++)
+    unsigned nodes = size();
+    std::vector<unsigned> components;
+    unsigned count = strong_components(components, select);
+    // bucket the nodes by component, keeping the node list order within each component
+    std::vector<unsigned> first(count+1, 0);
+    for (unsigned n = 0; n < nodes; n++)
+      first[components[n]+1]++;
+    for (unsigned c = 0; c < count; c++)
+      first[c+1] += first[c];
+    std::vector<digraph_node<NT,AT>*> members(nodes);
+    std::vector<unsigned> fill(first.begin(), first.end()-1);
+    for (digraph_node<NT,AT>* node = m_nodes_begin; node != 0; node = node->m_next)
+      members[fill[components[node->m_index]]++] = node;
+    // position of each node in the result, used to find backward arcs
+    std::vector<unsigned> position(nodes, npos());
+    std::vector<bool> visited(nodes, false);
+    std::vector<std::pair<digraph_node<NT,AT>*,unsigned> > traversal;
+    std::vector<digraph_node<NT,AT>*> completed;
+    for (unsigned c = 0; c < count; c++)
     {
-      unsigned predecessors = 0;
-      // only count predecessors connected by selected arcs
-      for (unsigned f = 0; f < fanin(n); f++)
-      {
-        digraph_arc_iterator<NT,AT, const AT&,const AT*> input_arc = input(n,f);
-        digraph_iterator<NT,AT,const NT&,const NT*> predecessor = arc_from(input_arc);
-        if (!select || select(*this,input_arc))
-          predecessors++;
-      }
-      if (predecessors == 0)
+      if (first[c+1] - first[c] == 1)
       {
-        result.push_back(n);
+        position[members[first[c]]->m_index] = (unsigned)result.size();
+        result.push_back(digraph_iterator<NT,AT,const NT&,const NT*>(members[first[c]]));
       }
       else
       {
-        fanin_map[n] = predecessors;
-      }
-    }
-    // main algorithm applies the topographical sort repeatedly. For a DAG, it
-    // will complete first time. However, with backward arcs, the first
-    // iteration will fail. The algorithm then tries breaking random arcs to try
-    // to get an ordering.
-    for(unsigned i = 0; !fanin_map.empty(); )
-    {
-      // now visit each node in traversal order, decrementing the fanin count of
-      // all successors. As each successor's fanin count goes to zero, it is
-      // appended to the result.
-      for (; i < result.size(); i++)
-      {
-        // Note: dereferencing gives us a node iterator
-        digraph_iterator<NT,AT,const NT&,const NT*> current = result[i];
-        for (unsigned f = 0; f < fanout(current); f++)
+        completed.clear();
+        for (unsigned m = first[c]; m < first[c+1]; m++)
         {
-          // only consider successors connected by selected arcs
-          digraph_arc_iterator<NT,AT, const AT&,const AT*> output_arc = output(current, f);
-          digraph_iterator<NT,AT,const NT&,const NT*> successor = arc_to(output_arc);
-          if (!select || select(*this,output_arc))
+          if (visited[members[m]->m_index]) continue;
+          visited[members[m]->m_index] = true;
+          traversal.push_back(std::make_pair(members[m], 0u));
+          while (!traversal.empty())
           {
-            // don't consider arcs that have been eliminated to break a loop
-            if (fanin_map.find(successor) != fanin_map.end())
+            digraph_node<NT,AT>* current = traversal.back().first;
+            if (traversal.back().second < current->m_outputs.size())
             {
-              --fanin_map[successor];
-              if ((fanin_map[successor]) == 0)
-              {
-                result.push_back(successor);
-                fanin_map.erase(fanin_map.find(successor));
-              }
+              digraph_arc<NT,AT>* arc = current->m_outputs[traversal.back().second++];
+              unsigned next = arc->m_to->m_index;
+              if (components[next] != c || visited[next]) continue;
+              if (select && !select(*this, digraph_arc_iterator<NT,AT,const AT&,const AT*>(arc))) continue;
+              visited[next] = true;
+              traversal.push_back(std::make_pair(arc->m_to, 0u));
+            }
+            else
+            {
+              completed.push_back(current);
+              traversal.pop_back();
             }
           }
         }
+        for (unsigned i = (unsigned)completed.size(); i--; )
+        {
+          position[completed[i]->m_index] = (unsigned)result.size();
+          result.push_back(digraph_iterator<NT,AT,const NT&,const NT*>(completed[i]));
+        }
       }
-      if (!fanin_map.empty())
+      // now find the selected arcs within this component that point backwards
+      for (unsigned m = first[c]; m < first[c+1]; m++)
       {
-        // there must be backward arcs preventing completion
-        // try removing arcs from the sort to get a partial ordering containing all the nodes
-
-        // select an arc that is still relevant to the sort and break it
-        // first select a node that has non-zero fanin and its predecessor that has non-zero fanin
-        digraph_iterator<NT,AT,const NT&,const NT*> stuck_node = fanin_map.begin()->first;
-        for (unsigned f = 0; f < fanin(stuck_node); f++)
+        digraph_node<NT,AT>* member = members[m];
+        for (unsigned i = 0; i < member->m_outputs.size(); i++)
         {
-          // now successively remove input arcs that are still part of the sort until the fanin reduces to zero
-          // first find a relevant arc - this must be a selected arc that has not yet been traversed by the first half of the algorithm
-          digraph_arc_iterator<NT,AT, const AT&,const AT*> input_arc = input(stuck_node, f);
-          if (!select || select(*this,input_arc))
-          {
-            digraph_iterator<NT,AT,const NT&,const NT*> predecessor = arc_from(input_arc);
-            if (fanin_map.find(predecessor) != fanin_map.end())
-            {
-              // found the right combination - remove this arc and then drop out of the fanin loop to restart the outer sort loop
-              errors.push_back(input_arc);
-              --fanin_map[stuck_node];
-              if ((fanin_map[stuck_node]) == 0)
-              {
-                result.push_back(stuck_node);
-                fanin_map.erase(fanin_map.find(stuck_node));
-                break;
-              }
-            }
-          }
+          digraph_arc<NT,AT>* arc = member->m_outputs[i];
+          unsigned next = arc->m_to->m_index;
+          if (components[next] != c || position[next] > position[member->m_index]) continue;
+          digraph_arc_iterator<NT,AT,const AT&,const AT*> arc_iter(arc);
+          if (!select || select(*this, arc_iter))
+            errors.push_back(arc_iter);
         }
       }
     }
@@ -1259,6 +1849,142 @@ namespace stlplus
   {
     return deconstify_nodes(const_cast<const digraph<NT,AT>*>(this)->dag_sort(select));
   }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // Levelling and Parallel Execution
+
+  template<typename NT, typename AT>
+  unsigned digraph<NT,AT>::kahn_levels(std::vector<unsigned>& levels, std::vector<unsigned>& fanins,
+                                       typename digraph<NT,AT>::arc_select_fn select) const
+  {
+    unsigned nodes = size();
+    levels.assign(nodes, 0);
+    fanins.assign(nodes, 0);
+    for (unsigned n = 0; n < nodes; n++)
+    {
+      digraph_node<NT,AT>* node = m_node_table[n];
+      for (unsigned i = 0; i < node->m_outputs.size(); i++)
+        if (!select || select(*this, digraph_arc_iterator<NT,AT,const AT&,const AT*>(node->m_outputs[i])))
+          fanins[node->m_outputs[i]->m_to->m_index]++;
+    }
+    // the ready vector doubles as the queue of nodes whose fanin has all been
+    // visited - nodes are appended to it as their last input is removed
+    std::vector<unsigned> remaining(fanins);
+    std::vector<unsigned> ready;
+    ready.reserve(nodes);
+    for (unsigned n = 0; n < nodes; n++)
+      if (remaining[n] == 0)
+        ready.push_back(n);
+    unsigned count = 0;
+    for (unsigned r = 0; r < ready.size(); r++)
+    {
+      digraph_node<NT,AT>* node = m_node_table[ready[r]];
+      unsigned level = levels[ready[r]];
+      count = std::max(count, level+1);
+      for (unsigned i = 0; i < node->m_outputs.size(); i++)
+      {
+        digraph_arc<NT,AT>* arc = node->m_outputs[i];
+        if (select && !select(*this, digraph_arc_iterator<NT,AT,const AT&,const AT*>(arc))) continue;
+        unsigned next = arc->m_to->m_index;
+        levels[next] = std::max(levels[next], level+1);
+        if (--remaining[next] == 0)
+          ready.push_back(next);
+      }
+    }
+    // any node never made ready is on a cycle or downstream of one
+    if (ready.size() != nodes) return npos();
+    return count;
+  }
+
+  template<typename NT, typename AT>
+  typename digraph<NT,AT>::const_component_vector
+  digraph<NT,AT>::levels(typename digraph<NT,AT>::arc_select_fn select) const
+  {
+    std::vector<unsigned> levels;
+    std::vector<unsigned> fanins;
+    unsigned count = kahn_levels(levels, fanins, select);
+    if (count == npos()) return const_component_vector();
+    const_component_vector result(count);
+    for (digraph_iterator<NT,AT,const NT&,const NT*> n = begin(); n != end(); n++)
+      result[levels[n.node()->m_index]].push_back(n);
+    return result;
+  }
+
+  template<typename NT, typename AT>
+  typename digraph<NT,AT>::component_vector
+  digraph<NT,AT>::levels(typename digraph<NT,AT>::arc_select_fn select)
+  {
+    const_component_vector const_result = const_cast<const digraph<NT,AT>*>(this)->levels(select);
+    component_vector result;
+    for (unsigned i = 0; i < const_result.size(); i++)
+      result.push_back(deconstify_nodes(const_result[i]));
+    return result;
+  }
+
+  template<typename NT, typename AT>
+  template<typename F>
+  void digraph<NT,AT>::parallel_execute(F fn, unsigned threads, typename digraph<NT,AT>::arc_select_fn select)
+  {
+    std::vector<unsigned> levels;
+    std::vector<unsigned> fanins;
+    if (kahn_levels(levels, fanins, select) == npos())
+      throw std::invalid_argument("digraph::parallel_execute: graph is not a DAG");
+#ifdef STLPLUS_HAS_CXX11
+    // Each node has a count of the inputs still to complete. The worker that
+    // completes a node's last input makes it ready. The first successor made
+    // ready is run straight away by the same worker, since its inputs are
+    // likely to still be in that processor's cache, and the rest are handed
+    // to the pool where idle workers can steal them.
+    unsigned nodes = size();
+    std::unique_ptr<std::atomic<unsigned>[]> waiting(new std::atomic<unsigned>[nodes]);
+    for (unsigned n = 0; n < nodes; n++)
+      waiting[n].store(fanins[n]);
+    std::atomic<bool> failed(false);
+    task_pool pool(threads);
+    std::function<void(digraph_node<NT,AT>*)> execute;
+    execute = [&](digraph_node<NT,AT>* node)
+    {
+      while (node && !failed.load())
+      {
+        try
+        {
+          fn(*this, digraph_iterator<NT,AT,NT&,NT*>(node));
+        }
+        catch(...)
+        {
+          failed.store(true);
+          throw;
+        }
+        digraph_node<NT,AT>* continuation = 0;
+        for (unsigned i = 0; i < node->m_outputs.size(); i++)
+        {
+          digraph_arc<NT,AT>* arc = node->m_outputs[i];
+          if (select && !select(*this, digraph_arc_iterator<NT,AT,const AT&,const AT*>(arc))) continue;
+          digraph_node<NT,AT>* next = arc->m_to;
+          if (--waiting[next->m_index] != 0) continue;
+          if (!continuation)
+            continuation = next;
+          else
+            pool.submit([&execute,next]{execute(next);});
+        }
+        node = continuation;
+      }
+    };
+    for (unsigned n = 0; n < nodes; n++)
+    {
+      if (fanins[n] != 0) continue;
+      digraph_node<NT,AT>* node = m_node_table[n];
+      pool.submit([&execute,node]{execute(node);});
+    }
+    pool.wait();
+#else
+    (void)threads;
+    node_vector order = dag_sort(select);
+    for (unsigned i = 0; i < order.size(); i++)
+      fn(*this, order[i]);
+#endif
+  }
+
   ////////////////////////////////////////////////////////////////////////////////
   // Path Algorithms
 
@@ -1317,41 +2043,6 @@ namespace stlplus
     return path_exists(from.constify(), to.constify(), select);
   }
 
-  template<typename NT, typename AT>
-  void digraph<NT,AT>::all_paths_r(typename digraph<NT,AT>::const_iterator from,
-                                   typename digraph<NT,AT>::const_iterator to,
-                                   typename digraph<NT,AT>::const_arc_vector& so_far,
-                                   typename digraph<NT,AT>::const_path_vector& result,
-                                   typename digraph<NT,AT>::arc_select_fn select) const
-
-  {
-    // This is the recursive part of the all_paths function. The field so_far
-    // contains the path so far so that when 'to' is reached, the path is
-    // complete. It serves the same purpose as the visited set in the path_exists
-    // function except that it also preserves the path order. It also serves the
-    // purpose of detecting cycles and thus stopping infinite recursion. Every
-    // time the recursion reaches the to node, a copy of so_far is appended to the
-    // path set.
-    for (unsigned i = 0; i < fanout(from); i++)
-    {
-      digraph_arc_iterator<NT,AT, const AT&,const AT*> candidate = output(from,i);
-      // test whether the arc is selected and then check that the candidate has not
-      // been visited already on this path and only allow further recursion if it hasn't
-      // this eliminates recursion loops
-      if ((!select || select(*this, candidate)) && std::find(so_far.begin(), so_far.end(), candidate) == so_far.end())
-      {
-        // extend the path tracing the route to this arc
-        so_far.push_back(candidate);
-        // if the candidate arc points to the target, update the result set and prevent further recursion, otherwise recurse
-        if (arc_to(candidate) == to)
-          result.push_back(so_far);
-        else
-          all_paths_r(arc_to(candidate),to,so_far,result,select);
-        so_far.pop_back();
-      }
-    }
-  }
-
   template<typename NT, typename AT>
   typename digraph<NT,AT>::const_path_vector
   digraph<NT,AT>::all_paths(typename digraph<NT,AT>::const_iterator from,
@@ -1359,10 +2050,10 @@ namespace stlplus
                             typename digraph<NT,AT>::arc_select_fn select) const
 
   {
-    // set up the recursion with empty data fields and then recurse
+    // collect every path found by the path enumerator
     typename digraph<NT,AT>::const_path_vector result;
-    typename digraph<NT,AT>::const_arc_vector so_far;
-    all_paths_r(from, to, so_far, result, select);
+    for (path_enumerator path = paths(from, to, select); path.next(); )
+      result.push_back(path.path());
     return result;
   }
 
@@ -1375,6 +2066,30 @@ namespace stlplus
     return deconstify_paths(all_paths(from.constify(), to.constify(), select));
   }
 
+  template<typename NT, typename AT>
+  typename digraph<NT,AT>::path_enumerator
+  digraph<NT,AT>::paths(typename digraph<NT,AT>::const_iterator from,
+                        typename digraph<NT,AT>::const_iterator to,
+                        typename digraph<NT,AT>::arc_select_fn select,
+                        unsigned max_length,
+                        unsigned max_paths) const
+  {
+    from.assert_valid(this);
+    to.assert_valid(this);
+    return path_enumerator(this, from.node(), to.node(), select, max_length, max_paths);
+  }
+
+  template<typename NT, typename AT>
+  typename digraph<NT,AT>::path_enumerator
+  digraph<NT,AT>::paths(typename digraph<NT,AT>::iterator from,
+                        typename digraph<NT,AT>::iterator to,
+                        typename digraph<NT,AT>::arc_select_fn select,
+                        unsigned max_length,
+                        unsigned max_paths)
+  {
+    return const_cast<const digraph<NT,AT>*>(this)->paths(from.constify(), to.constify(), select, max_length, max_paths);
+  }
+
   template<typename NT, typename AT>
   void digraph<NT,AT>::reachable_nodes_r(typename digraph<NT,AT>::const_iterator from,
                                          typename digraph<NT,AT>::const_iterator_set& visited,
@@ -1585,5 +2300,153 @@ namespace stlplus
   }
 
   ////////////////////////////////////////////////////////////////////////////////
+  // Weighted Shortest Path Algorithms
+
+  template<typename NT, typename AT>
+  double digraph<NT,AT>::arc_data_weight(const digraph<NT,AT>&,
+                                         typename digraph<NT,AT>::const_arc_iterator arc)
+  {
+    return static_cast<double>(*arc);
+  }
+
+  template<typename NT, typename AT>
+  void digraph<NT,AT>::weighted_search(typename digraph<NT,AT>::const_iterator from,
+                                       typename digraph<NT,AT>::const_iterator to,
+                                       typename digraph<NT,AT>::arc_weight_fn weight,
+                                       typename digraph<NT,AT>::node_heuristic_fn heuristic,
+                                       typename digraph<NT,AT>::arc_select_fn select,
+                                       std::vector<digraph_arc<NT,AT>*>& predecessors) const
+  {
+    from.assert_valid(this);
+    // This is Dijkstra's algorithm, which becomes the A* algorithm when a
+    // heuristic is supplied. Nodes are visited in order of increasing cost
+    // (plus the estimated remaining cost in the A* case), so a node's
+    // predecessor arc is final once that node leaves the queue. The distances
+    // and predecessors are flat arrays indexed by the node index rather than
+    // maps keyed on iterators. With a heuristic a node can be improved after
+    // it has been visited, in which case it is simply queued again.
+    unsigned nodes = size();
+    predecessors.assign(nodes, 0);
+    std::vector<double> distance(nodes, std::numeric_limits<double>::infinity());
+    digraph_heap queue(nodes);
+    digraph_node<NT,AT>* target = to.valid() ? to.node() : 0;
+    distance[from.node()->m_index] = 0.0;
+    queue.push(from.node()->m_index, heuristic ? heuristic(*this, from, to) : 0.0);
+    while (!queue.empty())
+    {
+      digraph_node<NT,AT>* current = m_node_table[queue.pop()];
+      // stop as soon as the target is reached, since its path cannot get any shorter
+      if (current == target) break;
+      double current_distance = distance[current->m_index];
+      for (unsigned i = 0; i < current->m_outputs.size(); i++)
+      {
+        digraph_arc<NT,AT>* arc = current->m_outputs[i];
+        digraph_arc_iterator<NT,AT,const AT&,const AT*> arc_iter(arc);
+        if (select && !select(*this, arc_iter)) continue;
+        double arc_weight = weight(*this, arc_iter);
+        if (arc_weight < 0.0)
+          throw std::invalid_argument("digraph: negative arc weight");
+        unsigned next = arc->m_to->m_index;
+        double next_distance = current_distance + arc_weight;
+        if (next_distance < distance[next])
+        {
+          distance[next] = next_distance;
+          predecessors[next] = arc;
+          if (heuristic)
+            queue.push(next, next_distance + heuristic(*this, digraph_iterator<NT,AT,const NT&,const NT*>(arc->m_to), to));
+          else
+            queue.push(next, next_distance);
+        }
+      }
+    }
+  }
+
+  template<typename NT, typename AT>
+  typename digraph<NT,AT>::const_arc_vector
+  digraph<NT,AT>::weighted_path(typename digraph<NT,AT>::const_iterator to,
+                                const std::vector<digraph_arc<NT,AT>*>& predecessors) const
+  {
+    // walk back through the predecessor arcs to the start node, which has no predecessor
+    const_arc_vector result;
+    for (digraph_arc<NT,AT>* arc = predecessors[to.node()->m_index]; arc; arc = predecessors[arc->m_from->m_index])
+      result.push_back(digraph_arc_iterator<NT,AT,const AT&,const AT*>(arc));
+    std::reverse(result.begin(), result.end());
+    return result;
+  }
+
+  template<typename NT, typename AT>
+  typename digraph<NT,AT>::const_arc_vector
+  digraph<NT,AT>::weighted_shortest_path(typename digraph<NT,AT>::const_iterator from,
+                                         typename digraph<NT,AT>::const_iterator to,
+                                         typename digraph<NT,AT>::arc_weight_fn weight,
+                                         typename digraph<NT,AT>::arc_select_fn select) const
+  {
+    to.assert_valid(this);
+    std::vector<digraph_arc<NT,AT>*> predecessors;
+    weighted_search(from, to, weight, 0, select, predecessors);
+    return weighted_path(to, predecessors);
+  }
+
+  template<typename NT, typename AT>
+  typename digraph<NT,AT>::arc_vector
+  digraph<NT,AT>::weighted_shortest_path(typename digraph<NT,AT>::iterator from,
+                                         typename digraph<NT,AT>::iterator to,
+                                         typename digraph<NT,AT>::arc_weight_fn weight,
+                                         typename digraph<NT,AT>::arc_select_fn select)
+  {
+    return deconstify_arcs(weighted_shortest_path(from.constify(),to.constify(),weight,select));
+  }
+
+  template<typename NT, typename AT>
+  typename digraph<NT,AT>::const_path_vector
+  digraph<NT,AT>::weighted_shortest_paths(typename digraph<NT,AT>::const_iterator from,
+                                          typename digraph<NT,AT>::arc_weight_fn weight,
+                                          typename digraph<NT,AT>::arc_select_fn select) const
+  {
+    std::vector<digraph_arc<NT,AT>*> predecessors;
+    weighted_search(from, end(), weight, 0, select, predecessors);
+    // every node with a predecessor arc is reachable - the start node has none
+    const_path_vector result;
+    for (digraph_iterator<NT,AT,const NT&,const NT*> n = begin(); n != end(); n++)
+      if (predecessors[n.node()->m_index])
+        result.push_back(weighted_path(n, predecessors));
+    return result;
+  }
+
+  template<typename NT, typename AT>
+  typename digraph<NT,AT>::path_vector
+  digraph<NT,AT>::weighted_shortest_paths(typename digraph<NT,AT>::iterator from,
+                                          typename digraph<NT,AT>::arc_weight_fn weight,
+                                          typename digraph<NT,AT>::arc_select_fn select)
+  {
+    return deconstify_paths(weighted_shortest_paths(from.constify(),weight,select));
+  }
+
+  template<typename NT, typename AT>
+  typename digraph<NT,AT>::const_arc_vector
+  digraph<NT,AT>::astar_path(typename digraph<NT,AT>::const_iterator from,
+                             typename digraph<NT,AT>::const_iterator to,
+                             typename digraph<NT,AT>::arc_weight_fn weight,
+                             typename digraph<NT,AT>::node_heuristic_fn heuristic,
+                             typename digraph<NT,AT>::arc_select_fn select) const
+  {
+    to.assert_valid(this);
+    std::vector<digraph_arc<NT,AT>*> predecessors;
+    weighted_search(from, to, weight, heuristic, select, predecessors);
+    return weighted_path(to, predecessors);
+  }
+
+  template<typename NT, typename AT>
+  typename digraph<NT,AT>::arc_vector
+  digraph<NT,AT>::astar_path(typename digraph<NT,AT>::iterator from,
+                             typename digraph<NT,AT>::iterator to,
+                             typename digraph<NT,AT>::arc_weight_fn weight,
+                             typename digraph<NT,AT>::node_heuristic_fn heuristic,
+                             typename digraph<NT,AT>::arc_select_fn select)
+  {
+    return deconstify_arcs(astar_path(from.constify(),to.constify(),weight,heuristic,select));
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
 
 } // end namespace stlplus
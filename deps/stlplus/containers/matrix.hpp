@@ -9,16 +9,49 @@
 
 //   General-purpose 2D matrix data structure
 
+//   The elements are stored in a single contiguous block in row-major order,
+//   so that row r starts at data() + r*stride(). The block is aligned to a
+//   cache line so that it can be handed directly to vectorised or BLAS-like
+//   kernels.
+
 ////////////////////////////////////////////////////////////////////////////////
 #include "containers_fixes.hpp"
+#include "task_pool.hpp"
 #include <stdexcept>
+#include <cstddef>
+#include <vector>
 
 namespace stlplus
 {
 
   ////////////////////////////////////////////////////////////////////////////////
+  // Identifies the built-in arithmetic types, which can be copied and filled
+  // as raw memory. Specialised in matrix.tpp
+
+  template<typename T> struct matrix_arithmetic
+  {
+    enum {value = 0};
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // Element-wise arithmetic is lazy: an expression such as a*b + c - d builds a
+  // tree of small expression objects rather than a matrix per operator, and
+  // the whole tree is evaluated in a single pass over the elements when it is
+  // assigned to a matrix. Every expression type E derives from
+  // matrix_expression<T,E> and provides rows(), columns() and element(i),
+  // where i indexes the elements in row-major order.
+  // An expression refers to the matrices it was built from, so it must be
+  // evaluated before they are changed or destroyed.
 
-  template<typename T> class matrix
+  template<typename T, typename E> class matrix_expression
+  {
+  public:
+    const E& self(void) const ;
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+
+  template<typename T> class matrix : public matrix_expression<T, matrix<T> >
   {
   public:
     matrix(unsigned rows = 0, unsigned cols = 0, const T& fill = T()) ;
@@ -27,6 +60,14 @@ namespace stlplus
     matrix(const matrix&) ;
     matrix& operator =(const matrix&) ;
 
+    // evaluate an element-wise expression
+    // exceptions: std::invalid_argument
+    template<typename E>
+    matrix(const matrix_expression<T,E>&) ;
+    // exceptions: std::invalid_argument
+    template<typename E>
+    matrix& operator =(const matrix_expression<T,E>&) ;
+
     void resize(unsigned rows, unsigned cols, const T& fill = T()) ;
 
     unsigned rows(void) const ;
@@ -55,14 +96,158 @@ namespace stlplus
     void fill_trailing_diagonal(const T& item = T()) ;
     void make_identity(const T& one, const T& zero = T()) ;
 
+    // transposes in place for a square matrix, otherwise into new storage
+    // both are done in cache-sized tiles so that large matrices are read and
+    // written a cache line at a time
     void transpose(void) ;
 
+    // element-wise arithmetic with a matrix or expression of the same shape
+    // exceptions: std::invalid_argument
+    template<typename E>
+    matrix& operator += (const matrix_expression<T,E>&) ;
+    // exceptions: std::invalid_argument
+    template<typename E>
+    matrix& operator -= (const matrix_expression<T,E>&) ;
+    // exceptions: std::invalid_argument
+    template<typename E>
+    matrix& operator *= (const matrix_expression<T,E>&) ;
+
+    // direct access to the element storage, which is null for an empty matrix
+    // row r starts at data() + r*stride() and holds columns() contiguous elements
+    const T* data(void) const ;
+    T* data(void) ;
+    // distance in elements between the starts of consecutive rows
+    unsigned stride(void) const ;
+    // pointer to the first element of a row
+    // exceptions: std::out_of_range
+    const T* row_span(unsigned row) const ;
+    // exceptions: std::out_of_range
+    T* row_span(unsigned row) ;
+
+    // alignment in bytes of the element storage
+    // transpose works on square tiles of transpose_tile x transpose_tile elements
+    enum {alignment = 64, transpose_tile = 32};
+
+  private:
+    unsigned m_rows;
+    unsigned m_cols;
+    T* m_data;
+    void* m_block;
+
+    // allocate uninitialised aligned storage for size elements
+    static T* allocate(std::size_t size, void*& block) ;
+    // destroy the elements and free the storage
+    static void release(T* data, std::size_t size, void* block) ;
+    // release the current storage and take over new storage
+    void adopt(T* data, void* block, unsigned rows, unsigned cols) ;
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // expression nodes
+
+  // a matrix as an operand of an expression
+  template<typename T> class matrix_leaf
+  {
+  public:
+    matrix_leaf(const matrix<T>&) ;
+    unsigned rows(void) const ;
+    unsigned columns(void) const ;
+    const T& element(std::size_t i) const ;
+
   private:
+    const T* m_data;
     unsigned m_rows;
     unsigned m_cols;
-    T** m_data;
   };
 
+  // matrices are held by an expression as leaves, sub-expressions are held by value
+  template<typename T, typename E> struct matrix_operand
+  {
+    typedef E type;
+  };
+
+  template<typename T> struct matrix_operand<T, matrix<T> >
+  {
+    typedef matrix_leaf<T> type;
+  };
+
+  // the element-wise operations
+  template<typename T> struct matrix_plus
+  {
+    static T apply(const T& left, const T& right) {return left + right;}
+  };
+
+  template<typename T> struct matrix_minus
+  {
+    static T apply(const T& left, const T& right) {return left - right;}
+  };
+
+  template<typename T> struct matrix_times
+  {
+    static T apply(const T& left, const T& right) {return left * right;}
+  };
+
+  // an element-wise operation on two operands of the same shape
+  template<typename T, typename L, typename R, typename Op>
+  class matrix_binary_expression : public matrix_expression<T, matrix_binary_expression<T,L,R,Op> >
+  {
+  public:
+    // exceptions: std::invalid_argument
+    matrix_binary_expression(const L& left, const R& right) ;
+    unsigned rows(void) const ;
+    unsigned columns(void) const ;
+    T element(std::size_t i) const ;
+
+  private:
+    typename matrix_operand<T,L>::type m_left;
+    typename matrix_operand<T,R>::type m_right;
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // arithmetic
+  // These work for any T with + and * where T() is zero, but are written for
+  // the built-in arithmetic types: the inner loops run along contiguous rows
+  // so that the compiler can vectorise them.
+
+  // element-wise sum, difference and product of two matrices or expressions of the same shape
+  // these build an expression which is evaluated when assigned to a matrix
+  // exceptions: std::invalid_argument
+  template<typename T, typename L, typename R>
+  matrix_binary_expression<T,L,R,matrix_plus<T> > operator + (const matrix_expression<T,L>& left, const matrix_expression<T,R>& right);
+  // exceptions: std::invalid_argument
+  template<typename T, typename L, typename R>
+  matrix_binary_expression<T,L,R,matrix_minus<T> > operator - (const matrix_expression<T,L>& left, const matrix_expression<T,R>& right);
+  // exceptions: std::invalid_argument
+  template<typename T, typename L, typename R>
+  matrix_binary_expression<T,L,R,matrix_times<T> > operator * (const matrix_expression<T,L>& left, const matrix_expression<T,R>& right);
+
+  // matrix product: result = left * right, where left.columns() == right.rows()
+  // The product is computed in cache-sized blocks, accumulating a 4x16 tile of
+  // the result at a time so that it can be held in registers.
+  // threads: 1 runs on the calling thread, n > 1 shares the rows of the result
+  // between n worker threads, 0 uses one worker per hardware thread if the
+  // product is large enough to be worth it. Workers need C++11 threads,
+  // otherwise the product is always computed on the calling thread.
+  // result may be the same matrix as left or right
+  // exceptions: std::invalid_argument
+  template<typename T>
+  void multiply(const matrix<T>& left, const matrix<T>& right, matrix<T>& result, unsigned threads = 0);
+  // exceptions: std::invalid_argument
+  template<typename T>
+  matrix<T> multiply(const matrix<T>& left, const matrix<T>& right, unsigned threads = 0);
+
+  // matrix-vector product: y = alpha * a * x + beta * y
+  // x must have a.columns() elements and y must have a.rows() elements
+  // if beta is zero then y is not read and is resized if necessary
+  // exceptions: std::invalid_argument
+  template<typename T>
+  void gemv(const T& alpha, const matrix<T>& a, const std::vector<T>& x, const T& beta, std::vector<T>& y);
+
+  // scaled sum: y += alpha * x
+  // exceptions: std::invalid_argument
+  template<typename T>
+  void axpy(const T& alpha, const matrix<T>& x, matrix<T>& y);
+
   ////////////////////////////////////////////////////////////////////////////////
 
 } // end namespace stlplus
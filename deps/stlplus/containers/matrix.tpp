@@ -6,10 +6,169 @@
 //   License:   BSD License, see ../docs/license.html
 
 ////////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <cstring>
+#include <string>
 
 namespace stlplus
 {
 
+  ////////////////////////////////////////////////////////////////////////////////
+  // arithmetic types
+
+#define STLPLUS_MATRIX_ARITHMETIC(type) \
+  template<> struct matrix_arithmetic<type> \
+  { \
+    enum {value = 1}; \
+  }
+
+  STLPLUS_MATRIX_ARITHMETIC(bool);
+  STLPLUS_MATRIX_ARITHMETIC(char);
+  STLPLUS_MATRIX_ARITHMETIC(signed char);
+  STLPLUS_MATRIX_ARITHMETIC(unsigned char);
+  STLPLUS_MATRIX_ARITHMETIC(short);
+  STLPLUS_MATRIX_ARITHMETIC(unsigned short);
+  STLPLUS_MATRIX_ARITHMETIC(int);
+  STLPLUS_MATRIX_ARITHMETIC(unsigned);
+  STLPLUS_MATRIX_ARITHMETIC(long);
+  STLPLUS_MATRIX_ARITHMETIC(unsigned long);
+#ifdef STLPLUS_HAS_CXX11
+  STLPLUS_MATRIX_ARITHMETIC(long long);
+  STLPLUS_MATRIX_ARITHMETIC(unsigned long long);
+#endif
+  STLPLUS_MATRIX_ARITHMETIC(float);
+  STLPLUS_MATRIX_ARITHMETIC(double);
+  STLPLUS_MATRIX_ARITHMETIC(long double);
+
+#undef STLPLUS_MATRIX_ARITHMETIC
+
+  // test whether a value is represented by all-zero bytes, so that it can be filled with memset
+  template<typename T>
+  static bool matrix_zero_bytes(const T& item)
+  {
+    if (!matrix_arithmetic<T>::value) return false;
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&item);
+    for (unsigned i = 0; i < sizeof(T); i++)
+      if (bytes[i]) return false;
+    return true;
+  }
+
+  // Tiles of arithmetic types are transposed through a small contiguous
+  // buffer. Working directly between rows a large power of two apart would
+  // map every row of a tile onto the same few cache sets.
+
+  // read a rows x cols tile into the buffer, transposed, so buffer row c holds column c of the tile
+  template<typename T>
+  static void matrix_read_tile(const T* source, std::size_t stride, unsigned rows, unsigned cols, T* buffer, unsigned pitch)
+  {
+    for (unsigned r = 0; r < rows; r++, source += stride)
+      for (unsigned c = 0; c < cols; c++)
+        buffer[c * pitch + r] = source[c];
+  }
+
+  // write the first rows x cols elements of the buffer out to the matrix a row at a time
+  template<typename T>
+  static void matrix_write_tile(const T* buffer, unsigned pitch, unsigned rows, unsigned cols, T* destination, std::size_t stride)
+  {
+    for (unsigned r = 0; r < rows; r++, destination += stride, buffer += pitch)
+      std::memcpy(static_cast<void*>(destination), buffer, cols * sizeof(T));
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // expressions
+
+  template<typename T, typename E>
+  const E& matrix_expression<T,E>::self(void) const
+  {
+    return static_cast<const E&>(*this);
+  }
+
+  template<typename T>
+  matrix_leaf<T>::matrix_leaf(const matrix<T>& data) :
+    m_data(data.data()), m_rows(data.rows()), m_cols(data.columns())
+  {
+  }
+
+  template<typename T>
+  unsigned matrix_leaf<T>::rows(void) const
+  {
+    return m_rows;
+  }
+
+  template<typename T>
+  unsigned matrix_leaf<T>::columns(void) const
+  {
+    return m_cols;
+  }
+
+  template<typename T>
+  const T& matrix_leaf<T>::element(std::size_t i) const
+  {
+    return m_data[i];
+  }
+
+  template<typename T, typename L, typename R, typename Op>
+  matrix_binary_expression<T,L,R,Op>::matrix_binary_expression(const L& left, const R& right) :
+    m_left(left), m_right(right)
+  {
+    if (left.rows() != right.rows() || left.columns() != right.columns())
+      throw std::invalid_argument("stlplus::matrix - element-wise operation on matrices of different shapes");
+  }
+
+  template<typename T, typename L, typename R, typename Op>
+  unsigned matrix_binary_expression<T,L,R,Op>::rows(void) const
+  {
+    return m_left.rows();
+  }
+
+  template<typename T, typename L, typename R, typename Op>
+  unsigned matrix_binary_expression<T,L,R,Op>::columns(void) const
+  {
+    return m_left.columns();
+  }
+
+  template<typename T, typename L, typename R, typename Op>
+  T matrix_binary_expression<T,L,R,Op>::element(std::size_t i) const
+  {
+    return Op::apply(m_left.element(i), m_right.element(i));
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // storage management
+  // The elements are constructed in place in an over-allocated raw block,
+  // using the standard uninitialised algorithms which destroy any elements
+  // already constructed if a constructor throws
+
+  template<typename T>
+  T* matrix<T>::allocate(std::size_t size, void*& block)
+  {
+    block = 0;
+    if (size == 0) return 0;
+    block = ::operator new(size * sizeof(T) + alignment);
+    std::size_t address = reinterpret_cast<std::size_t>(block);
+    return reinterpret_cast<T*>((address + alignment - 1) & ~(std::size_t)(alignment - 1));
+  }
+
+  template<typename T>
+  void matrix<T>::release(T* data, std::size_t size, void* block)
+  {
+    for (std::size_t i = 0; i < size; i++)
+      data[i].~T();
+    ::operator delete(block);
+  }
+
+  template<typename T>
+  void matrix<T>::adopt(T* data, void* block, unsigned rows, unsigned cols)
+  {
+    release(m_data, (std::size_t)m_rows * m_cols, m_block);
+    m_data = data;
+    m_block = block;
+    m_rows = rows;
+    m_cols = cols;
+  }
+
   ////////////////////////////////////////////////////////////////////////////////
 
   template<typename T>
@@ -18,15 +177,14 @@ namespace stlplus
     m_rows = 0;
     m_cols = 0;
     m_data = 0;
+    m_block = 0;
     resize(rows,cols,fill);
   }
 
   template<typename T>
   matrix<T>::~matrix(void)
   {
-    for (unsigned row = 0; row < m_rows; row++)
-      delete[] m_data[row];
-    delete[] m_data;
+    release(m_data, (std::size_t)m_rows * m_cols, m_block);
   }
 
   template<typename T>
@@ -35,57 +193,96 @@ namespace stlplus
     m_rows = 0;
     m_cols = 0;
     m_data = 0;
+    m_block = 0;
     *this = r;
   }
 
   template<typename T>
-  matrix<T>& matrix<T>::operator =(const matrix<T>& right)
+  template<typename E>
+  matrix<T>::matrix(const matrix_expression<T,E>& expression)
   {
-    // clear the old values
-    for (unsigned row = 0; row < m_rows; row++)
-      delete[] m_data[row];
-    delete[] m_data;
     m_rows = 0;
     m_cols = 0;
     m_data = 0;
-    // now reconstruct with the new
-    resize(right.m_rows, right.m_cols);
-    for (unsigned row = 0; row < m_rows; row++)
-      for (unsigned col = 0; col < m_cols; col++)
-        m_data[row][col] = right.m_data[row][col];
+    m_block = 0;
+    *this = expression;
+  }
+
+  template<typename T>
+  template<typename E>
+  matrix<T>& matrix<T>::operator =(const matrix_expression<T,E>& expression)
+  {
+    // evaluate the whole expression in one pass
+    // if the shape is changing then this matrix cannot be one of the
+    // operands, since they all have the shape of the result
+    typename matrix_operand<T,E>::type right(expression.self());
+    if (right.rows() != m_rows || right.columns() != m_cols)
+    {
+      resize(0, 0);
+      resize(right.rows(), right.columns());
+    }
+    std::size_t size = (std::size_t)m_rows * m_cols;
+    for (std::size_t i = 0; i < size; i++)
+      m_data[i] = right.element(i);
+    return *this;
+  }
+
+  template<typename T>
+  matrix<T>& matrix<T>::operator =(const matrix<T>& right)
+  {
+    if (this == &right) return *this;
+    std::size_t size = (std::size_t)right.m_rows * right.m_cols;
+    if (right.m_rows == m_rows && right.m_cols == m_cols)
+    {
+      // same shape, so the existing storage can be reused
+      std::copy(right.m_data, right.m_data + size, m_data);
+      return *this;
+    }
+    void* block = 0;
+    T* data = allocate(size, block);
+    try
+    {
+      std::uninitialized_copy(right.m_data, right.m_data + size, data);
+    }
+    catch(...)
+    {
+      ::operator delete(block);
+      throw;
+    }
+    adopt(data, block, right.m_rows, right.m_cols);
     return *this;
   }
 
   template<typename T>
   void matrix<T>::resize(unsigned rows, unsigned cols, const T& fill)
   {
-    // a grid is an array of rows, where each row is an array of T
-    // a zero-row or zero-column matrix has a null grid
-    // TODO - make this exception-safe - new could throw here and that would cause a memory leak
-    T** new_grid = 0;
-    if (rows && cols)
+    // a zero-row or zero-column matrix has no storage
+    if (rows == m_rows && cols == m_cols) return;
+    void* block = 0;
+    T* data = allocate((std::size_t)rows * cols, block);
+    try
     {
-      new_grid = new T*[rows];
-      for (unsigned row = 0; row < rows; row++)
-      {
-        new_grid[row] = new T[cols];
-        // copy old items to the new grid but only within the bounds of the intersection of the old and new grids
-        // fill the rest of the grid with the initial value
-        for (unsigned col = 0; col < cols; col++)
-          if (row < m_rows && col < m_cols)
-            new_grid[row][col] = m_data[row][col];
-          else
-            new_grid[row][col] = fill;
-      }
+      std::uninitialized_fill(data, data + (std::size_t)rows * cols, fill);
     }
-    // destroy the old grid
-    for (unsigned row = 0; row < m_rows; row++)
-      delete[] m_data[row];
-    delete[] m_data;
-    // move the new data into the matrix
-    m_data = new_grid;
-    m_rows = rows;
-    m_cols = cols;
+    catch(...)
+    {
+      ::operator delete(block);
+      throw;
+    }
+    // copy old items to the new grid but only within the bounds of the intersection of the old and new grids
+    unsigned copy_rows = std::min(rows, m_rows);
+    unsigned copy_cols = std::min(cols, m_cols);
+    try
+    {
+      for (unsigned row = 0; row < copy_rows; row++)
+        std::copy(row_span(row), row_span(row) + copy_cols, data + (std::size_t)row * cols);
+    }
+    catch(...)
+    {
+      release(data, (std::size_t)rows * cols, block);
+      throw;
+    }
+    adopt(data, block, rows, cols);
   }
 
   template<typename T>
@@ -103,9 +300,12 @@ namespace stlplus
   template<typename T>
   void matrix<T>::erase(const T& fill)
   {
-    for (unsigned row = 0; row < m_rows; row++)
-      for (unsigned col = 0; col < m_cols; col++)
-        insert(row,col,fill);
+    // zero is by far the most common fill, and memset is the fastest way of writing it
+    // otherwise std::fill over contiguous arithmetic data is vectorised by the compiler
+    if (m_data && matrix_zero_bytes(fill))
+      std::memset(static_cast<void*>(m_data), 0, (std::size_t)m_rows * m_cols * sizeof(T));
+    else
+      std::fill(m_data, m_data + (std::size_t)m_rows * m_cols, fill);
   }
 
   template<typename T>
@@ -119,7 +319,7 @@ namespace stlplus
   {
     if (row >= m_rows) throw std::out_of_range("matrix::insert row");
     if (col >= m_cols) throw std::out_of_range("matrix::insert col");
-    m_data[row][col] = element;
+    m_data[(std::size_t)row * m_cols + col] = element;
   }
 
   template<typename T>
@@ -127,7 +327,7 @@ namespace stlplus
   {
     if (row >= m_rows) throw std::out_of_range("matrix::item row");
     if (col >= m_cols) throw std::out_of_range("matrix::item col");
-    return m_data[row][col];
+    return m_data[(std::size_t)row * m_cols + col];
   }
 
   template<typename T>
@@ -135,7 +335,7 @@ namespace stlplus
   {
     if (row >= m_rows) throw std::out_of_range("matrix::item row");
     if (col >= m_cols) throw std::out_of_range("matrix::item col");
-    return m_data[row][col];
+    return m_data[(std::size_t)row * m_cols + col];
   }
 
   template<typename T>
@@ -143,7 +343,7 @@ namespace stlplus
   {
     if (row >= m_rows) throw std::out_of_range("matrix::operator() row");
     if (col >= m_cols) throw std::out_of_range("matrix::operator() col");
-    return m_data[row][col];
+    return m_data[(std::size_t)row * m_cols + col];
   }
 
   template<typename T>
@@ -151,7 +351,7 @@ namespace stlplus
   {
     if (row >= m_rows) throw std::out_of_range("matrix::operator() row");
     if (col >= m_cols) throw std::out_of_range("matrix::operator() col");
-    return m_data[row][col];
+    return m_data[(std::size_t)row * m_cols + col];
   }
 
   template<typename T>
@@ -164,30 +364,40 @@ namespace stlplus
   void matrix<T>::fill_column(unsigned col, const T& item)
   {
     if (col >= m_cols) throw std::out_of_range("matrix::fill_column");
-    for (unsigned row = 0; row < m_rows; row++)
-      insert(row, col, item);
+    T* end = m_data + (std::size_t)m_rows * m_cols;
+    for (T* element = m_data + col; element < end; element += m_cols)
+      *element = item;
   }
 
   template<typename T>
   void matrix<T>::fill_row(unsigned row, const T& item)
   {
     if (row >= m_rows) throw std::out_of_range("matrix::fill_row");
-    for (unsigned col = 0; col < m_cols; col++)
-      insert(row, col, item);
+    if (matrix_zero_bytes(item))
+      std::memset(static_cast<void*>(row_span(row)), 0, m_cols * sizeof(T));
+    else
+      std::fill(row_span(row), row_span(row) + m_cols, item);
   }
 
   template<typename T>
   void matrix<T>::fill_leading_diagonal(const T& item)
   {
-    for (unsigned i = 0; i < m_cols && i < m_rows; i++)
-      insert(i, i, item);
+    // the leading diagonal is every (columns+1)th element
+    unsigned n = std::min(m_rows, m_cols);
+    T* element = m_data;
+    for (unsigned i = 0; i < n; i++, element += m_cols + 1)
+      *element = item;
   }
 
   template<typename T>
   void matrix<T>::fill_trailing_diagonal(const T& item)
   {
-    for (unsigned i = 0; i < m_cols && i < m_rows; i++)
-      insert(i, m_cols-i-1, item);
+    // the trailing diagonal is every (columns-1)th element starting from the end of row 0
+    unsigned n = std::min(m_rows, m_cols);
+    if (n == 0) return;
+    T* element = m_data + m_cols - 1;
+    for (unsigned i = 0; i < n; i++, element += m_cols - 1)
+      *element = item;
   }
 
   template<typename T>
@@ -200,13 +410,375 @@ namespace stlplus
   template<typename T>
   void matrix<T>::transpose(void)
   {
-    // no gain in manipulating this, since building a new matrix is no less efficient
-    matrix<T> transposed(columns(), rows());
-    for (unsigned row = 0; row < rows(); row++)
-      for (unsigned col = 0; col < columns(); col++)
-        transposed.insert(col,row,item(row,col));
-    // TODO - avoid an extra copy by swapping the member data here
-    *this = transposed;
+    if (m_rows == m_cols && matrix_arithmetic<T>::value)
+    {
+      // square - exchange each tile above the diagonal with its mirror tile
+      // below the diagonal by way of two buffers
+      unsigned n = m_rows;
+      T upper[transpose_tile * transpose_tile];
+      T lower[transpose_tile * transpose_tile];
+      for (unsigned r0 = 0; r0 < n; r0 += transpose_tile)
+      {
+        unsigned rs = std::min((unsigned)transpose_tile, n - r0);
+        for (unsigned c0 = r0; c0 < n; c0 += transpose_tile)
+        {
+          unsigned cs = std::min((unsigned)transpose_tile, n - c0);
+          T* a = m_data + (std::size_t)r0 * n + c0;
+          T* b = m_data + (std::size_t)c0 * n + r0;
+          matrix_read_tile(a, n, rs, cs, upper, transpose_tile);
+          if (c0 != r0)
+          {
+            matrix_read_tile(b, n, cs, rs, lower, transpose_tile);
+            matrix_write_tile(lower, transpose_tile, rs, cs, a, n);
+          }
+          matrix_write_tile(upper, transpose_tile, cs, rs, b, n);
+        }
+      }
+      return;
+    }
+    if (m_rows == m_cols)
+    {
+      // square - swap each tile above the diagonal with its mirror tile below
+      // the diagonal, which are both small enough to stay in cache
+      unsigned n = m_rows;
+      for (unsigned r0 = 0; r0 < n; r0 += transpose_tile)
+      {
+        unsigned r1 = std::min(r0 + transpose_tile, n);
+        for (unsigned c0 = r0; c0 < n; c0 += transpose_tile)
+        {
+          unsigned c1 = std::min(c0 + transpose_tile, n);
+          for (unsigned r = r0; r < r1; r++)
+            for (unsigned c = std::max(c0, r+1); c < c1; c++)
+              std::swap(m_data[(std::size_t)r * n + c], m_data[(std::size_t)c * n + r]);
+        }
+      }
+      return;
+    }
+    // otherwise build the transposed elements in new storage and then swap it in
+    std::size_t size = (std::size_t)m_rows * m_cols;
+    void* block = 0;
+    T* data = allocate(size, block);
+    if (matrix_arithmetic<T>::value)
+    {
+      // arithmetic types need no construction, so the new storage can be written a tile at a time
+      T buffer[transpose_tile * transpose_tile];
+      for (unsigned r0 = 0; r0 < m_rows; r0 += transpose_tile)
+      {
+        unsigned rs = std::min((unsigned)transpose_tile, m_rows - r0);
+        for (unsigned c0 = 0; c0 < m_cols; c0 += transpose_tile)
+        {
+          unsigned cs = std::min((unsigned)transpose_tile, m_cols - c0);
+          matrix_read_tile(m_data + (std::size_t)r0 * m_cols + c0, m_cols, rs, cs, buffer, transpose_tile);
+          matrix_write_tile(buffer, transpose_tile, cs, rs, data + (std::size_t)c0 * m_rows + r0, m_rows);
+        }
+      }
+    }
+    else
+    {
+      // construct in storage order so that a throwing copy can be unwound
+      std::size_t done = 0;
+      try
+      {
+        for (unsigned col = 0; col < m_cols; col++)
+          for (unsigned row = 0; row < m_rows; row++, done++)
+            new(data + done) T(m_data[(std::size_t)row * m_cols + col]);
+      }
+      catch(...)
+      {
+        release(data, done, block);
+        throw;
+      }
+    }
+    adopt(data, block, m_cols, m_rows);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // element-wise arithmetic
+
+  template<typename L, typename R>
+  static void matrix_check_shape(const L& left, const R& right, const char* operation)
+  {
+    if (left.rows() != right.rows() || left.columns() != right.columns())
+      throw std::invalid_argument(std::string("matrix::") + operation + " - matrices are different shapes");
+  }
+
+  template<typename T>
+  template<typename E>
+  matrix<T>& matrix<T>::operator += (const matrix_expression<T,E>& expression)
+  {
+    typename matrix_operand<T,E>::type right(expression.self());
+    matrix_check_shape(*this, right, "operator+=");
+    // each element only depends on the same element of the operands, so this is safe even if this matrix is one of them
+    std::size_t size = (std::size_t)m_rows * m_cols;
+    for (std::size_t i = 0; i < size; i++)
+      m_data[i] += right.element(i);
+    return *this;
+  }
+
+  template<typename T>
+  template<typename E>
+  matrix<T>& matrix<T>::operator -= (const matrix_expression<T,E>& expression)
+  {
+    typename matrix_operand<T,E>::type right(expression.self());
+    matrix_check_shape(*this, right, "operator-=");
+    std::size_t size = (std::size_t)m_rows * m_cols;
+    for (std::size_t i = 0; i < size; i++)
+      m_data[i] -= right.element(i);
+    return *this;
+  }
+
+  template<typename T>
+  template<typename E>
+  matrix<T>& matrix<T>::operator *= (const matrix_expression<T,E>& expression)
+  {
+    typename matrix_operand<T,E>::type right(expression.self());
+    matrix_check_shape(*this, right, "operator*=");
+    std::size_t size = (std::size_t)m_rows * m_cols;
+    for (std::size_t i = 0; i < size; i++)
+      m_data[i] *= right.element(i);
+    return *this;
+  }
+
+  template<typename T, typename L, typename R>
+  matrix_binary_expression<T,L,R,matrix_plus<T> > operator + (const matrix_expression<T,L>& left, const matrix_expression<T,R>& right)
+  {
+    return matrix_binary_expression<T,L,R,matrix_plus<T> >(left.self(), right.self());
+  }
+
+  template<typename T, typename L, typename R>
+  matrix_binary_expression<T,L,R,matrix_minus<T> > operator - (const matrix_expression<T,L>& left, const matrix_expression<T,R>& right)
+  {
+    return matrix_binary_expression<T,L,R,matrix_minus<T> >(left.self(), right.self());
+  }
+
+  template<typename T, typename L, typename R>
+  matrix_binary_expression<T,L,R,matrix_times<T> > operator * (const matrix_expression<T,L>& left, const matrix_expression<T,R>& right)
+  {
+    return matrix_binary_expression<T,L,R,matrix_times<T> >(left.self(), right.self());
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // matrix product
+
+  // sizes of the blocks of the product - a block of the right-hand matrix of
+  // matrix_block_depth rows by matrix_block_width columns is reused from cache
+  // for every row of the left-hand matrix, while a tile of matrix_tile_rows x
+  // matrix_tile_columns of the result is accumulated in registers
+  enum {matrix_block_depth = 256, matrix_block_width = 256, matrix_tile_rows = 4, matrix_tile_columns = 16};
+
+  // products with fewer multiply-adds than this are not worth sharing between threads
+  static const double matrix_parallel_threshold = 16777216.0;
+
+  // add the product of rows [first,last) of a (n columns) and b (p columns) into the same rows of c (p columns)
+  template<typename T>
+  static void matrix_multiply_rows(const T* a, const T* b, T* c, unsigned first, unsigned last, unsigned n, unsigned p)
+  {
+    const unsigned NR = matrix_tile_columns;
+    for (unsigned k0 = 0; k0 < n; k0 += matrix_block_depth)
+    {
+      unsigned k1 = std::min(k0 + (unsigned)matrix_block_depth, n);
+      for (unsigned j0 = 0; j0 < p; j0 += matrix_block_width)
+      {
+        unsigned j1 = std::min(j0 + (unsigned)matrix_block_width, p);
+        unsigned i = first;
+        for (; i + matrix_tile_rows <= last; i += matrix_tile_rows)
+        {
+          const T* a0 = a + (std::size_t)i * n;
+          const T* a1 = a0 + n;
+          const T* a2 = a1 + n;
+          const T* a3 = a2 + n;
+          unsigned j = j0;
+          for (; j + NR <= j1; j += NR)
+          {
+            // a full tile - the accumulators are fixed-size so that they can live in registers
+            T r0[NR], r1[NR], r2[NR], r3[NR];
+            for (unsigned q = 0; q < NR; q++)
+              r0[q] = r1[q] = r2[q] = r3[q] = T();
+            for (unsigned k = k0; k < k1; k++)
+            {
+              const T* bk = b + (std::size_t)k * p + j;
+              T x0 = a0[k], x1 = a1[k], x2 = a2[k], x3 = a3[k];
+              for (unsigned q = 0; q < NR; q++)
+              {
+                T bv = bk[q];
+                r0[q] += x0 * bv;
+                r1[q] += x1 * bv;
+                r2[q] += x2 * bv;
+                r3[q] += x3 * bv;
+              }
+            }
+            T* c0 = c + (std::size_t)i * p + j;
+            for (unsigned q = 0; q < NR; q++)
+            {
+              c0[q] += r0[q];
+              c0[p+q] += r1[q];
+              c0[2*p+q] += r2[q];
+              c0[3*p+q] += r3[q];
+            }
+          }
+          // the remaining columns of these rows
+          for (unsigned r = 0; r < matrix_tile_rows; r++)
+          {
+            const T* ar = a0 + (std::size_t)r * n;
+            T* cr = c + (std::size_t)(i + r) * p;
+            for (unsigned k = k0; k < k1; k++)
+            {
+              const T* bk = b + (std::size_t)k * p;
+              for (unsigned q = j; q < j1; q++)
+                cr[q] += ar[k] * bk[q];
+            }
+          }
+        }
+        // the remaining rows
+        for (; i < last; i++)
+        {
+          const T* ai = a + (std::size_t)i * n;
+          T* ci = c + (std::size_t)i * p;
+          for (unsigned k = k0; k < k1; k++)
+          {
+            const T* bk = b + (std::size_t)k * p;
+            for (unsigned q = j0; q < j1; q++)
+              ci[q] += ai[k] * bk[q];
+          }
+        }
+      }
+    }
+  }
+
+  template<typename T>
+  void multiply(const matrix<T>& left, const matrix<T>& right, matrix<T>& result, unsigned threads)
+  {
+    if (left.columns() != right.rows())
+      throw std::invalid_argument("stlplus::multiply - left matrix columns do not match right matrix rows");
+    if (&result == &left || &result == &right)
+    {
+      // the inputs are still needed while the result is built
+      matrix<T> product;
+      multiply(left, right, product, threads);
+      result = product;
+      return;
+    }
+    unsigned m = left.rows();
+    unsigned n = left.columns();
+    unsigned p = right.columns();
+    result.resize(m, p);
+    result.fill(T());
+    if (m == 0 || n == 0 || p == 0) return;
+    const T* a = left.data();
+    const T* b = right.data();
+    T* c = result.data();
+#ifdef STLPLUS_HAS_CXX11
+    if (threads == 0 && (double)m * n * p < matrix_parallel_threshold)
+      threads = 1;
+    if (threads != 1)
+    {
+      // share out the rows of the result in whole tiles, several chunks per
+      // thread so that the work stays balanced
+      task_pool pool(threads);
+      unsigned chunks = pool.threads() * 4;
+      unsigned rows = (m + chunks - 1) / chunks;
+      rows = (rows + matrix_tile_rows - 1) / matrix_tile_rows * matrix_tile_rows;
+      for (unsigned first = 0; first < m; first += rows)
+      {
+        unsigned last = std::min(first + rows, m);
+        pool.submit([=]{matrix_multiply_rows(a, b, c, first, last, n, p);});
+      }
+      pool.wait();
+      return;
+    }
+#else
+    (void)threads;
+#endif
+    matrix_multiply_rows(a, b, c, 0, m, n, p);
+  }
+
+  template<typename T>
+  matrix<T> multiply(const matrix<T>& left, const matrix<T>& right, unsigned threads)
+  {
+    matrix<T> result;
+    multiply(left, right, result, threads);
+    return result;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // matrix-vector operations
+
+  template<typename T>
+  void gemv(const T& alpha, const matrix<T>& a, const std::vector<T>& x, const T& beta, std::vector<T>& y)
+  {
+    unsigned m = a.rows();
+    unsigned n = a.columns();
+    if (x.size() != n)
+      throw std::invalid_argument("stlplus::gemv - vector x does not match matrix columns");
+    bool zero_beta = beta == T();
+    if (zero_beta)
+      y.resize(m);
+    else if (y.size() != m)
+      throw std::invalid_argument("stlplus::gemv - vector y does not match matrix rows");
+    for (unsigned i = 0; i < m; i++)
+    {
+      // four partial sums break the dependency chain between the additions
+      const T* row = a.data() + (std::size_t)i * a.stride();
+      T s0 = T(), s1 = T(), s2 = T(), s3 = T();
+      unsigned k = 0;
+      for (; k + 4 <= n; k += 4)
+      {
+        s0 += row[k] * x[k];
+        s1 += row[k+1] * x[k+1];
+        s2 += row[k+2] * x[k+2];
+        s3 += row[k+3] * x[k+3];
+      }
+      for (; k < n; k++)
+        s0 += row[k] * x[k];
+      T dot = (s0 + s1) + (s2 + s3);
+      y[i] = zero_beta ? alpha * dot : alpha * dot + beta * y[i];
+    }
+  }
+
+  template<typename T>
+  void axpy(const T& alpha, const matrix<T>& x, matrix<T>& y)
+  {
+    matrix_check_shape(x, y, "axpy");
+    std::size_t size = (std::size_t)x.rows() * x.columns();
+    const T* source = x.data();
+    T* destination = y.data();
+    for (std::size_t i = 0; i < size; i++)
+      destination[i] += alpha * source[i];
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // direct access
+
+  template<typename T>
+  const T* matrix<T>::data(void) const
+  {
+    return m_data;
+  }
+
+  template<typename T>
+  T* matrix<T>::data(void)
+  {
+    return m_data;
+  }
+
+  template<typename T>
+  unsigned matrix<T>::stride(void) const
+  {
+    return m_cols;
+  }
+
+  template<typename T>
+  const T* matrix<T>::row_span(unsigned row) const
+  {
+    if (row >= m_rows) throw std::out_of_range("matrix::row_span");
+    return m_data + (std::size_t)row * m_cols;
+  }
+
+  template<typename T>
+  T* matrix<T>::row_span(unsigned row)
+  {
+    if (row >= m_rows) throw std::out_of_range("matrix::row_span");
+    return m_data + (std::size_t)row * m_cols;
   }
 
   ////////////////////////////////////////////////////////////////////////////////
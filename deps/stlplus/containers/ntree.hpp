@@ -17,6 +17,7 @@
 #include "containers_fixes.hpp"
 #include "exceptions.hpp"
 #include "safe_iterator.hpp"
+#include "task_pool.hpp"
 #include <vector>
 #include <iterator>
 
@@ -28,6 +29,7 @@ namespace stlplus
 
   template<typename T> class ntree_node;
   template<typename T> class ntree;
+  template<typename T> class flat_ntree;
   template<typename T, typename TRef, typename TPtr> class ntree_iterator;
   template<typename T, typename TRef, typename TPtr> class ntree_prefix_iterator;
   template<typename T, typename TRef, typename TPtr> class ntree_postfix_iterator;
@@ -269,6 +271,10 @@ namespace stlplus
 
     //////////////////////////////////////////////////////////////////////////////
     // size tests
+    // Every node records the size of its subtree and its depth, so these are
+    // all constant-time. In return, adding or removing nodes updates the sizes
+    // on the path to the root, and moving a subtree to a different level
+    // (move, cut, push and pop) updates the depths within the subtree.
 
     // tests on whole tree
     bool empty(void) const;
@@ -305,7 +311,9 @@ namespace stlplus
     // exceptions: wrong_object,null_dereference,end_dereference,std::out_of_range
     iterator child(const iterator& node, unsigned child);
 
-    // search a node's children array to find a child given its iterator
+    // find a child's offset into the node's children array given its iterator
+    // returns (unsigned)-1 if child is not a child of node
+    // every node records its own offset, so this is a constant-time operation
     // exceptions: wrong_object,null_dereference,end_dereference
     unsigned child_offset(const const_iterator& node, const const_iterator& child) const;
     // exceptions: wrong_object,null_dereference,end_dereference
@@ -317,6 +325,17 @@ namespace stlplus
     // exceptions: wrong_object,null_dereference,end_dereference
     iterator parent(const iterator& node);
 
+    // move sideways to the next or previous child of the same parent
+    // returns the null iterator if there is no such sibling, including for the root
+    // exceptions: wrong_object,null_dereference,end_dereference
+    const_iterator next_sibling(const const_iterator& node) const;
+    // exceptions: wrong_object,null_dereference,end_dereference
+    iterator next_sibling(const iterator& node);
+    // exceptions: wrong_object,null_dereference,end_dereference
+    const_iterator prev_sibling(const const_iterator& node) const;
+    // exceptions: wrong_object,null_dereference,end_dereference
+    iterator prev_sibling(const iterator& node);
+
     //////////////////////////////////////////////////////////////////////////////
     // iterator traversal
 
@@ -444,9 +463,126 @@ namespace stlplus
     void swap(const iterator& node, unsigned child1, unsigned child2);
 
     //////////////////////////////////////////////////////////////////////////////
+    // parallel traversal
+    // The subtree is divided into parts: subtrees of no more than cutoff nodes,
+    // which are each processed sequentially, and the larger nodes above them.
+    // Consecutive parts are grouped into tasks of up to cutoff nodes, which
+    // are run on a pool of worker threads (0 means one per hardware thread).
+    // Without C++11 threads the whole subtree is processed sequentially in
+    // prefix order.
+    // The callbacks are called from several threads at once, so must be
+    // thread-safe and must not change the structure of the tree. Iterators
+    // to a node share a reference count that is not thread-safe, so a
+    // callback may use the iterator it is given but must not make iterators
+    // to other nodes, such as the parent or children, that other calls may
+    // be using at the same time.
+    // If a callback throws, the first exception is rethrown when the rest
+    // of the work has finished
+
+    // call fn(tree,iterator) once for every node in the subtree, in no particular order
+    // passing the end iterator does nothing
+    // exceptions: wrong_object,null_dereference
+    template<typename F>
+    void parallel_for_each(const const_iterator& node, F fn, unsigned threads = 0, unsigned cutoff = 1024) const;
+    // exceptions: wrong_object,null_dereference
+    template<typename F>
+    void parallel_for_each(const iterator& node, F fn, unsigned threads = 0, unsigned cutoff = 1024);
+
+    // reduce the subtree to a single value of type R by calling map(tree,iterator)
+    // for every node and merging the results with combine(R,R)
+    // The results are combined in prefix order, so combine need not be
+    // commutative but must be associative. R must be default-constructible and
+    // the result for the end iterator is R()
+    // Use in the form: tree.parallel_reduce<R>(node, map, combine)
+    // exceptions: wrong_object,null_dereference
+    template<typename R, typename M, typename C>
+    R parallel_reduce(const const_iterator& node, M map, C combine, unsigned threads = 0, unsigned cutoff = 1024) const;
+    // exceptions: wrong_object,null_dereference
+    template<typename R, typename M, typename C>
+    R parallel_reduce(const iterator& node, M map, C combine, unsigned threads = 0, unsigned cutoff = 1024) const;
+
+    //////////////////////////////////////////////////////////////////////////////
+    // flattening
+
+    // make a flat_ntree snapshot of the tree, with the nodes laid out in prefix order
+    flat_ntree<T> compact(void) const;
+
+    //////////////////////////////////////////////////////////////////////////////
 
   private:
     ntree_node<T>* m_root;
+
+    // common part of the parallel traversals - calls visit(node) for every node in the subtree
+    template<typename V>
+    void parallel_visit(ntree_node<T>* root, V& visit, unsigned threads, unsigned cutoff) const;
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // The Flat Ntree class
+  // A snapshot of an ntree with the nodes stored in prefix order in contiguous
+  // arrays, made by ntree::compact(). This is for fast read-mostly traversal of
+  // large trees: a prefix traversal is a scan through the arrays and the
+  // subtree of a node is the range of nodes [node,subtree_end(node)).
+  // Nodes are referred to by their position in the prefix order, so the root
+  // is node 0. The node data can be changed but the shape of the tree cannot.
+  ////////////////////////////////////////////////////////////////////////////////
+
+  template<typename T>
+  class flat_ntree
+  {
+  public:
+    typedef T value_type;
+
+    // a value representing no node, e.g. the parent of the root
+    // Note that it's static so use in the form flat_ntree<T>::npos()
+    static unsigned npos(void);
+
+    // create an empty tree - use ntree::compact() to create a populated one
+    flat_ntree(void);
+
+    // number of nodes in the whole tree
+    bool empty(void) const;
+    unsigned size(void) const;
+
+    // access the node data
+    // exceptions: std::out_of_range
+    const T& operator[](unsigned node) const;
+    // exceptions: std::out_of_range
+    T& operator[](unsigned node);
+
+    // the parent of the node, npos for the root
+    // exceptions: std::out_of_range
+    unsigned parent(unsigned node) const;
+    // the first child of the node, npos for a leaf
+    // in prefix order this is always the next node, if it is in the subtree
+    // exceptions: std::out_of_range
+    unsigned first_child(unsigned node) const;
+    // the next child of the same parent, npos for the last child
+    // exceptions: std::out_of_range
+    unsigned next_sibling(unsigned node) const;
+    // one past the last node in the subtree of the node
+    // exceptions: std::out_of_range
+    unsigned subtree_end(unsigned node) const;
+    // the number of nodes in the subtree of the node
+    // exceptions: std::out_of_range
+    unsigned size(unsigned node) const;
+    // the number of children of the node
+    // exceptions: std::out_of_range
+    unsigned children(unsigned node) const;
+
+    // direct access to the arrays, all indexed by node
+    // the data array may be changed in place but must not be resized
+    const std::vector<T>& data(void) const;
+    std::vector<T>& data(void);
+    const std::vector<unsigned>& parents(void) const;
+    const std::vector<unsigned>& subtree_ends(void) const;
+
+  private:
+    friend class ntree<T>;
+
+    std::vector<T> m_data;
+    std::vector<unsigned> m_parents;
+    std::vector<unsigned> m_ends;
   };
 
   ////////////////////////////////////////////////////////////////////////////////
@@ -7,6 +7,7 @@
 
 ////////////////////////////////////////////////////////////////////////////////
 #include <vector>
+#include <deque>
 #include <algorithm>
 
 namespace stlplus
@@ -23,10 +24,16 @@ namespace stlplus
     T m_data;
     ntree_node<T>* m_parent;
     std::vector<ntree_node<T>*> m_children;
+    // number of nodes in the subtree rooted at this node, including this node
+    unsigned m_size;
+    // distance from the root, counting the root as 1
+    unsigned m_depth;
+    // position of this node in its parent's children array, 0 for the root
+    unsigned m_offset;
 
   public:
-    ntree_node(const ntree<T>* owner, const T& data = T()) :
-      m_master(owner,this), m_data(data), m_parent(0)
+    ntree_node(const ntree<T>* owner, const T& data = T(), unsigned depth = 1) :
+      m_master(owner,this), m_data(data), m_parent(0), m_size(1), m_depth(depth), m_offset(0)
       {
       }
 
@@ -37,6 +44,14 @@ namespace stlplus
           (*i)->change_owner(owner);
       }
 
+    // set the depth of this node and its subtree after it has been moved
+    void change_depth(unsigned depth)
+      {
+        m_depth = depth;
+        for (typename std::vector<ntree_node<T>*>::iterator i = m_children.begin(); i != m_children.end(); i++)
+          (*i)->change_depth(depth+1);
+      }
+
     ~ntree_node(void)
       {
         m_parent = 0;
@@ -46,39 +61,160 @@ namespace stlplus
 
   };
 
+  // copy a subtree so that its root is at the given depth
   template<typename T>
-  static ntree_node<T>* ntree_copy(const ntree<T>* new_owner, ntree_node<T>* root)
+  static ntree_node<T>* ntree_copy(const ntree<T>* new_owner, ntree_node<T>* root, unsigned depth = 1)
   {
     if (!root) return 0;
-    ntree_node<T>* new_tree = new ntree_node<T>(new_owner, root->m_data);
+    ntree_node<T>* new_tree = new ntree_node<T>(new_owner, root->m_data, depth);
+    new_tree->m_children.reserve(root->m_children.size());
     for (typename std::vector<ntree_node<T>*>::iterator i = root->m_children.begin(); i != root->m_children.end(); i++)
     {
-      ntree_node<T>* new_child = ntree_copy(new_owner, *i);
+      ntree_node<T>* new_child = ntree_copy(new_owner, *i, depth+1);
+      new_child->m_offset = static_cast<unsigned>(new_tree->m_children.size());
       new_tree->m_children.push_back(new_child);
       new_child->m_parent = new_tree;
+      new_tree->m_size += new_child->m_size;
     }
     return new_tree;
   }
 
+  // Each node records its offset in its parent's children array. Inserting or
+  // removing a child shifts the ones after it, so their offsets are updated
+  // from the point of change onwards.
+
   template<typename T>
-  static unsigned ntree_size(ntree_node<T>* root)
+  static void ntree_renumber(ntree_node<T>* node, unsigned from)
   {
-    if (!root) return 0;
-    unsigned result = 1;
-    for (typename std::vector<ntree_node<T>*>::iterator i = root->m_children.begin(); i != root->m_children.end(); i++)
-      result += ntree_size(*i);
-    return result;
+    for (unsigned offset = from; offset < static_cast<unsigned>(node->m_children.size()); ++offset)
+      node->m_children[offset]->m_offset = offset;
+  }
+
+  // The subtree sizes are kept up to date as the tree is changed, so that the
+  // size of any subtree is known without walking it. Adding or removing a
+  // subtree changes the size of every node on the path back to the root.
+
+  template<typename T>
+  static void ntree_grow(ntree_node<T>* node, unsigned nodes)
+  {
+    for (; node; node = node->m_parent)
+      node->m_size += nodes;
   }
 
   template<typename T>
-  static unsigned ntree_depth(ntree_node<T>* root)
+  static void ntree_shrink(ntree_node<T>* node, unsigned nodes)
+  {
+    for (; node; node = node->m_parent)
+      node->m_size -= nodes;
+  }
+
+  // Helpers for the parallel traversals. A subtree is divided into a
+  // sequence of parts in prefix order, each of which is either a whole
+  // subtree of no more than cutoff nodes, or a single node whose subtree is
+  // larger than that. The subtree sizes make this a walk of just the top of
+  // the tree. Consecutive parts are grouped into tasks of up to cutoff nodes
+  // so that a node with many small children does not make a task for each
+  // one. tasks holds the first part of each task, followed by parts.size().
+
+  template<typename T>
+  static void ntree_partition(ntree_node<T>* root, unsigned cutoff,
+                              std::vector<ntree_node<T>*>& parts, std::vector<bool>& subtrees,
+                              std::vector<unsigned>& tasks)
+  {
+    unsigned task_nodes = 0;
+    std::vector<ntree_node<T>*> stack(1, root);
+    while (!stack.empty())
+    {
+      ntree_node<T>* node = stack.back();
+      stack.pop_back();
+      bool subtree = node->m_size <= cutoff;
+      unsigned nodes = subtree ? node->m_size : 1;
+      if (tasks.empty() || task_nodes + nodes > cutoff)
+      {
+        tasks.push_back((unsigned)parts.size());
+        task_nodes = 0;
+      }
+      task_nodes += nodes;
+      parts.push_back(node);
+      subtrees.push_back(subtree);
+      if (!subtree)
+        for (unsigned c = (unsigned)node->m_children.size(); c--; )
+          stack.push_back(node->m_children[c]);
+    }
+    tasks.push_back((unsigned)parts.size());
+  }
+
+  // visit every node of a subtree in prefix order
+  template<typename T, typename V>
+  static void ntree_visit(ntree_node<T>* root, V& visit)
   {
-    unsigned depth = 0;
-    for (ntree_node<T>* i = root; i; i = i->m_parent)
-      depth++;
-    return depth;
+    std::vector<ntree_node<T>*> stack(1, root);
+    while (!stack.empty())
+    {
+      ntree_node<T>* node = stack.back();
+      stack.pop_back();
+      visit(node);
+      for (unsigned c = (unsigned)node->m_children.size(); c--; )
+        stack.push_back(node->m_children[c]);
+    }
+  }
+
+  // visit the parts of one task in order
+  template<typename T, typename V>
+  static void ntree_visit_parts(const std::vector<ntree_node<T>*>& parts, const std::vector<bool>& subtrees,
+                                unsigned first, unsigned last, V& visit)
+  {
+    for (unsigned i = first; i < last; i++)
+    {
+      if (subtrees[i])
+        ntree_visit(parts[i], visit);
+      else
+        visit(parts[i]);
+    }
   }
 
+  // adaptor from a node visitor to the user's callback
+  template<typename Tree, typename Iterator, typename T, typename F>
+  class ntree_for_each_visitor
+  {
+  public:
+    Tree* m_tree;
+    F* m_fn;
+
+    ntree_for_each_visitor(Tree* tree, F* fn) : m_tree(tree), m_fn(fn)
+      {
+      }
+
+    void operator()(ntree_node<T>* node)
+      {
+        (*m_fn)(*m_tree, Iterator(node));
+      }
+  };
+
+  // node visitor that folds the mapped value of every node it visits into a result
+  template<typename T, typename R, typename M, typename C>
+  class ntree_reduce_visitor
+  {
+  public:
+    const ntree<T>* m_tree;
+    M* m_map;
+    C* m_combine;
+    R m_result;
+    bool m_empty;
+
+    ntree_reduce_visitor(const ntree<T>* tree, M* map, C* combine) :
+      m_tree(tree), m_map(map), m_combine(combine), m_result(), m_empty(true)
+      {
+      }
+
+    void operator()(ntree_node<T>* node)
+      {
+        R value = (*m_map)(*m_tree, ntree_iterator<T,const T&,const T*>(node));
+        m_result = m_empty ? value : (*m_combine)(m_result, value);
+        m_empty = false;
+      }
+  };
+
   ////////////////////////////////////////////////////////////////////////////////
   // ntree_iterator
 
@@ -268,15 +404,11 @@ namespace stlplus
         else
         {
           // otherwise walk down the next child - if there is one
-          // find which index the old node was relative to this node
-          typename std::vector<ntree_node<T>*>::iterator found =
-            std::find(parent->m_children.begin(), parent->m_children.end(), old_node);
-          // if this was found, then see if there is another and if so return that
-          found++;
-          if (found != parent->m_children.end())
+          unsigned next = old_node->m_offset + 1;
+          if (next < parent->m_children.size())
           {
             // visit the next child
-            m_iterator.set((*found)->m_master);
+            m_iterator.set(parent->m_children[next]->m_master);
             break;
           }
           else
@@ -428,15 +560,12 @@ namespace stlplus
     }
     else
     {
-      // otherwise find which index the old node was relative to this node
-      typename std::vector<ntree_node<T>*>::iterator found =
-        std::find(parent->m_children.begin(), parent->m_children.end(), old_node);
-      // if this was found, then see if there is another
-      found++;
-      if (found != parent->m_children.end())
+      // otherwise see if there is another child after this one
+      unsigned next = old_node->m_offset + 1;
+      if (next < parent->m_children.size())
       {
         // if so traverse to it and walk down the leftmost child pointers to the bottom of the new sub-tree
-        ntree_node<T>* new_node = *found;
+        ntree_node<T>* new_node = parent->m_children[next];
         while (!new_node->m_children.empty())
           new_node = new_node->m_children[0];
         m_iterator.set(new_node->m_master);
@@ -525,7 +654,7 @@ namespace stlplus
   template<typename T>
   unsigned ntree<T>::size(void) const
   {
-    return ntree_size(m_root);
+    return m_root ? m_root->m_size : 0;
   }
 
   template<typename T>
@@ -533,14 +662,14 @@ namespace stlplus
 
   {
     i.assert_valid(this);
-    return ntree_size(i.node());
+    return i.node()->m_size;
   }
 
   template<typename T>
   unsigned ntree<T>::size(const typename ntree<T>::iterator& i)
   {
     i.assert_valid(this);
-    return ntree_size(i.node());
+    return i.node()->m_size;
   }
 
   template<typename T>
@@ -548,14 +677,14 @@ namespace stlplus
 
   {
     i.assert_valid(this);
-    return ntree_depth(i.node());
+    return i.node()->m_depth;
   }
 
   template<typename T>
   unsigned ntree<T>::depth(const typename ntree<T>::iterator& i)
   {
     i.assert_valid(this);
-    return ntree_depth(i.node());
+    return i.node()->m_depth;
   }
 
   template<typename T>
@@ -610,12 +739,9 @@ namespace stlplus
   {
     root.assert_valid(this);
     child.assert_valid(this);
-    ntree_node<T>* root_node = root.node();
     ntree_node<T>* child_node = child.node();
-    for (unsigned offset = 0; offset < static_cast<unsigned>(root_node->m_children.size()); ++offset)
-      if (root_node->m_children[offset] == child_node)
-        return offset;
-    return static_cast<unsigned>(-1);
+    if (child_node->m_parent != root.node()) return static_cast<unsigned>(-1);
+    return child_node->m_offset;
   }
 
   template<typename T>
@@ -623,12 +749,9 @@ namespace stlplus
   {
     root.assert_valid(this);
     child.assert_valid(this);
-    ntree_node<T>* root_node = root.node();
     ntree_node<T>* child_node = child.node();
-    for (unsigned offset = 0; offset < static_cast<unsigned>(root_node->m_children.size()); ++offset)
-      if (root_node->m_children[offset] == child_node)
-        return offset;
-    return static_cast<unsigned>(-1);
+    if (child_node->m_parent != root.node()) return static_cast<unsigned>(-1);
+    return child_node->m_offset;
   }
 
   template<typename T>
@@ -650,6 +773,38 @@ namespace stlplus
     return ntree_iterator<T,T&,T*>(parent);
   }
 
+  template<typename T>
+  typename ntree<T>::const_iterator ntree<T>::next_sibling(const typename ntree<T>::const_iterator& i) const
+  {
+    i.assert_valid(this);
+    ntree_node<T>* parent = i.node()->m_parent;
+    unsigned next = i.node()->m_offset + 1;
+    if (!parent || next >= parent->m_children.size()) return ntree_iterator<T,const T&,const T*>(this);
+    return ntree_iterator<T,const T&,const T*>(parent->m_children[next]);
+  }
+
+  template<typename T>
+  typename ntree<T>::iterator ntree<T>::next_sibling(const typename ntree<T>::iterator& i)
+  {
+    return next_sibling(i.constify()).deconstify();
+  }
+
+  template<typename T>
+  typename ntree<T>::const_iterator ntree<T>::prev_sibling(const typename ntree<T>::const_iterator& i) const
+  {
+    i.assert_valid(this);
+    ntree_node<T>* parent = i.node()->m_parent;
+    unsigned offset = i.node()->m_offset;
+    if (!parent || offset == 0) return ntree_iterator<T,const T&,const T*>(this);
+    return ntree_iterator<T,const T&,const T*>(parent->m_children[offset-1]);
+  }
+
+  template<typename T>
+  typename ntree<T>::iterator ntree<T>::prev_sibling(const typename ntree<T>::iterator& i)
+  {
+    return prev_sibling(i.constify()).deconstify();
+  }
+
   template<typename T>
   typename ntree<T>::const_prefix_iterator ntree<T>::prefix_begin(void) const
   {
@@ -756,9 +911,11 @@ namespace stlplus
     // otherwise, insert a new child
     i.assert_valid(this);
     if (offset > children(i)) throw std::out_of_range("stlplus::ntree::insert - offset out of range");
-    ntree_node<T>* new_node = new ntree_node<T>(this,data);
+    ntree_node<T>* new_node = new ntree_node<T>(this,data,i.node()->m_depth+1);
     i.node()->m_children.insert(i.node()->m_children.begin()+offset,new_node);
     new_node->m_parent = i.node();
+    ntree_renumber(i.node(), offset);
+    ntree_grow(i.node(), 1);
     return ntree_iterator<T,T&,T*>(new_node);
   }
 
@@ -789,9 +946,11 @@ namespace stlplus
     // insert a whole tree as a child of i
     i.assert_valid(this);
     if (offset > children(i)) throw std::out_of_range("stlplus::ntree::insert - offset out of range");
-    ntree_node<T>* new_node = ntree_copy(this, tree.m_root);
+    ntree_node<T>* new_node = ntree_copy(this, tree.m_root, i.node()->m_depth+1);
     i.node()->m_children.insert(i.node()->m_children.begin()+offset,new_node);
     new_node->m_parent = i.node();
+    ntree_renumber(i.node(), offset);
+    ntree_grow(i.node(), new_node->m_size);
     return ntree_iterator<T,T&,T*>(new_node);
   }
 
@@ -829,6 +988,9 @@ namespace stlplus
     if (new_node) new_node->change_owner(this);
     i.node()->m_children.insert(i.node()->m_children.begin()+offset,new_node);
     new_node->m_parent = i.node();
+    ntree_renumber(i.node(), offset);
+    new_node->change_depth(i.node()->m_depth+1);
+    ntree_grow(i.node(), new_node->m_size);
     return ntree_iterator<T,T&,T*>(new_node);
   }
 
@@ -847,7 +1009,7 @@ namespace stlplus
     // afterwards, the iterator still points to the old node, now the child
     // returns the iterator to the new node
     node.assert_valid(this);
-    ntree_node<T>* new_node = new ntree_node<T>(this,data);
+    ntree_node<T>* new_node = new ntree_node<T>(this,data,node.node()->m_depth);
     if (node.node() == m_root)
     {
       // pushing the root node
@@ -857,12 +1019,18 @@ namespace stlplus
     else
     {
       // pushing a sub-node
-      *(std::find(node.node()->m_parent->m_children.begin(), node.node()->m_parent->m_children.end(), node.node())) = new_node;
+      node.node()->m_parent->m_children[node.node()->m_offset] = new_node;
       new_node->m_parent = node.node()->m_parent;
+      new_node->m_offset = node.node()->m_offset;
     }
     // link up the old node as the child of the new node
     new_node->m_children.insert(new_node->m_children.begin(),node.node());
     node.node()->m_parent = new_node;
+    node.node()->m_offset = 0;
+    // the old node's subtree is now one level deeper
+    new_node->m_size += node.node()->m_size;
+    node.node()->change_depth(new_node->m_depth+1);
+    ntree_grow(new_node->m_parent, 1);
     return ntree_iterator<T,T&,T*>(new_node);
   }
 
@@ -874,19 +1042,20 @@ namespace stlplus
     parent.assert_valid(this);
     ntree_node<T>* node = parent.node();
     if (offset >= node->m_children.size()) throw std::out_of_range("stlplus::ntree::pop - offset out of range");
-    // move the grandchildren first
+    // move the grandchildren into the node just after the child to be removed
     ntree_node<T>* child = parent.node()->m_children[offset];
-    while (!child->m_children.empty())
+    node->m_children.insert(node->m_children.begin()+offset+1, child->m_children.begin(), child->m_children.end());
+    for (typename std::vector<ntree_node<T>*>::iterator i = child->m_children.begin(); i != child->m_children.end(); i++)
     {
-      // remove the last grandchild and insert into node just after the child to be removed
-      ntree_node<T>* grandchild = child->m_children[child->m_children.size()-1];
-      child->m_children.pop_back();
-      node->m_children.insert(node->m_children.begin()+offset+1, grandchild);
-      grandchild->m_parent = node;
+      (*i)->m_parent = node;
+      (*i)->change_depth(node->m_depth+1);
     }
+    child->m_children.clear();
     // now remove the child
     node->m_children.erase(node->m_children.begin()+offset);
+    ntree_renumber(node, offset);
     delete child;
+    ntree_shrink(node, 1);
   }
 
   template<typename T>
@@ -915,10 +1084,9 @@ namespace stlplus
       {
         ntree_node<T>* parent = node->m_parent;
         // impossible for parent to be null - should assert this
-        typename std::vector<ntree_node<T>*>::iterator found =
-          std::find(parent->m_children.begin(), parent->m_children.end(), node);
-        // impossible for find to fail - should assert this
-        parent->m_children.erase(found);
+        parent->m_children.erase(parent->m_children.begin() + node->m_offset);
+        ntree_renumber(parent, node->m_offset);
+        ntree_shrink(parent, node->m_size);
         delete node;
       }
     }
@@ -932,6 +1100,8 @@ namespace stlplus
     // unhook from the children array
     ntree_node<T>* node = i.node()->m_children[offset];
     i.node()->m_children.erase(i.node()->m_children.begin() + offset);
+    ntree_renumber(i.node(), offset);
+    ntree_shrink(i.node(), node->m_size);
     // now delete the subtree
     delete node;
   }
@@ -998,16 +1168,17 @@ namespace stlplus
       {
         ntree_node<T>* parent = node->m_parent;
         // impossible for parent to be null - should assert this
-        typename std::vector<ntree_node<T>*>::iterator found =
-          std::find(parent->m_children.begin(), parent->m_children.end(), node);
-        // impossible for find to fail - should assert this
-        result.m_root = *found;
-        parent->m_children.erase(found);
+        result.m_root = node;
+        parent->m_children.erase(parent->m_children.begin() + node->m_offset);
+        ntree_renumber(parent, node->m_offset);
+        ntree_shrink(parent, node->m_size);
       }
       if (result.m_root)
       {
         result.m_root->m_parent = 0;
+        result.m_root->m_offset = 0;
         result.m_root->change_owner(&result);
+        result.m_root->change_depth(1);
       }
     }
     return result;
@@ -1034,6 +1205,7 @@ namespace stlplus
     ntree_node<T>* child_node = node_node->m_children[child_offset];
     node_node->m_children.erase(node_node->m_children.begin() + child_offset);
     node_node->m_children.insert(node_node->m_children.begin() + new_offset, child_node);
+    ntree_renumber(node_node, std::min(child_offset, new_offset));
   }
 
   template<typename T>
@@ -1048,6 +1220,242 @@ namespace stlplus
     // perform the move
     ntree_node<T>* node_node = node.node();
     std::swap(node_node->m_children[child1], node_node->m_children[child2]);
+    node_node->m_children[child1]->m_offset = child1;
+    node_node->m_children[child2]->m_offset = child2;
+  }
+
+  template<typename T>
+  template<typename V>
+  void ntree<T>::parallel_visit(ntree_node<T>* root, V& visit, unsigned threads, unsigned cutoff) const
+  {
+#ifdef STLPLUS_HAS_CXX11
+    std::vector<ntree_node<T>*> parts;
+    std::vector<bool> subtrees;
+    std::vector<unsigned> tasks;
+    ntree_partition(root, cutoff, parts, subtrees, tasks);
+    task_pool pool(threads);
+    for (unsigned t = 0; t + 1 < tasks.size(); t++)
+    {
+      unsigned first = tasks[t];
+      unsigned last = tasks[t+1];
+      pool.submit([&visit,&parts,&subtrees,first,last]{ntree_visit_parts(parts, subtrees, first, last, visit);});
+    }
+    pool.wait();
+#else
+    (void)threads;
+    (void)cutoff;
+    ntree_visit(root, visit);
+#endif
+  }
+
+  template<typename T>
+  template<typename F>
+  void ntree<T>::parallel_for_each(const typename ntree<T>::const_iterator& node, F fn, unsigned threads, unsigned cutoff) const
+  {
+    if (node.end()) return;
+    node.assert_valid(this);
+    ntree_for_each_visitor<const ntree<T>,ntree_iterator<T,const T&,const T*>,T,F> visit(this, &fn);
+    parallel_visit(node.node(), visit, threads, cutoff);
+  }
+
+  template<typename T>
+  template<typename F>
+  void ntree<T>::parallel_for_each(const typename ntree<T>::iterator& node, F fn, unsigned threads, unsigned cutoff)
+  {
+    if (node.end()) return;
+    node.assert_valid(this);
+    ntree_for_each_visitor<ntree<T>,ntree_iterator<T,T&,T*>,T,F> visit(this, &fn);
+    parallel_visit(node.node(), visit, threads, cutoff);
+  }
+
+  template<typename T>
+  template<typename R, typename M, typename C>
+  R ntree<T>::parallel_reduce(const typename ntree<T>::const_iterator& node, M map, C combine, unsigned threads, unsigned cutoff) const
+  {
+    if (node.end()) return R();
+    node.assert_valid(this);
+#ifdef STLPLUS_HAS_CXX11
+    // each task is reduced separately and the task results are then combined in order
+    std::vector<ntree_node<T>*> parts;
+    std::vector<bool> subtrees;
+    std::vector<unsigned> tasks;
+    ntree_partition(node.node(), cutoff, parts, subtrees, tasks);
+    // a deque rather than a vector so that each task writes its own object even when R is bool
+    std::deque<R> results(tasks.size() - 1);
+    task_pool pool(threads);
+    for (unsigned t = 0; t < results.size(); t++)
+    {
+      unsigned first = tasks[t];
+      unsigned last = tasks[t+1];
+      pool.submit([this,&map,&combine,&parts,&subtrees,&results,t,first,last]
+                  {
+                    ntree_reduce_visitor<T,R,M,C> visit(this, &map, &combine);
+                    ntree_visit_parts(parts, subtrees, first, last, visit);
+                    results[t] = visit.m_result;
+                  });
+    }
+    pool.wait();
+    R result = results[0];
+    for (unsigned i = 1; i < results.size(); i++)
+      result = combine(result, results[i]);
+    return result;
+#else
+    (void)threads;
+    (void)cutoff;
+    ntree_reduce_visitor<T,R,M,C> visit(this, &map, &combine);
+    ntree_visit(node.node(), visit);
+    return visit.m_result;
+#endif
+  }
+
+  template<typename T>
+  template<typename R, typename M, typename C>
+  R ntree<T>::parallel_reduce(const typename ntree<T>::iterator& node, M map, C combine, unsigned threads, unsigned cutoff) const
+  {
+    return parallel_reduce<R>(node.constify(), map, combine, threads, cutoff);
+  }
+
+  template<typename T>
+  flat_ntree<T> ntree<T>::compact(void) const
+  {
+    flat_ntree<T> result;
+    if (!m_root) return result;
+    // the subtree sizes are already known, so the arrays can be allocated up
+    // front and the end of each subtree is known as soon as its root is reached
+    unsigned size = m_root->m_size;
+    result.m_data.reserve(size);
+    result.m_parents.reserve(size);
+    result.m_ends.reserve(size);
+    // prefix traversal using a stack of nodes and their parent's position
+    // the children are stacked in reverse so that they come off in order
+    std::vector<std::pair<ntree_node<T>*,unsigned> > stack;
+    stack.push_back(std::make_pair(m_root, flat_ntree<T>::npos()));
+    while (!stack.empty())
+    {
+      ntree_node<T>* node = stack.back().first;
+      unsigned position = (unsigned)result.m_data.size();
+      result.m_data.push_back(node->m_data);
+      result.m_parents.push_back(stack.back().second);
+      result.m_ends.push_back(position + node->m_size);
+      stack.pop_back();
+      for (unsigned c = (unsigned)node->m_children.size(); c--; )
+        stack.push_back(std::make_pair(node->m_children[c], position));
+    }
+    return result;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  ////////////////////////////////////////////////////////////////////////////////
+  // flat_ntree
+  ////////////////////////////////////////////////////////////////////////////////
+  ////////////////////////////////////////////////////////////////////////////////
+
+  template<typename T>
+  unsigned flat_ntree<T>::npos(void)
+  {
+    return (unsigned)-1;
+  }
+
+  template<typename T>
+  flat_ntree<T>::flat_ntree(void)
+  {
+  }
+
+  template<typename T>
+  bool flat_ntree<T>::empty(void) const
+  {
+    return m_data.empty();
+  }
+
+  template<typename T>
+  unsigned flat_ntree<T>::size(void) const
+  {
+    return (unsigned)m_data.size();
+  }
+
+  template<typename T>
+  const T& flat_ntree<T>::operator[](unsigned node) const
+  {
+    if (node >= size()) throw std::out_of_range("stlplus::flat_ntree::operator[] - node out of range");
+    return m_data[node];
+  }
+
+  template<typename T>
+  T& flat_ntree<T>::operator[](unsigned node)
+  {
+    if (node >= size()) throw std::out_of_range("stlplus::flat_ntree::operator[] - node out of range");
+    return m_data[node];
+  }
+
+  template<typename T>
+  unsigned flat_ntree<T>::parent(unsigned node) const
+  {
+    if (node >= size()) throw std::out_of_range("stlplus::flat_ntree::parent - node out of range");
+    return m_parents[node];
+  }
+
+  template<typename T>
+  unsigned flat_ntree<T>::first_child(unsigned node) const
+  {
+    if (node >= size()) throw std::out_of_range("stlplus::flat_ntree::first_child - node out of range");
+    return m_ends[node] > node+1 ? node+1 : npos();
+  }
+
+  template<typename T>
+  unsigned flat_ntree<T>::next_sibling(unsigned node) const
+  {
+    if (node >= size()) throw std::out_of_range("stlplus::flat_ntree::next_sibling - node out of range");
+    // the next sibling follows this node's subtree, if that is still within the parent's subtree
+    unsigned parent = m_parents[node];
+    if (parent == npos() || m_ends[node] >= m_ends[parent]) return npos();
+    return m_ends[node];
+  }
+
+  template<typename T>
+  unsigned flat_ntree<T>::subtree_end(unsigned node) const
+  {
+    if (node >= size()) throw std::out_of_range("stlplus::flat_ntree::subtree_end - node out of range");
+    return m_ends[node];
+  }
+
+  template<typename T>
+  unsigned flat_ntree<T>::size(unsigned node) const
+  {
+    if (node >= size()) throw std::out_of_range("stlplus::flat_ntree::size - node out of range");
+    return m_ends[node] - node;
+  }
+
+  template<typename T>
+  unsigned flat_ntree<T>::children(unsigned node) const
+  {
+    unsigned count = 0;
+    for (unsigned c = first_child(node); c != npos(); c = next_sibling(c))
+      count++;
+    return count;
+  }
+
+  template<typename T>
+  const std::vector<T>& flat_ntree<T>::data(void) const
+  {
+    return m_data;
+  }
+
+  template<typename T>
+  std::vector<T>& flat_ntree<T>::data(void)
+  {
+    return m_data;
+  }
+
+  template<typename T>
+  const std::vector<unsigned>& flat_ntree<T>::parents(void) const
+  {
+    return m_parents;
+  }
+
+  template<typename T>
+  const std::vector<unsigned>& flat_ntree<T>::subtree_ends(void) const
+  {
+    return m_ends;
   }
 
   ////////////////////////////////////////////////////////////////////////////////
@@ -24,12 +24,27 @@
 //   - smart_ptr_clone  for polymorphic class hierarchies which are copied using a clone method
 //   - smart_ptr_nocopy for any class that cannot or should not be copied
 
+//   A smart pointer normally holds its object through a separately allocated
+//   holder. With C++11, make_smart and make_smart_nocopy construct the object
+//   inside the holder's own allocation instead, so creation costs one
+//   allocation and the object sits next to its count in memory.
+
+//   smart_ptr_intrusive is for classes derived from smart_ptr_counted, which
+//   carry their own alias count. There is no holder, so the pointer is just a
+//   pointer to the object. Its aliases behave like simple_ptr: clearing or
+//   resetting one alias does not affect the others.
+
 ////////////////////////////////////////////////////////////////////////////////
 #include "containers_fixes.hpp"
 #include "exceptions.hpp"
 #include "copy_functors.hpp"
+#include <cstddef>
 #include <map>
+#include <new>
 #include <string>
+#ifdef STLPLUS_HAS_CXX11
+#include <utility>
+#endif
 
 namespace stlplus
 {
@@ -38,6 +53,18 @@ namespace stlplus
   // internals
 
   template<typename T> class smart_ptr_holder;
+  template<typename T> class smart_ptr;
+  template<typename T> class smart_ptr_nocopy;
+
+#ifdef STLPLUS_HAS_CXX11
+  // create an object in the same allocation as its holder - use in the form
+  // smart_ptr<type> x = make_smart<type>(args)
+  template<typename T, typename... Args>
+  smart_ptr<T> make_smart(Args&&... args);
+
+  template<typename T, typename... Args>
+  smart_ptr_nocopy<T> make_smart_nocopy(Args&&... args);
+#endif
 
   ////////////////////////////////////////////////////////////////////////////////
   // Base class
@@ -173,6 +200,9 @@ namespace stlplus
   protected:
     smart_ptr_holder<T>* m_holder;
 
+    // adopt a newly created holder - used by make_smart
+    explicit smart_ptr_base(smart_ptr_holder<T>& holder);
+
   public:
     // internal use only - had to make them public because they need to be
     // accessed by routines that could not be made friends
@@ -193,6 +223,12 @@ namespace stlplus
     smart_ptr<T>& operator=(const T& data) {this->set_value(data); return *this;}
     smart_ptr<T>& operator=(T* data) {this->set(data); return *this;}
     ~smart_ptr(void) {}
+
+#ifdef STLPLUS_HAS_CXX11
+  private:
+    template<typename T2, typename... Args> friend smart_ptr<T2> make_smart(Args&&...);
+    explicit smart_ptr(smart_ptr_holder<T>& holder) : smart_ptr_base<T, constructor_copy<T> >(holder) {}
+#endif
   };
 
   ////////////////////////////////////////////////////////////////////////////////
@@ -221,6 +257,138 @@ namespace stlplus
     explicit smart_ptr_nocopy(T* data) : smart_ptr_base<T, no_copy<T> >(data) {}
     smart_ptr_nocopy<T>& operator=(T* data) {this->set(data); return *this;}
     ~smart_ptr_nocopy(void) {}
+
+#ifdef STLPLUS_HAS_CXX11
+  private:
+    template<typename T2, typename... Args> friend smart_ptr_nocopy<T2> make_smart_nocopy(Args&&...);
+    explicit smart_ptr_nocopy(smart_ptr_holder<T>& holder) : smart_ptr_base<T, no_copy<T> >(holder) {}
+#endif
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // Intrusive smart pointer
+  ////////////////////////////////////////////////////////////////////////////////
+
+  // base class for objects that carry their own alias count - derive from it
+  // to make a class usable with smart_ptr_intrusive
+  // copying an object does not copy its count, since the copy has no aliases yet
+
+  class smart_ptr_counted
+  {
+  public:
+    smart_ptr_counted(void) : m_alias_count(0) {}
+    smart_ptr_counted(const smart_ptr_counted&) : m_alias_count(0) {}
+    smart_ptr_counted& operator=(const smart_ptr_counted&) {return *this;}
+
+    // number of smart_ptr_intrusive aliases of this object
+    unsigned alias_count(void) const {return m_alias_count;}
+
+    // internal use only
+    void _increment(void) const {++m_alias_count;}
+    bool _decrement(void) const {return --m_alias_count == 0;}
+
+  protected:
+    ~smart_ptr_counted(void) {}
+
+  private:
+    mutable unsigned m_alias_count;
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // smart_ptr_intrusive for classes derived from smart_ptr_counted
+
+  template<typename T>
+  class smart_ptr_intrusive
+  {
+  public:
+    //////////////////////////////////////////////////////////////////////////////
+    // member type definitions
+
+    typedef T value_type;
+    typedef T& reference;
+    typedef const T& const_reference;
+
+    //////////////////////////////////////////////////////////////////////////////
+    // constructors and destructors
+
+    // create a null pointer
+    smart_ptr_intrusive(void);
+
+    // create a pointer to a dynamically created object
+    // Note: the object must be allocated *by the user* with new
+    // since the count is in the object, it is safe to pass an object that is
+    // already managed by other smart_ptr_intrusive pointers - this becomes an alias
+    explicit smart_ptr_intrusive(T* data);
+
+    // copy constructor implements aliasing so no copy is made
+    smart_ptr_intrusive(const smart_ptr_intrusive<T>& r);
+
+    smart_ptr_intrusive<T>& operator=(const smart_ptr_intrusive<T>& r);
+    smart_ptr_intrusive<T>& operator=(T* data);
+
+    // destructor decrements the alias count and deletes the object when the last alias is destroyed
+    ~smart_ptr_intrusive(void);
+
+    //////////////////////////////////////////////////////////////////////////////
+    // logical tests to see if there is anything contained in the pointer since it can be null
+
+    operator bool(void) const;
+    bool operator!(void) const;
+    bool present(void) const;
+    bool null(void) const;
+
+    //////////////////////////////////////////////////////////////////////////////
+    // dereference operators and functions
+
+    // exceptions: null_dereference
+    T& operator*(void) ;
+    // exceptions: null_dereference
+    const T& operator*(void) const ;
+
+    // exceptions: null_dereference
+    T* operator->(void) ;
+    // exceptions: null_dereference
+    const T* operator->(void) const ;
+
+    // exceptions: null_dereference
+    T& value(void) ;
+    // exceptions: null_dereference
+    const T& value(void) const ;
+
+    // set the pointer - releases this alias of the previous object and adopts the passed pointer instead
+    // other aliases of the previous object are not affected
+    void set(T* data = 0);
+    // get the pointer
+    T* pointer(void);
+    const T* pointer(void) const;
+
+    //////////////////////////////////////////////////////////////////////////////
+    // functions to manage aliases
+
+    // make this an alias of the passed object
+    void alias(const smart_ptr_intrusive<T>&);
+
+    // test whether two pointers point to the same object
+    bool aliases(const smart_ptr_intrusive<T>&) const;
+
+    // find the number of aliases - zero for a null pointer
+    unsigned alias_count(void) const;
+
+    // make this pointer null - the object is only deleted if this was its last alias
+    void clear(void);
+
+    //////////////////////////////////////////////////////////////////////////////
+    // functions that involve copying - these use the copy constructor of T
+
+    // make this pointer unique with respect to any other references to the same object
+    // if this pointer is already unique, it does nothing - otherwise it copies the object
+    void make_unique(void);
+
+    // make this pointer a unique copy of the parameter
+    void copy(const smart_ptr_intrusive<T>&);
+
+  private:
+    T* m_pointer;
   };
 
   ////////////////////////////////////////////////////////////////////////////////
@@ -19,11 +19,13 @@ namespace stlplus
   {
   private:
     unsigned m_count;
+    // true if the object was constructed by make_smart in the same allocation as the holder
+    bool m_embedded;
     T* m_data;
 
     // make these private to disallow copying because the holder doesn't know how to copy
     smart_ptr_holder(const smart_ptr_holder& s) :
-      m_count(0), m_data(0)
+      m_count(0), m_embedded(false), m_data(0)
       {
       }
 
@@ -33,8 +35,8 @@ namespace stlplus
       }
 
   public:
-    smart_ptr_holder(T* p = 0) :
-      m_count(1), m_data(p)
+    smart_ptr_holder(T* p = 0, bool embedded = false) :
+      m_count(1), m_embedded(embedded), m_data(p)
       {
       }
 
@@ -43,6 +45,27 @@ namespace stlplus
         clear();
       }
 
+    // a holder may be the head of a larger block made by make_smart, so
+    // always release it with the unsized global operator delete
+    static void* operator new(std::size_t size)
+      {
+        return ::operator new(size);
+      }
+
+    static void* operator new(std::size_t, void* place)
+      {
+        return place;
+      }
+
+    static void operator delete(void* block)
+      {
+        ::operator delete(block);
+      }
+
+    static void operator delete(void*, void*)
+      {
+      }
+
     unsigned count(void) const
       {
         return m_count;
@@ -66,7 +89,13 @@ namespace stlplus
 
     void clear(void)
       {
-        if(m_data)
+        if (m_embedded)
+        {
+          // the memory is released with the holder
+          m_data->~T();
+          m_embedded = false;
+        }
+        else if(m_data)
           delete m_data;
         m_data = 0;
       }
@@ -98,6 +127,59 @@ namespace stlplus
       }
   };
 
+#ifdef STLPLUS_HAS_CXX11
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // make_smart - one allocation holds the holder followed by the object
+
+  template<typename T, typename... Args>
+  static smart_ptr_holder<T>* smart_ptr_allocate(Args&&... args)
+  {
+    // offset of the object, rounded up to its alignment
+    const std::size_t offset = (sizeof(smart_ptr_holder<T>) + alignof(T) - 1) / alignof(T) * alignof(T);
+    if (alignof(T) > alignof(std::max_align_t))
+    {
+      // operator new cannot guarantee the alignment, so allocate separately
+      smart_ptr_holder<T>* holder = new smart_ptr_holder<T>;
+      try
+      {
+        holder->set(new T(std::forward<Args>(args)...));
+      }
+      catch(...)
+      {
+        delete holder;
+        throw;
+      }
+      return holder;
+    }
+    void* block = ::operator new(offset + sizeof(T));
+    T* data = 0;
+    try
+    {
+      data = new(static_cast<char*>(block) + offset) T(std::forward<Args>(args)...);
+    }
+    catch(...)
+    {
+      ::operator delete(block);
+      throw;
+    }
+    return new(block) smart_ptr_holder<T>(data, true);
+  }
+
+  template<typename T, typename... Args>
+  smart_ptr<T> make_smart(Args&&... args)
+  {
+    return smart_ptr<T>(*smart_ptr_allocate<T>(std::forward<Args>(args)...));
+  }
+
+  template<typename T, typename... Args>
+  smart_ptr_nocopy<T> make_smart_nocopy(Args&&... args)
+  {
+    return smart_ptr_nocopy<T>(*smart_ptr_allocate<T>(std::forward<Args>(args)...));
+  }
+
+#endif
+
   ////////////////////////////////////////////////////////////////////////////////
   // smart_ptr_base class
   ////////////////////////////////////////////////////////////////////////////////
@@ -130,6 +212,13 @@ namespace stlplus
     m_holder->set(data);
   }
 
+  // adopt a holder that has just been created with a count of one
+  template <typename T, typename C>
+  smart_ptr_base<T,C>::smart_ptr_base(smart_ptr_holder<T>& holder) :
+    m_holder(&holder)
+  {
+  }
+
   // copy constructor implements counted referencing - no copy is made
   template <typename T, typename C>
   smart_ptr_base<T,C>::smart_ptr_base(const smart_ptr_base<T,C>& r) :
@@ -346,5 +435,186 @@ namespace stlplus
   }
 
   ////////////////////////////////////////////////////////////////////////////////
+  // smart_ptr_intrusive class
+  ////////////////////////////////////////////////////////////////////////////////
+
+  template <typename T>
+  smart_ptr_intrusive<T>::smart_ptr_intrusive(void) :
+    m_pointer(0)
+  {
+  }
+
+  template <typename T>
+  smart_ptr_intrusive<T>::smart_ptr_intrusive(T* data) :
+    m_pointer(data)
+  {
+    if (m_pointer) m_pointer->_increment();
+  }
+
+  template <typename T>
+  smart_ptr_intrusive<T>::smart_ptr_intrusive(const smart_ptr_intrusive<T>& r) :
+    m_pointer(r.m_pointer)
+  {
+    if (m_pointer) m_pointer->_increment();
+  }
+
+  template <typename T>
+  smart_ptr_intrusive<T>& smart_ptr_intrusive<T>::operator=(const smart_ptr_intrusive<T>& r)
+  {
+    set(r.m_pointer);
+    return *this;
+  }
+
+  template <typename T>
+  smart_ptr_intrusive<T>& smart_ptr_intrusive<T>::operator=(T* data)
+  {
+    set(data);
+    return *this;
+  }
+
+  template <typename T>
+  smart_ptr_intrusive<T>::~smart_ptr_intrusive(void)
+  {
+    clear();
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // logical tests
+
+  template <typename T>
+  smart_ptr_intrusive<T>::operator bool(void) const
+  {
+    return m_pointer != 0;
+  }
+
+  template <typename T>
+  bool smart_ptr_intrusive<T>::operator!(void) const
+  {
+    return m_pointer == 0;
+  }
+
+  template <typename T>
+  bool smart_ptr_intrusive<T>::present(void) const
+  {
+    return m_pointer != 0;
+  }
+
+  template <typename T>
+  bool smart_ptr_intrusive<T>::null(void) const
+  {
+    return m_pointer == 0;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // dereference operators and functions
+
+  template <typename T>
+  T& smart_ptr_intrusive<T>::operator*(void)
+  {
+    if (!m_pointer) throw null_dereference("null pointer dereferenced in smart_ptr_intrusive::operator*");
+    return *m_pointer;
+  }
+
+  template <typename T>
+  const T& smart_ptr_intrusive<T>::operator*(void) const
+  {
+    if (!m_pointer) throw null_dereference("null pointer dereferenced in smart_ptr_intrusive::operator*");
+    return *m_pointer;
+  }
+
+  template <typename T>
+  T* smart_ptr_intrusive<T>::operator->(void)
+  {
+    if (!m_pointer) throw null_dereference("null pointer dereferenced in smart_ptr_intrusive::operator->");
+    return m_pointer;
+  }
+
+  template <typename T>
+  const T* smart_ptr_intrusive<T>::operator->(void) const
+  {
+    if (!m_pointer) throw null_dereference("null pointer dereferenced in smart_ptr_intrusive::operator->");
+    return m_pointer;
+  }
+
+  template <typename T>
+  T& smart_ptr_intrusive<T>::value(void)
+  {
+    if (!m_pointer) throw null_dereference("null pointer dereferenced in smart_ptr_intrusive::value");
+    return *m_pointer;
+  }
+
+  template <typename T>
+  const T& smart_ptr_intrusive<T>::value(void) const
+  {
+    if (!m_pointer) throw null_dereference("null pointer dereferenced in smart_ptr_intrusive::value");
+    return *m_pointer;
+  }
+
+  template <typename T>
+  void smart_ptr_intrusive<T>::set(T* data)
+  {
+    // increment first so that setting a pointer to its own object is safe
+    if (data) data->_increment();
+    clear();
+    m_pointer = data;
+  }
+
+  template <typename T>
+  T* smart_ptr_intrusive<T>::pointer(void)
+  {
+    return m_pointer;
+  }
+
+  template <typename T>
+  const T* smart_ptr_intrusive<T>::pointer(void) const
+  {
+    return m_pointer;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // functions to manage aliases
+
+  template <typename T>
+  void smart_ptr_intrusive<T>::alias(const smart_ptr_intrusive<T>& r)
+  {
+    set(r.m_pointer);
+  }
+
+  template <typename T>
+  bool smart_ptr_intrusive<T>::aliases(const smart_ptr_intrusive<T>& r) const
+  {
+    return m_pointer == r.m_pointer;
+  }
+
+  template <typename T>
+  unsigned smart_ptr_intrusive<T>::alias_count(void) const
+  {
+    return m_pointer ? m_pointer->alias_count() : 0;
+  }
+
+  template <typename T>
+  void smart_ptr_intrusive<T>::clear(void)
+  {
+    T* old_pointer = m_pointer;
+    m_pointer = 0;
+    if (old_pointer && old_pointer->_decrement())
+      delete old_pointer;
+  }
+
+  template <typename T>
+  void smart_ptr_intrusive<T>::make_unique(void)
+  {
+    if (m_pointer && m_pointer->alias_count() > 1)
+      set(new T(*m_pointer));
+  }
+
+  template <typename T>
+  void smart_ptr_intrusive<T>::copy(const smart_ptr_intrusive<T>& data)
+  {
+    alias(data);
+    make_unique();
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
 
 } // end namespace stlplus
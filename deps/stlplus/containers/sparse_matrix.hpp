@@ -0,0 +1,109 @@
+#ifndef STLPLUS_SPARSE_MATRIX
+#define STLPLUS_SPARSE_MATRIX
+////////////////////////////////////////////////////////////////////////////////
+
+//   Author:    Andy Rushton
+//   Copyright: (c) Southampton University 1999-2004
+//              (c) Andy Rushton           2004 onwards
+//   License:   BSD License, see ../docs/license.html
+
+//   Sparse 2D matrix - the companion of matrix for data that is mostly zero
+
+//   The matrix is built from (row, column, value) entries in coordinate (COO)
+//   form and stored in compressed sparse row (CSR) form: the stored values
+//   and their column indices are kept row by row in column order, and
+//   row_starts()[r] is the index of the first entry of row r, so that row r
+//   occupies [row_starts()[r], row_starts()[r+1]). Elements that are not
+//   stored are T(), which must be zero for the arithmetic to make sense.
+
+////////////////////////////////////////////////////////////////////////////////
+#include "containers_fixes.hpp"
+#include "matrix.hpp"
+#include "triple.hpp"
+#include "task_pool.hpp"
+#include <vector>
+#include <stdexcept>
+
+namespace stlplus
+{
+
+  ////////////////////////////////////////////////////////////////////////////////
+
+  template<typename T> class sparse_matrix
+  {
+  public:
+    // an entry in coordinate form: row, column and value
+    typedef triple<unsigned,unsigned,T> entry_type;
+    typedef std::vector<entry_type> entry_vector;
+
+    // a matrix of the given shape with no stored elements
+    sparse_matrix(unsigned rows = 0, unsigned cols = 0);
+    // build from entries in coordinate form - see build
+    // exceptions: std::out_of_range
+    sparse_matrix(unsigned rows, unsigned cols, const entry_vector& entries);
+    // convert from a dense matrix, storing only the elements that are not T()
+    explicit sparse_matrix(const matrix<T>& dense);
+
+    // replace the contents with entries in coordinate form, in any order
+    // entries for the same row and column are added together
+    // the matrix is unchanged if any entry is out of range
+    // exceptions: std::out_of_range
+    void build(unsigned rows, unsigned cols, const entry_vector& entries);
+
+    // replace the contents with arrays already in compressed sparse row form,
+    // which are taken over by swapping, leaving the previous contents in the arguments
+    // the arrays are checked for consistency and the matrix is unchanged if they are wrong
+    // exceptions: std::invalid_argument
+    void adopt(unsigned rows, unsigned cols,
+               std::vector<unsigned>& row_starts, std::vector<unsigned>& column_indices, std::vector<T>& values);
+
+    // the stored elements in coordinate form, in row-major order
+    entry_vector entries(void) const;
+
+    // convert to a dense matrix
+    matrix<T> to_matrix(void) const;
+
+    unsigned rows(void) const;
+    unsigned columns(void) const;
+    // number of stored elements
+    unsigned nonzeros(void) const;
+
+    // get an element by a binary search of its row, giving T() if it is not stored
+    // exceptions: std::out_of_range
+    T item(unsigned row, unsigned col) const;
+    // exceptions: std::out_of_range
+    T operator()(unsigned row, unsigned col) const;
+
+    // direct access to the compressed sparse row arrays
+    const std::vector<unsigned>& row_starts(void) const;
+    const std::vector<unsigned>& column_indices(void) const;
+    const std::vector<T>& values(void) const;
+    // the stored values may be changed in place but not added to or removed
+    std::vector<T>& values(void);
+
+  private:
+    unsigned m_rows;
+    unsigned m_cols;
+    std::vector<unsigned> m_starts;
+    std::vector<unsigned> m_columns;
+    std::vector<T> m_values;
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // sparse matrix-vector product: y = a * x
+  // x must have a.columns() elements and y is resized to a.rows() elements
+  // threads: 1 runs on the calling thread, n > 1 shares the rows between n
+  // worker threads in chunks with similar numbers of stored elements, 0 uses
+  // one worker per hardware thread if there are enough stored elements to be
+  // worth it. Workers need C++11 threads, otherwise the product is always
+  // computed on the calling thread.
+  // exceptions: std::invalid_argument
+  template<typename T>
+  void multiply(const sparse_matrix<T>& a, const std::vector<T>& x, std::vector<T>& y, unsigned threads = 0);
+
+  ////////////////////////////////////////////////////////////////////////////////
+
+} // end namespace stlplus
+
+#include "sparse_matrix.tpp"
+#endif
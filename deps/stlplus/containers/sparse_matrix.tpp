@@ -0,0 +1,276 @@
+////////////////////////////////////////////////////////////////////////////////
+
+//   Author:    Andy Rushton
+//   Copyright: (c) Southampton University 1999-2004
+//              (c) Andy Rushton           2004 onwards
+//   License:   BSD License, see ../docs/license.html
+
+////////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <utility>
+
+namespace stlplus
+{
+
+  ////////////////////////////////////////////////////////////////////////////////
+
+  template<typename T>
+  sparse_matrix<T>::sparse_matrix(unsigned rows, unsigned cols) :
+    m_rows(rows), m_cols(cols), m_starts(rows+1, 0)
+  {
+  }
+
+  template<typename T>
+  sparse_matrix<T>::sparse_matrix(unsigned rows, unsigned cols, const entry_vector& entries) :
+    m_rows(0), m_cols(0), m_starts(1, 0)
+  {
+    build(rows, cols, entries);
+  }
+
+  template<typename T>
+  sparse_matrix<T>::sparse_matrix(const matrix<T>& dense) :
+    m_rows(dense.rows()), m_cols(dense.columns()), m_starts(dense.rows()+1, 0)
+  {
+    // the dense matrix is already in row-major order, so this is a single scan
+    const T zero = T();
+    for (unsigned r = 0; r < m_rows; r++)
+    {
+      const T* row = dense.row_span(r);
+      for (unsigned c = 0; c < m_cols; c++)
+        if (!(row[c] == zero))
+        {
+          m_columns.push_back(c);
+          m_values.push_back(row[c]);
+        }
+      m_starts[r+1] = static_cast<unsigned>(m_values.size());
+    }
+  }
+
+  // orders the entries of a row by column, keeping entries for the same column in their original order
+  template<typename T>
+  static bool sparse_matrix_column_less(const std::pair<unsigned,T>& left, const std::pair<unsigned,T>& right)
+  {
+    return left.first < right.first;
+  }
+
+  template<typename T>
+  void sparse_matrix<T>::build(unsigned rows, unsigned cols, const entry_vector& entries)
+  {
+    // check everything before changing anything
+    for (typename entry_vector::const_iterator i = entries.begin(); i != entries.end(); i++)
+    {
+      if (i->first >= rows) throw std::out_of_range("sparse_matrix::build row");
+      if (i->second >= cols) throw std::out_of_range("sparse_matrix::build col");
+    }
+    // count the entries in each row, then distribute them into their rows
+    std::vector<unsigned> starts(rows+1, 0);
+    for (typename entry_vector::const_iterator i = entries.begin(); i != entries.end(); i++)
+      starts[i->first+1]++;
+    for (unsigned r = 0; r < rows; r++)
+      starts[r+1] += starts[r];
+    std::vector<std::pair<unsigned,T> > distributed(entries.size());
+    std::vector<unsigned> next(starts.begin(), starts.end()-1);
+    for (typename entry_vector::const_iterator i = entries.begin(); i != entries.end(); i++)
+      distributed[next[i->first]++] = std::make_pair(i->second, i->third);
+    // sort each row into column order and add together entries for the same element
+    std::vector<unsigned> columns;
+    std::vector<T> values;
+    columns.reserve(entries.size());
+    values.reserve(entries.size());
+    for (unsigned r = 0; r < rows; r++)
+    {
+      typename std::vector<std::pair<unsigned,T> >::iterator first = distributed.begin() + starts[r];
+      typename std::vector<std::pair<unsigned,T> >::iterator last = distributed.begin() + starts[r+1];
+      std::stable_sort(first, last, sparse_matrix_column_less<T>);
+      starts[r] = static_cast<unsigned>(values.size());
+      for (typename std::vector<std::pair<unsigned,T> >::iterator i = first; i != last; i++)
+      {
+        if (values.size() > starts[r] && columns.back() == i->first)
+          values.back() = values.back() + i->second;
+        else
+        {
+          columns.push_back(i->first);
+          values.push_back(i->second);
+        }
+      }
+    }
+    starts[rows] = static_cast<unsigned>(values.size());
+    m_rows = rows;
+    m_cols = cols;
+    m_starts.swap(starts);
+    m_columns.swap(columns);
+    m_values.swap(values);
+  }
+
+  template<typename T>
+  void sparse_matrix<T>::adopt(unsigned rows, unsigned cols,
+                               std::vector<unsigned>& row_starts, std::vector<unsigned>& column_indices, std::vector<T>& values)
+  {
+    if (row_starts.size() != (std::size_t)rows+1 || row_starts[0] != 0 ||
+        column_indices.size() != values.size() || row_starts[rows] != values.size())
+      throw std::invalid_argument("sparse_matrix::adopt - arrays are inconsistent");
+    for (unsigned r = 0; r < rows; r++)
+    {
+      if (row_starts[r] > row_starts[r+1])
+        throw std::invalid_argument("sparse_matrix::adopt - row starts are not in order");
+      for (unsigned i = row_starts[r]; i < row_starts[r+1]; i++)
+        if (column_indices[i] >= cols || (i > row_starts[r] && column_indices[i] <= column_indices[i-1]))
+          throw std::invalid_argument("sparse_matrix::adopt - column indices out of range or not in order");
+    }
+    m_rows = rows;
+    m_cols = cols;
+    m_starts.swap(row_starts);
+    m_columns.swap(column_indices);
+    m_values.swap(values);
+  }
+
+  template<typename T>
+  typename sparse_matrix<T>::entry_vector sparse_matrix<T>::entries(void) const
+  {
+    entry_vector result;
+    result.reserve(m_values.size());
+    for (unsigned r = 0; r < m_rows; r++)
+      for (unsigned i = m_starts[r]; i < m_starts[r+1]; i++)
+        result.push_back(entry_type(r, m_columns[i], m_values[i]));
+    return result;
+  }
+
+  template<typename T>
+  matrix<T> sparse_matrix<T>::to_matrix(void) const
+  {
+    matrix<T> result(m_rows, m_cols);
+    for (unsigned r = 0; r < m_rows; r++)
+    {
+      if (m_starts[r] == m_starts[r+1]) continue;
+      T* row = result.row_span(r);
+      for (unsigned i = m_starts[r]; i < m_starts[r+1]; i++)
+        row[m_columns[i]] = m_values[i];
+    }
+    return result;
+  }
+
+  template<typename T>
+  unsigned sparse_matrix<T>::rows(void) const
+  {
+    return m_rows;
+  }
+
+  template<typename T>
+  unsigned sparse_matrix<T>::columns(void) const
+  {
+    return m_cols;
+  }
+
+  template<typename T>
+  unsigned sparse_matrix<T>::nonzeros(void) const
+  {
+    return static_cast<unsigned>(m_values.size());
+  }
+
+  template<typename T>
+  T sparse_matrix<T>::item(unsigned row, unsigned col) const
+  {
+    if (row >= m_rows) throw std::out_of_range("sparse_matrix::item row");
+    if (col >= m_cols) throw std::out_of_range("sparse_matrix::item col");
+    std::vector<unsigned>::const_iterator first = m_columns.begin() + m_starts[row];
+    std::vector<unsigned>::const_iterator last = m_columns.begin() + m_starts[row+1];
+    std::vector<unsigned>::const_iterator found = std::lower_bound(first, last, col);
+    if (found == last || *found != col) return T();
+    return m_values[found - m_columns.begin()];
+  }
+
+  template<typename T>
+  T sparse_matrix<T>::operator()(unsigned row, unsigned col) const
+  {
+    return item(row, col);
+  }
+
+  template<typename T>
+  const std::vector<unsigned>& sparse_matrix<T>::row_starts(void) const
+  {
+    return m_starts;
+  }
+
+  template<typename T>
+  const std::vector<unsigned>& sparse_matrix<T>::column_indices(void) const
+  {
+    return m_columns;
+  }
+
+  template<typename T>
+  const std::vector<T>& sparse_matrix<T>::values(void) const
+  {
+    return m_values;
+  }
+
+  template<typename T>
+  std::vector<T>& sparse_matrix<T>::values(void)
+  {
+    return m_values;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // sparse matrix-vector product
+
+  // products with fewer stored elements than this are not worth sharing between threads
+  static const unsigned sparse_matrix_parallel_threshold = 1 << 20;
+
+  // compute rows [first,last) of y = a * x
+  template<typename T>
+  static void sparse_matrix_multiply_rows(const unsigned* starts, const unsigned* columns, const T* values,
+                                          const T* x, T* y, unsigned first, unsigned last)
+  {
+    for (unsigned r = first; r < last; r++)
+    {
+      T sum = T();
+      for (unsigned i = starts[r]; i < starts[r+1]; i++)
+        sum += values[i] * x[columns[i]];
+      y[r] = sum;
+    }
+  }
+
+  template<typename T>
+  void multiply(const sparse_matrix<T>& a, const std::vector<T>& x, std::vector<T>& y, unsigned threads)
+  {
+    if (x.size() != a.columns())
+      throw std::invalid_argument("stlplus::multiply - vector does not match sparse matrix columns");
+    unsigned rows = a.rows();
+    y.assign(rows, T());
+    if (rows == 0 || a.nonzeros() == 0) return;
+    const unsigned* starts = &a.row_starts()[0];
+    const unsigned* columns = &a.column_indices()[0];
+    const T* values = &a.values()[0];
+    const T* xs = &x[0];
+    T* ys = &y[0];
+#ifdef STLPLUS_HAS_CXX11
+    if (threads == 0 && a.nonzeros() < sparse_matrix_parallel_threshold)
+      threads = 1;
+    if (threads != 1)
+    {
+      // split the rows into chunks with about the same number of stored
+      // elements, several per thread so that the work stays balanced
+      task_pool pool(threads);
+      unsigned chunks = pool.threads() * 4;
+      unsigned size = (a.nonzeros() + chunks - 1) / chunks;
+      const std::vector<unsigned>& row_starts = a.row_starts();
+      for (unsigned first = 0; first < rows; )
+      {
+        unsigned target = row_starts[first] + size;
+        unsigned last = static_cast<unsigned>(std::upper_bound(row_starts.begin() + first + 1, row_starts.end(), target) - row_starts.begin()) - 1;
+        if (last <= first) last = first + 1;
+        if (last > rows) last = rows;
+        pool.submit([=]{sparse_matrix_multiply_rows(starts, columns, values, xs, ys, first, last);});
+        first = last;
+      }
+      pool.wait();
+      return;
+    }
+#else
+    (void)threads;
+#endif
+    sparse_matrix_multiply_rows(starts, columns, values, xs, ys, 0, rows);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+
+} // end namespace stlplus
@@ -0,0 +1,105 @@
+#ifndef STLPLUS_TASK_POOL
+#define STLPLUS_TASK_POOL
+////////////////////////////////////////////////////////////////////////////////
+
+//   Author:    Andy Rushton
+//   Copyright: (c) Southampton University 1999-2004
+//              (c) Andy Rushton           2004 onwards
+//   License:   BSD License, see ../docs/license.html
+
+//   A pool of worker threads used by the parallel algorithms in the
+//   containers library.
+
+//   Each worker has its own queue of tasks. A task submitted from inside a
+//   worker goes on that worker's queue and is run last-in-first-out, so
+//   related work tends to stay on one processor. A worker with nothing to do
+//   steals the oldest task from another worker's queue.
+
+//   Only available when the compiler supports C++11 threads - see
+//   containers_fixes.hpp
+
+////////////////////////////////////////////////////////////////////////////////
+#include "containers_fixes.hpp"
+
+#ifdef STLPLUS_HAS_CXX11
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace stlplus
+{
+
+  ////////////////////////////////////////////////////////////////////////////////
+
+  class task_pool
+  {
+  public:
+    typedef std::function<void(void)> task;
+
+    // start the worker threads - zero means one per hardware thread
+    explicit task_pool(unsigned threads = 0);
+
+    // waits for outstanding tasks and then stops the workers
+    ~task_pool(void);
+
+    // number of worker threads
+    unsigned threads(void) const;
+
+    // add a task to the pool - may be called from inside a task
+    void submit(const task&);
+
+    // wait until every submitted task has completed, including tasks submitted
+    // by other tasks. If any task threw an exception, the first one is
+    // rethrown here. Must not be called from inside a task
+    void wait(void);
+
+  private:
+    struct task_queue
+    {
+      std::mutex m_mutex;
+      std::deque<task> m_tasks;
+    };
+
+    unsigned m_threads;
+    std::unique_ptr<task_queue[]> m_queues;
+    std::vector<std::thread> m_workers;
+
+    // m_mutex guards m_stop and m_exception and is used to put idle workers to sleep
+    std::mutex m_mutex;
+    std::condition_variable m_work;
+    std::condition_variable m_idle;
+    bool m_stop;
+    std::exception_ptr m_exception;
+
+    std::atomic<unsigned long> m_pending;
+    std::atomic<unsigned long> m_queued;
+    std::atomic<unsigned> m_sleeping;
+    std::atomic<unsigned> m_next;
+
+    void worker(unsigned index);
+    bool pop(unsigned index, task&);
+    bool steal(unsigned index, task&);
+    void run(task&);
+
+    static task_pool*& current_pool(void);
+    static unsigned& current_index(void);
+
+    // make this class uncopyable
+    task_pool(const task_pool&);
+    task_pool& operator = (const task_pool&);
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+
+} // end namespace stlplus
+
+#include "task_pool.tpp"
+#endif
+////////////////////////////////////////////////////////////////////////////////
+#endif
@@ -0,0 +1,169 @@
+////////////////////////////////////////////////////////////////////////////////
+
+//   Author:    Andy Rushton
+//   Copyright: (c) Southampton University 1999-2004
+//              (c) Andy Rushton           2004 onwards
+//   License:   BSD License, see ../docs/license.html
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace stlplus
+{
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // the worker that is running on this thread, if any
+
+  inline task_pool*& task_pool::current_pool(void)
+  {
+    static thread_local task_pool* pool = 0;
+    return pool;
+  }
+
+  inline unsigned& task_pool::current_index(void)
+  {
+    static thread_local unsigned index = 0;
+    return index;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+
+  inline task_pool::task_pool(unsigned threads) :
+    m_threads(threads), m_stop(false), m_pending(0), m_queued(0), m_sleeping(0), m_next(0)
+  {
+    if (m_threads == 0)
+      m_threads = std::thread::hardware_concurrency();
+    if (m_threads == 0)
+      m_threads = 1;
+    m_queues.reset(new task_queue[m_threads]);
+    m_workers.reserve(m_threads);
+    for (unsigned i = 0; i < m_threads; i++)
+      m_workers.push_back(std::thread(&task_pool::worker, this, i));
+  }
+
+  inline task_pool::~task_pool(void)
+  {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_idle.wait(lock, [this]{return m_pending.load() == 0;});
+      m_stop = true;
+    }
+    m_work.notify_all();
+    for (unsigned i = 0; i < m_workers.size(); i++)
+      m_workers[i].join();
+  }
+
+  inline unsigned task_pool::threads(void) const
+  {
+    return m_threads;
+  }
+
+  inline void task_pool::submit(const task& job)
+  {
+    ++m_pending;
+    // a worker keeps its own tasks, other threads share theirs out in turn
+    unsigned index = current_pool() == this ? current_index() : (m_next++ % m_threads);
+    {
+      std::lock_guard<std::mutex> lock(m_queues[index].m_mutex);
+      m_queues[index].m_tasks.push_back(job);
+      ++m_queued;
+    }
+    // a worker increments m_sleeping before testing m_queued, so one of the
+    // two threads is guaranteed to see the other's change
+    if (m_sleeping.load() != 0)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_work.notify_one();
+    }
+  }
+
+  inline void task_pool::wait(void)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]{return m_pending.load() == 0;});
+    if (m_exception)
+    {
+      std::exception_ptr exception = m_exception;
+      m_exception = std::exception_ptr();
+      std::rethrow_exception(exception);
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // workers
+
+  inline void task_pool::worker(unsigned index)
+  {
+    current_pool() = this;
+    current_index() = index;
+    task job;
+    for (;;)
+    {
+      if (pop(index, job) || steal(index, job))
+      {
+        run(job);
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(m_mutex);
+      ++m_sleeping;
+      m_work.wait(lock, [this]{return m_stop || m_queued.load() != 0;});
+      --m_sleeping;
+      if (m_stop && m_queued.load() == 0)
+        break;
+    }
+    current_pool() = 0;
+  }
+
+  // the owner takes the newest task from its own queue
+  inline bool task_pool::pop(unsigned index, task& job)
+  {
+    std::lock_guard<std::mutex> lock(m_queues[index].m_mutex);
+    if (m_queues[index].m_tasks.empty())
+      return false;
+    job.swap(m_queues[index].m_tasks.back());
+    m_queues[index].m_tasks.pop_back();
+    --m_queued;
+    return true;
+  }
+
+  // a thief takes the oldest task from the next queue that has one
+  inline bool task_pool::steal(unsigned index, task& job)
+  {
+    for (unsigned i = 1; i < m_threads; i++)
+    {
+      task_queue& victim = m_queues[(index + i) % m_threads];
+      std::lock_guard<std::mutex> lock(victim.m_mutex);
+      if (!victim.m_tasks.empty())
+      {
+        job.swap(victim.m_tasks.front());
+        victim.m_tasks.pop_front();
+        --m_queued;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  inline void task_pool::run(task& job)
+  {
+    try
+    {
+      job();
+    }
+    catch(...)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (!m_exception)
+        m_exception = std::current_exception();
+    }
+    // release anything the task captured before reporting it complete
+    job = task();
+    if (--m_pending == 0)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_idle.notify_all();
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+
+} // end namespace stlplus
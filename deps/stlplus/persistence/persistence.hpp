@@ -17,6 +17,8 @@
 #include "persistent_pointers.hpp"
 #include "persistent_stl.hpp"
 #include "persistent_stlplus.hpp"
+#include "persistent_parallel.hpp"
+#include "persistent_snapshot.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
 #endif
@@ -64,5 +64,31 @@
 #endif
 #endif
 
+////////////////////////////////////////////////////////////////////////////////
+// Rules for finding the byte order of the target at compile time
+// STLPLUS_LITTLE_ENDIAN is set to 1 for little-endian targets and 0 for big-endian
+// It can be defined on the command line for compilers not covered here
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STLPLUS_LITTLE_ENDIAN
+
+// gcc and clang predefine the byte order
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__)
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define STLPLUS_LITTLE_ENDIAN 1
+#else
+#define STLPLUS_LITTLE_ENDIAN 0
+#endif
+
+// Visual Studio and Borland only target little-endian Windows platforms
+#elif defined(_MSC_VER) || defined(__BORLANDC__)
+#define STLPLUS_LITTLE_ENDIAN 1
+
+#else
+#error "cannot determine the byte order - define STLPLUS_LITTLE_ENDIAN as 1 or 0"
+#endif
+
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////
 #endif
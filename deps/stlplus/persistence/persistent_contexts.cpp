@@ -10,7 +10,17 @@
 #include "persistent.hpp"
 #include <map>
 #include <string>
+#include <vector>
 #include <stdio.h>
+#ifdef STLPLUS_HAS_CXX11
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+#include <string.h>
+#if defined(__ARM_FEATURE_CRC32) && defined(__aarch64__)
+#include <arm_acle.h>
+#endif
 
 namespace stlplus
 {
@@ -24,8 +34,10 @@ namespace stlplus
 
   // Early versions of the persistence routines did not have this - they are no longer supported
   // - Change from version 1 to 2: changed the persistent representation of inf
+  // - Change from version 2 to 3: vectors of basic types are dumped as a raw block - see persistent_vector.hpp
+  // - Change from version 3 to 4: integers are dumped as LEB128 varints - see persistent_int.cpp
 
-  unsigned char PersistentVersion = 2;
+  unsigned char PersistentVersion = 4;
 
   ////////////////////////////////////////////////////////////////////////////////
   // avoid creating dependencies on other libraries
@@ -42,55 +54,787 @@ namespace stlplus
 
   static bool little_endian(void)
   {
-    // TODO - find a compile-time way of doing this
-    int sample = 1;
-    char* sample_bytes = (char*)&sample;
-    return sample_bytes[0] != 0;
+    // fixed at compile time - see persistence_fixes.hpp
+    return STLPLUS_LITTLE_ENDIAN != 0;
   }
 
+  ////////////////////////////////////////////////////////////////////////////////
+  // Framed format
+  // A framed dump starts with the version number with its top bit set. The
+  // rest of the dump is a series of frames, each with a 16-byte header
+  // followed by up to frame_size bytes of the normal unframed format:
+  //
+  //   {length}{sequence}{flags}{crc}{byte}*length
+  //
+  // The header fields are 4-byte little-endian integers. The sequence number
+  // counts frames from zero. The crc is the CRC-32C of the first 12 bytes of
+  // the header followed by the data. The flags mark a frame written by
+  // flush(), after which the writer may be waiting for a reply, and the final
+  // frame written when the dump context is destroyed. The restore never reads
+  // beyond either of these until it needs more data, so it does not block on
+  // a pipe or socket waiting for data that has not been sent. A further flag
+  // marks a frame whose data is compressed, in which case the length and crc
+  // are those of the compressed data, which expands to at most frame_size bytes.
+
+  enum {framed_version = 0x80, frame_size = 65536, frame_header_size = 16};
+  enum {frame_flush = 1, frame_end = 2, frame_compressed = 4};
+
+  static void frame_put_field(unsigned char* header, unsigned value)
+  {
+    for (unsigned i = 0; i < 4; i++, value >>= 8)
+      header[i] = (unsigned char)value;
+  }
+
+  static unsigned frame_get_field(const unsigned char* header)
+  {
+    unsigned value = 0;
+    for (unsigned i = 4; i--; )
+      value = (value << 8) | header[i];
+    return value;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // CRC-32C (Castagnoli) checksum used to verify frames
+  // Uses the SSE4.2 or ARMv8 crc32 instructions where the processor has them
+  // and otherwise a slice-by-8 table lookup
+
+  // slice-by-8 tables, built on first use
+  struct crc32c_tables
+  {
+    unsigned m_table[8][256];
+
+    crc32c_tables(void)
+      {
+        for (unsigned i = 0; i < 256; i++)
+        {
+          unsigned value = i;
+          for (unsigned j = 0; j < 8; j++)
+            value = (value >> 1) ^ ((value & 1) ? 0x82f63b78u : 0);
+          m_table[0][i] = value;
+        }
+        for (unsigned i = 0; i < 256; i++)
+          for (unsigned j = 1; j < 8; j++)
+            m_table[j][i] = (m_table[j-1][i] >> 8) ^ m_table[0][m_table[j-1][i] & 0xff];
+      }
+  };
+
+  static unsigned crc32c_software(unsigned crc, const unsigned char* data, size_t size)
+  {
+    static const crc32c_tables tables;
+    const unsigned (*table)[256] = tables.m_table;
+    for (; size >= 8; size -= 8, data += 8)
+    {
+      unsigned low = crc ^ frame_get_field(data);
+      unsigned high = frame_get_field(data + 4);
+      crc =
+        table[7][low & 0xff] ^ table[6][(low >> 8) & 0xff] ^ table[5][(low >> 16) & 0xff] ^ table[4][low >> 24] ^
+        table[3][high & 0xff] ^ table[2][(high >> 8) & 0xff] ^ table[1][(high >> 16) & 0xff] ^ table[0][high >> 24];
+    }
+    for (; size > 0; size--, data++)
+      crc = (crc >> 8) ^ table[0][(crc ^ *data) & 0xff];
+    return crc;
+  }
+
+#if defined(__GNUC__) && defined(__x86_64__)
+
+  __attribute__((target("sse4.2")))
+  static unsigned crc32c_hardware(unsigned crc, const unsigned char* data, size_t size)
+  {
+    size_t wide = crc;
+    for (; size >= 8; size -= 8, data += 8)
+    {
+      size_t word;
+      memcpy(&word, data, 8);
+      wide = (size_t)__builtin_ia32_crc32di(wide, word);
+    }
+    crc = (unsigned)wide;
+    for (; size > 0; size--, data++)
+      crc = __builtin_ia32_crc32qi(crc, *data);
+    return crc;
+  }
+
+  static bool crc32c_has_hardware(void)
+  {
+    return __builtin_cpu_supports("sse4.2");
+  }
+
+#elif defined(__ARM_FEATURE_CRC32) && defined(__aarch64__)
+
+  static unsigned crc32c_hardware(unsigned crc, const unsigned char* data, size_t size)
+  {
+    for (; size >= 8; size -= 8, data += 8)
+    {
+      uint64_t word;
+      memcpy(&word, data, 8);
+      crc = __crc32cd(crc, word);
+    }
+    for (; size > 0; size--, data++)
+      crc = __crc32cb(crc, *data);
+    return crc;
+  }
+
+  static bool crc32c_has_hardware(void)
+  {
+    return true;
+  }
+
+#else
+
+  static unsigned crc32c_hardware(unsigned crc, const unsigned char* data, size_t size)
+  {
+    return crc32c_software(crc, data, size);
+  }
+
+  static bool crc32c_has_hardware(void)
+  {
+    return false;
+  }
+
+#endif
+
+  // the crc of a block, continuing from the crc of the blocks before it - the first crc is zero
+  static unsigned crc32c(unsigned crc, const void* data, size_t size)
+  {
+    static const bool hardware = crc32c_has_hardware();
+    crc = ~crc;
+    if (hardware)
+      crc = crc32c_hardware(crc, (const unsigned char*)data, size);
+    else
+      crc = crc32c_software(crc, (const unsigned char*)data, size);
+    return ~crc;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // LZ compression of frames
+  // Each frame is compressed on its own so that frames can be compressed in
+  // parallel and decompressed as they arrive. The compressed data is a series
+  // of sequences, each a run of literal bytes followed by a copy of part of the
+  // output already decompressed:
+  //
+  //   {token}{length}*{byte}*{offset}{length}*
+  //
+  // The top 4 bits of the token are the number of literal bytes and the bottom
+  // 4 bits are the length of the copy less lz_min_match. Either value is 15 if
+  // the length continues in the following bytes, which are added to it up to
+  // and including the first that is not 255. The offset is 2 bytes little-endian
+  // and counts back from the end of the output so far. The last sequence has
+  // no copy, so the data ends straight after its literals.
+
+  enum {lz_min_match = 4, lz_hash_bits = 16, lz_max_level = 9};
+
+  static unsigned lz_hash(const unsigned char* data)
+  {
+    return ((frame_get_field(data) * 2654435761u) & 0xffffffffu) >> (32 - lz_hash_bits);
+  }
+
+  // the number of bytes that match, comparing a word at a time
+  static size_t lz_match_length(const unsigned char* earlier, const unsigned char* current, const unsigned char* end)
+  {
+    const unsigned char* start = current;
+    for (; (size_t)(end - current) >= sizeof(size_t); current += sizeof(size_t), earlier += sizeof(size_t))
+    {
+      size_t left = 0;
+      size_t right = 0;
+      memcpy(&left, earlier, sizeof(size_t));
+      memcpy(&right, current, sizeof(size_t));
+      if (left != right)
+        break;
+    }
+    for (; current != end && *current == *earlier; current++, earlier++) {}
+    return (size_t)(current - start);
+  }
+
+  static unsigned char* lz_put_length(unsigned char* output, size_t length)
+  {
+    for (; length >= 255; length -= 255)
+      *output++ = 255;
+    *output++ = (unsigned char)length;
+    return output;
+  }
+
+  static bool lz_get_length(const unsigned char*& input, const unsigned char* end, size_t& length)
+  {
+    for (;;)
+    {
+      if (input == end)
+        return false;
+      unsigned byte = *input++;
+      length += byte;
+      if (byte != 255)
+        return true;
+    }
+  }
+
+  // write one sequence - a copy length of zero is the last sequence
+  // returns false if it would overrun the end of the output
+  static bool lz_put_sequence(unsigned char*& output, const unsigned char* end,
+                              const unsigned char* literals, size_t count, size_t length, size_t offset)
+  {
+    if ((size_t)(end - output) < count + count / 255 + length / 255 + 5)
+      return false;
+    unsigned char* token = output++;
+    size_t literal_code = count < 15 ? count : 15;
+    if (count >= 15)
+      output = lz_put_length(output, count - 15);
+    memcpy(output, literals, count);
+    output += count;
+    size_t match_code = 0;
+    if (length != 0)
+    {
+      *output++ = (unsigned char)offset;
+      *output++ = (unsigned char)(offset >> 8);
+      length -= lz_min_match;
+      match_code = length < 15 ? length : 15;
+      if (length >= 15)
+        output = lz_put_length(output, length - 15);
+    }
+    *token = (unsigned char)((literal_code << 4) | match_code);
+    return true;
+  }
+
+  // the decompressed size, or (size_t)-1 if the data is not valid
+  static size_t lz_decompress(const unsigned char* input, size_t size, unsigned char* output, size_t limit)
+  {
+    const unsigned char* end = input + size;
+    unsigned char* start = output;
+    unsigned char* output_end = output + limit;
+    while (input != end)
+    {
+      unsigned token = *input++;
+      size_t count = token >> 4;
+      if (count == 15 && !lz_get_length(input, end, count))
+        return (size_t)-1;
+      if ((size_t)(end - input) < count || (size_t)(output_end - output) < count)
+        return (size_t)-1;
+      memcpy(output, input, count);
+      output += count;
+      input += count;
+      if (input == end)
+        break;
+      if (end - input < 2)
+        return (size_t)-1;
+      size_t offset = input[0] | ((size_t)input[1] << 8);
+      input += 2;
+      size_t length = token & 15;
+      if (length == 15 && !lz_get_length(input, end, length))
+        return (size_t)-1;
+      length += lz_min_match;
+      if (offset == 0 || offset > (size_t)(output - start) || length > (size_t)(output_end - output))
+        return (size_t)-1;
+      // a copy that overlaps its own output repeats the last offset bytes, which
+      // can be done in blocks that double in size each time
+      const unsigned char* from = output - offset;
+      for (size_t block = offset; length > block; block *= 2)
+      {
+        memcpy(output, from, block);
+        output += block;
+        length -= block;
+      }
+      memcpy(output, from, length);
+      output += length;
+    }
+    return (size_t)(output - start);
+  }
+
+  // compressor state, kept between frames so that the tables are only cleared once
+  // Higher levels search further back along the chain of earlier positions with
+  // the same hash and so find longer matches, more slowly
+
+  class lz_compressor
+  {
+  public:
+    lz_compressor(void) : m_base(1)
+      {
+        memset(m_head, 0, sizeof(m_head));
+      }
+
+    // compress a frame into less than limit bytes, returning the compressed size or zero if it does not fit
+    size_t compress(const unsigned char* data, size_t size, unsigned char* output, size_t limit, unsigned level)
+      {
+        // positions in the head table are offset by m_base, which moves on for each frame
+        // so that positions left from earlier frames are below it and are ignored
+        if (m_base > 0xffffffffu - 2 * (unsigned)frame_size)
+        {
+          memset(m_head, 0, sizeof(m_head));
+          m_base = 1;
+        }
+        m_base += frame_size;
+        unsigned attempts = 1u << (level - 1);
+        unsigned char* start = output;
+        const unsigned char* end = output + limit;
+        const unsigned char* anchor = data;
+        size_t position = 0;
+        while (position + lz_min_match <= size)
+        {
+          size_t distance = insert(data, position);
+          size_t best_length = 0;
+          size_t best_offset = 0;
+          for (unsigned i = 0; distance != 0 && i < attempts; i++)
+          {
+            const unsigned char* earlier = data + position - distance;
+            // a candidate can only be longer if it matches at the current best length
+            if (best_length == 0 || (position + best_length < size && earlier[best_length] == data[position + best_length]))
+            {
+              size_t length = lz_match_length(earlier, data + position, data + size);
+              if (length > best_length)
+              {
+                best_length = length;
+                best_offset = distance;
+              }
+            }
+            size_t step = m_chain[position - distance];
+            if (step == 0)
+              break;
+            distance += step;
+          }
+          if (best_length < (size_t)lz_min_match)
+          {
+            // skip faster through data that is not compressing, especially at low levels
+            position += 1 + ((data + position - anchor) >> (level + 4));
+            continue;
+          }
+          if (!lz_put_sequence(output, end, anchor, (size_t)(data + position - anchor), best_length, best_offset))
+            return 0;
+          // the positions inside the match are only worth adding when searching chains
+          size_t next = position + best_length;
+          if (level > 1)
+            for (position++; position < next && position + lz_min_match <= size; position++)
+              insert(data, position);
+          position = next;
+          anchor = data + position;
+        }
+        if (!lz_put_sequence(output, end, anchor, (size_t)(data + size - anchor), 0, 0))
+          return 0;
+        return (size_t)(output - start);
+      }
+
+  private:
+    unsigned m_base;
+    // the most recent position with each hash
+    unsigned m_head[1 << lz_hash_bits];
+    // for each position, the distance back to the previous one with the same hash, or zero
+    unsigned short m_chain[frame_size];
+
+    // add a position, returning the distance back to the last one with the same hash or zero
+    size_t insert(const unsigned char* data, size_t position)
+      {
+        unsigned& head = m_head[lz_hash(data + position)];
+        size_t distance = head >= m_base ? position - (head - m_base) : 0;
+        m_chain[position] = (unsigned short)distance;
+        head = m_base + (unsigned)position;
+        return distance;
+      }
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // Hash table used for the dump context's maps
+  // Pointer-heavy dumps do one lookup per pointer, so these use open addressing
+  // with linear probing in a single array rather than a tree of nodes. The
+  // table doubles when it becomes half full. Entries are never removed.
+  // Traits provide hash(key) and equal(key,key)
+
+  template<typename K, typename V, typename Traits>
+  class probe_table
+  {
+  public:
+    probe_table(void) : m_size(0), m_slots(16)
+      {
+      }
+
+    size_t size(void) const
+      {
+        return m_size;
+      }
+
+    // the value stored against the key, or null if there isn't one
+    V* find(const K& key)
+      {
+        slot& found = m_slots[locate(m_slots, key)];
+        return found.m_used ? &found.m_value : 0;
+      }
+
+    const V* find(const K& key) const
+      {
+        const slot& found = m_slots[locate(m_slots, key)];
+        return found.m_used ? &found.m_value : 0;
+      }
+
+    // add a new key or replace the value of an existing one
+    void insert(const K& key, const V& value)
+      {
+        if (2 * (m_size + 1) > m_slots.size())
+          grow();
+        slot& found = m_slots[locate(m_slots, key)];
+        if (!found.m_used)
+        {
+          found.m_used = true;
+          found.m_key = key;
+          m_size++;
+        }
+        found.m_value = value;
+      }
+
+  private:
+    struct slot
+    {
+      K m_key;
+      V m_value;
+      bool m_used;
+      slot(void) : m_key(), m_value(), m_used(false) {}
+    };
+
+    size_t m_size;
+    std::vector<slot> m_slots;
+
+    // the slot holding the key or the empty slot where it belongs - the table size is a power of two
+    static size_t locate(const std::vector<slot>& slots, const K& key)
+      {
+        size_t mask = slots.size() - 1;
+        size_t i = Traits::hash(key) & mask;
+        while (slots[i].m_used && !Traits::equal(slots[i].m_key, key))
+          i = (i + 1) & mask;
+        return i;
+      }
+
+    void grow(void)
+      {
+        std::vector<slot> slots(m_slots.size() * 2);
+        for (size_t i = 0; i < m_slots.size(); i++)
+          if (m_slots[i].m_used)
+            slots[locate(slots, m_slots[i].m_key)] = m_slots[i];
+        m_slots.swap(slots);
+      }
+  };
+
+  // pointers are mixed so that the alignment zeros in the low bits do not all land in the same slots
+  struct pointer_traits
+  {
+    static size_t hash(const void* key)
+      {
+        size_t value = (size_t)key;
+        value ^= value >> (sizeof(size_t) * 4);
+        value *= 2654435761u;
+        return value ^ (value >> 15);
+      }
+    static bool equal(const void* left, const void* right)
+      {
+        return left == right;
+      }
+  };
+
+  // type names are the strings returned by std::type_info::name(), which live for the
+  // whole program, but they are compared by content because the same type may have
+  // more than one type_info object when shared libraries are used
+  struct type_name_traits
+  {
+    static size_t hash(const char* key)
+      {
+        size_t value = 2166136261u;
+        for (; *key; key++)
+          value = (value ^ (unsigned char)*key) * 16777619u;
+        return value;
+      }
+    static bool equal(const char* left, const char* right)
+      {
+        return strcmp(left, right) == 0;
+      }
+  };
+
   ////////////////////////////////////////////////////////////////////////////////
   // dump context classes
   ////////////////////////////////////////////////////////////////////////////////
 
+  class dump_context_body;
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // compresses the frames of a compressed dump and writes them in order
+  // Frames are compressed as they are added until the dump reaches
+  // threaded_frames. After that, when C++11 threads are available, they are
+  // queued to a pool of threads and written as they complete, so that the dump
+  // carries on while earlier frames are compressed.
+
+  class frame_compressor
+  {
+  public:
+    enum {threaded_frames = 32, max_threads = 8};
+
+    frame_compressor(dump_context_body& body, unsigned level) :
+      m_body(&body), m_level(level), m_frames(0), m_compressor(0)
+      {
+#ifdef STLPLUS_HAS_CXX11
+        m_added = 0;
+        m_claimed = 0;
+        m_written = 0;
+        m_stop = false;
+#endif
+      }
+
+    ~frame_compressor(void)
+      {
+#ifdef STLPLUS_HAS_CXX11
+        {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          m_stop = true;
+        }
+        m_changed.notify_all();
+        for (unsigned i = 0; i < m_threads.size(); i++)
+          m_threads[i].join();
+        for (unsigned i = 0; i < m_jobs.size(); i++)
+          delete m_jobs[i];
+#endif
+        delete m_compressor;
+      }
+
+    // compress and write one frame of up to frame_size bytes
+    // exceptions: persistent_dump_failed
+    void add(const unsigned char* data, size_t size)
+      {
+        m_frames++;
+#ifdef STLPLUS_HAS_CXX11
+        if (m_frames == threaded_frames)
+          start();
+        if (!m_threads.empty())
+        {
+          std::unique_lock<std::mutex> lock(m_mutex);
+          // make room in the queue by writing the oldest frames as they complete
+          drain(lock, m_jobs.size() - 1);
+          job& next = *m_jobs[m_added % m_jobs.size()];
+          memcpy(next.m_data, data, size);
+          next.m_size = size;
+          next.m_done = false;
+          m_added++;
+          lock.unlock();
+          m_changed.notify_all();
+          return;
+        }
+#endif
+        if (!m_compressor)
+          m_compressor = new lz_compressor;
+        write(data, size, m_packed, m_compressor->compress(data, size, m_packed, size - 1, m_level));
+      }
+
+    // write all the frames added so far
+    // exceptions: persistent_dump_failed
+    void finish(void)
+      {
+#ifdef STLPLUS_HAS_CXX11
+        std::unique_lock<std::mutex> lock(m_mutex);
+        drain(lock, 0);
+#endif
+      }
+
+  private:
+    dump_context_body* m_body;
+    unsigned m_level;
+    size_t m_frames;
+    // used to compress frames without threads
+    lz_compressor* m_compressor;
+    unsigned char m_packed[frame_size];
+
+    // write a frame, compressed unless it did not compress to less than its original size
+    void write(const unsigned char* data, size_t size, const unsigned char* packed, size_t packed_size);
+
+#ifdef STLPLUS_HAS_CXX11
+    struct job
+    {
+      unsigned char m_data[frame_size];
+      size_t m_size;
+      unsigned char m_packed[frame_size];
+      size_t m_packed_size;
+      bool m_done;
+    };
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    // a ring of frames, counted in the order they were added, compressed and written
+    std::vector<job*> m_jobs;
+    size_t m_added;
+    size_t m_claimed;
+    size_t m_written;
+    bool m_stop;
+
+    void start(void)
+      {
+        unsigned threads = std::thread::hardware_concurrency();
+        if (threads > max_threads)
+          threads = max_threads;
+        // with only one processor there is nothing to gain
+        if (threads < 2)
+          return;
+        for (unsigned i = 0; i < 2 * threads; i++)
+          m_jobs.push_back(new job);
+        for (unsigned i = 0; i < threads; i++)
+          m_threads.push_back(std::thread(&frame_compressor::run, this));
+      }
+
+    // write completed frames in order until no more than pending are left in the queue
+    void drain(std::unique_lock<std::mutex>& lock, size_t pending)
+      {
+        while (m_written < m_added)
+        {
+          job& oldest = *m_jobs[m_written % m_jobs.size()];
+          if (!oldest.m_done)
+          {
+            if (m_added - m_written <= pending)
+              break;
+            m_changed.wait(lock);
+            continue;
+          }
+          // the threads do not touch a completed frame, so it can be written without the lock
+          lock.unlock();
+          write(oldest.m_data, oldest.m_size, oldest.m_packed, oldest.m_packed_size);
+          lock.lock();
+          m_written++;
+        }
+      }
+
+    void run(void)
+      {
+        lz_compressor* compressor = new lz_compressor;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+          m_changed.wait(lock, [this]{return m_stop || m_claimed < m_added;});
+          if (m_stop)
+            break;
+          job& next = *m_jobs[m_claimed++ % m_jobs.size()];
+          lock.unlock();
+          next.m_packed_size = compressor->compress(next.m_data, next.m_size, next.m_packed, next.m_size - 1, m_level);
+          lock.lock();
+          next.m_done = true;
+          m_changed.notify_all();
+        }
+        delete compressor;
+      }
+#endif
+
+    // make this class uncopyable
+    frame_compressor(const frame_compressor&);
+    frame_compressor& operator = (const frame_compressor&);
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+
   class dump_context_body
   {
   public:
-    typedef std::map<const void*,unsigned> magic_map;
-    typedef std::map<std::string,dump_context::callback_data> callback_map;
-    typedef std::map<std::string,unsigned> interface_map;
+    enum {buffer_size = 65536};
+    typedef probe_table<const void*,unsigned,pointer_traits> magic_map;
+    typedef probe_table<const char*,dump_context::callback_data,type_name_traits> callback_map;
+    typedef probe_table<const char*,unsigned,type_name_traits> interface_map;
 
     unsigned m_max_key;
     unsigned char m_version;
     bool m_little_endian;
+    bool m_framed;
+    unsigned m_sequence;
+    unsigned m_compression;
+    frame_compressor* m_compressor;
     std::ostream* m_device;
     magic_map m_pointers;
     magic_map m_objects;
     callback_map m_callbacks;
     interface_map m_interfaces;
+    unsigned char m_buffer[buffer_size];
 
-    dump_context_body(std::ostream& device, unsigned char version)  :
-      m_max_key(0), m_version(version), m_little_endian(stlplus::little_endian()), m_device(&device)
+    dump_context_body(std::ostream& device, unsigned char version, bool framed, unsigned compression)  :
+      m_max_key(0), m_version(version), m_little_endian(stlplus::little_endian()),
+      m_framed(framed || compression != 0), m_sequence(0),
+      m_compression(compression < (unsigned)lz_max_level ? compression : (unsigned)lz_max_level), m_compressor(0), m_device(&device)
       {
-        // write the version number as a single byte
-        put(version);
+        // write the version number as a single byte, flagged if the rest of the dump is framed
+        put(m_framed ? (unsigned char)(version | framed_version) : version);
         // map a null pointer onto magic number zero
-        m_pointers[0] = 0;
+        m_pointers.insert(0, 0);
         // test whether the version number is supported
-        if (m_version != 1 && m_version != 2)
+        if (m_version < 1 || m_version > 4)
           throw persistent_dump_failed(std::string("wrong version: ") + to_string(m_version));
+        if (m_compression != 0)
+          m_compressor = new frame_compressor(*this, m_compression);
       }
 
+    ~dump_context_body(void)
+      {
+        delete m_compressor;
+      }
+
+    // unbuffered output - only used for the version number
     void put(unsigned char data)
       {
         if (!m_device->put(data))
           throw persistent_dump_failed(std::string("output device error"));
       }
 
+    void write(const void* data, size_t size)
+      {
+        if (size != 0 && !m_device->write((const char*)data, (std::streamsize)size))
+          throw persistent_dump_failed(std::string("output device error"));
+      }
+
+    // write one frame of a framed dump
+    void write_frame(const void* data, size_t size, unsigned flags)
+      {
+        unsigned char header[frame_header_size];
+        frame_put_field(header, (unsigned)size);
+        frame_put_field(header + 4, m_sequence++);
+        frame_put_field(header + 8, flags);
+        unsigned crc = crc32c(0, header, 12);
+        frame_put_field(header + 12, crc32c(crc, data, size));
+        write(header, frame_header_size);
+        write(data, size);
+      }
+
+    // all buffered output goes through here to be split into frames if required
+    void output(const void* data, size_t size)
+      {
+        if (!m_framed)
+        {
+          write(data, size);
+          return;
+        }
+        const unsigned char* next = (const unsigned char*)data;
+        for (; size > 0; )
+        {
+          size_t part = size < (size_t)frame_size ? size : (size_t)frame_size;
+          if (m_compressor)
+            m_compressor->add(next, part);
+          else
+            write_frame(next, part, 0);
+          next += part;
+          size -= part;
+        }
+      }
+
+    // write an empty frame that marks a flush or the end, after all the frames before it
+    void write_mark(unsigned flags)
+      {
+        if (m_compressor)
+          m_compressor->finish();
+        write_frame(0, 0, flags);
+      }
+
+    void flush(void)
+      {
+        if (!m_device->flush())
+          throw persistent_dump_failed(std::string("output device error"));
+      }
+
     const std::ostream& device(void) const
       {
         return *m_device;
       }
 
+    bool framed(void) const
+      {
+        return m_framed;
+      }
+
+    unsigned compression(void) const
+      {
+        return m_compression;
+      }
+
     unsigned char version(void) const
       {
         return m_version;
@@ -103,92 +847,138 @@ namespace stlplus
 
     std::pair<bool,unsigned> pointer_map(const void* const pointer)
       {
-        magic_map::iterator found = m_pointers.find(pointer);
-        if (found == m_pointers.end())
+        const unsigned* found = m_pointers.find(pointer);
+        if (!found)
         {
           // add a new mapping
           unsigned magic = static_cast<unsigned>(m_pointers.size());
-          m_pointers[pointer] = magic;
+          m_pointers.insert(pointer, magic);
           return std::pair<bool,unsigned>(false,magic);
         }
         // return the old mapping
-        return std::pair<bool,unsigned>(true,found->second);
+        return std::pair<bool,unsigned>(true,*found);
       }
 
     std::pair<bool,unsigned> object_map(const void* const pointer)
       {
-        magic_map::iterator found = m_objects.find(pointer);
-        if (found == m_objects.end())
+        const unsigned* found = m_objects.find(pointer);
+        if (!found)
         {
           // add a new mapping
           unsigned magic = static_cast<unsigned>(m_objects.size());
-          m_objects[pointer] = magic;
+          m_objects.insert(pointer, magic);
           return std::pair<bool,unsigned>(false,magic);
         }
         // return the old mapping
-        return std::pair<bool,unsigned>(true,found->second);
+        return std::pair<bool,unsigned>(true,*found);
       }
 
     unsigned register_callback(const std::type_info& info, dump_context::dump_callback callback)
       {
-        std::string key = info.name();
         unsigned data = ++m_max_key;
-        m_callbacks[key] = std::make_pair(data,callback);
+        m_callbacks.insert(info.name(), std::make_pair(data,callback));
         return data;
       }
 
     bool is_callback(const std::type_info& info) const
       {
-        return m_callbacks.find(info.name()) != m_callbacks.end();
+        return m_callbacks.find(info.name()) != 0;
       }
 
     dump_context::callback_data lookup_callback(const std::type_info& info) const
       {
-        std::string key = info.name();
-        callback_map::const_iterator found = m_callbacks.find(key);
-        if (found == m_callbacks.end())
-          throw persistent_illegal_type(key);
-        return found->second;
+        const dump_context::callback_data* found = m_callbacks.find(info.name());
+        if (!found)
+          throw persistent_illegal_type(std::string(info.name()));
+        return *found;
       }
 
     unsigned register_interface(const std::type_info& info)
       {
-        std::string key = info.name();
         unsigned data = ++m_max_key;
-        m_interfaces[key] = data;
+        m_interfaces.insert(info.name(), data);
         return data;
       }
 
     bool is_interface(const std::type_info& info) const
       {
-        return m_interfaces.find(info.name()) != m_interfaces.end();
+        return m_interfaces.find(info.name()) != 0;
       }
 
     unsigned lookup_interface(const std::type_info& info) const
       {
-        std::string key = info.name();
-        interface_map::const_iterator found = m_interfaces.find(key);
-        if (found == m_interfaces.end())
-          throw persistent_illegal_type(key);
-        return found->second;
+        const unsigned* found = m_interfaces.find(info.name());
+        if (!found)
+          throw persistent_illegal_type(std::string(info.name()));
+        return *found;
       }
   };
 
+  void frame_compressor::write(const unsigned char* data, size_t size, const unsigned char* packed, size_t packed_size)
+  {
+    if (packed_size != 0)
+      m_body->write_frame(packed, packed_size, frame_compressed);
+    else
+      m_body->write_frame(data, size, 0);
+  }
+
   ////////////////////////////////////////////////////////////////////////////////
 
-  dump_context::dump_context(std::ostream& device, unsigned char version)  : m_body(0)
+  dump_context::dump_context(std::ostream& device, unsigned char version, bool framed, unsigned compression)  :
+    m_body(0), m_version(0), m_next(0), m_end(0)
   {
-    m_body = new dump_context_body(device,version);
+    m_body = new dump_context_body(device,version,framed,compression);
+    m_version = m_body->version();
+    m_next = m_body->m_buffer;
+    m_end = m_next + dump_context_body::buffer_size;
   }
 
   dump_context::~dump_context(void)
   {
+    // a destructor cannot report errors - call flush() first to see them
+    try
+    {
+      put_buffer();
+      // a framed dump is closed by an end frame, which the restore may be waiting for
+      if (m_body->framed())
+      {
+        m_body->write_mark(frame_end);
+        m_body->flush();
+      }
+    }
+    catch(...)
+    {
+    }
     delete m_body;
   }
 
-  void dump_context::put(unsigned char data)
+  void dump_context::flush(void)
+  {
+    put_buffer();
+    // mark the flush so that a framed restore does not try to read ahead of it
+    if (m_body->framed())
+      m_body->write_mark(frame_flush);
+    m_body->flush();
+  }
+
+  void dump_context::put_buffer(void)
   {
-    m_body->put(data);
+    // empty the buffer before writing it so that a failed write is not repeated by the destructor
+    size_t size = m_next - m_body->m_buffer;
+    m_next = m_body->m_buffer;
+    m_body->output(m_body->m_buffer, size);
+  }
+
+  void dump_context::put_block(const void* data, size_t size)
+  {
+    put_buffer();
+    if (size < (size_t)dump_context_body::buffer_size)
+    {
+      memcpy(m_next, data, size);
+      m_next += size;
+    }
+    else
+      m_body->output(data, size);
   }
 
   const std::ostream& dump_context::device(void) const
@@ -196,9 +986,14 @@ namespace stlplus
     return m_body->device();
   }
 
-  unsigned char dump_context::version(void) const
+  bool dump_context::framed(void) const
   {
-    return m_body->version();
+    return m_body->framed();
+  }
+
+  unsigned dump_context::compression(void) const
+  {
+    return m_body->compression();
   }
 
   bool dump_context::little_endian(void) const
@@ -255,11 +1050,308 @@ namespace stlplus
   // restore context classes
   ////////////////////////////////////////////////////////////////////////////////
 
+  // a read-only stream buffer over a block of memory
+  // a restore from memory reads the block in place and only uses this to
+  // report the position and error state of the restore through device()
+
+  class memory_device : public std::streambuf
+  {
+  public:
+    memory_device(const void* data, size_t size)
+      {
+        char* begin = const_cast<char*>((const char*)data);
+        setg(begin, begin, begin + size);
+      }
+
+    const unsigned char* next(void) const
+      {
+        return (const unsigned char*)gptr();
+      }
+
+    const unsigned char* end(void) const
+      {
+        return (const unsigned char*)egptr();
+      }
+
+    void seek(const unsigned char* next)
+      {
+        setg(eback(), (char*)next, egptr());
+      }
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // reads, verifies and decompresses the frames of a framed dump
+  // With C++11 threads the next frame is read and expanded by a background
+  // thread while the restore works on the current one. The thread never reads
+  // beyond a flush or end frame until the restore asks for more, but
+  // destroying the reader still waits for any read already in progress.
+  // Destroying the reader reads on to the end frame, except that it stops at
+  // a flush frame with nothing after it yet, since on a pipe or socket the
+  // writer may be waiting for a reply before it sends the end frame. The
+  // device is then positioned after the flush frame.
+
+  class frame_reader
+  {
+  public:
+    frame_reader(std::istream& device) :
+      m_device(&device), m_sequence(0), m_current(0), m_size(0), m_flags(0), m_failed(false), m_finished(false)
+      {
+#ifdef STLPLUS_HAS_CXX11
+        m_ready = false;
+        m_wanted = false;
+        m_paused = false;
+        m_stop = false;
+        m_thread = std::thread(&frame_reader::run, this);
+#endif
+      }
+
+    ~frame_reader(void)
+      {
+#ifdef STLPLUS_HAS_CXX11
+        {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          m_stop = true;
+        }
+        m_changed.notify_all();
+        m_thread.join();
+#endif
+        // read on to the end frame so that the device is positioned after the dump
+        // whether or not the thread had got that far, but don't wait for the
+        // rest of the dump after a flush
+        while (!m_failed && !(m_flags & frame_end))
+        {
+          if ((m_flags & frame_flush) && !input_waiting())
+            break;
+          read(m_buffers[m_current ^ 1]);
+        }
+      }
+
+    // the data of the next frame that has any
+    // exceptions: persistent_restore_failed
+    const unsigned char* next(size_t& size)
+      {
+        for (;;)
+        {
+          if (m_finished)
+            throw persistent_restore_failed(m_message);
+          size_t frame_size_read = 0;
+          unsigned flags = 0;
+          bool failed = false;
+#ifdef STLPLUS_HAS_CXX11
+          {
+            // wait for the thread to fill the spare buffer, then swap it with the
+            // current one and take a copy of the results before the thread moves on
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wanted = true;
+            m_changed.notify_all();
+            m_changed.wait(lock, [this]{return m_ready;});
+            m_wanted = false;
+            m_ready = false;
+            m_current ^= 1;
+            frame_size_read = m_size;
+            flags = m_flags;
+            failed = m_failed;
+            if (failed)
+              m_message = m_error;
+          }
+          m_changed.notify_all();
+#else
+          read(m_buffers[m_current]);
+          frame_size_read = m_size;
+          flags = m_flags;
+          failed = m_failed;
+          if (failed)
+            m_message = m_error;
+#endif
+          if (failed || (flags & frame_end))
+          {
+            m_finished = true;
+            if (!failed)
+              m_message = "device error or premature end of file";
+            throw persistent_restore_failed(m_message);
+          }
+          if (frame_size_read > 0)
+          {
+            size = frame_size_read;
+            return m_buffers[m_current];
+          }
+        }
+      }
+
+  private:
+    std::istream* m_device;
+    unsigned m_sequence;
+    unsigned char m_buffers[2][frame_size];
+    unsigned m_current;
+    // compressed frames are read into here before being expanded into a buffer
+    unsigned char m_packed[frame_size];
+    // the result of the last frame read, written by the thread if there is one
+    size_t m_size;
+    unsigned m_flags;
+    bool m_failed;
+    std::string m_error;
+    // set once the restore has seen the end frame or an error, which is then in m_message
+    bool m_finished;
+    std::string m_message;
+
+    // read one frame, recording any error rather than throwing it
+    void read(unsigned char* buffer)
+      {
+        unsigned char header[frame_header_size];
+        if (!m_device->read((char*)header, frame_header_size))
+        {
+          fail("device error or premature end of file");
+          return;
+        }
+        size_t size = frame_get_field(header);
+        unsigned sequence = frame_get_field(header + 4);
+        unsigned flags = frame_get_field(header + 8);
+        unsigned crc = frame_get_field(header + 12);
+        if (sequence != m_sequence)
+        {
+          fail("frame out of sequence: " + to_string((int)m_sequence));
+          return;
+        }
+        if (size > (size_t)frame_size)
+        {
+          fail("frame too long: " + to_string((int)m_sequence));
+          return;
+        }
+        // compressed data is read separately and expanded into the buffer once it has been checked
+        unsigned char* data = (flags & frame_compressed) ? m_packed : buffer;
+        if (size != 0 && !m_device->read((char*)data, (std::streamsize)size))
+        {
+          fail("device error or premature end of file");
+          return;
+        }
+        if (crc32c(crc32c(0, header, 12), data, size) != crc)
+        {
+          fail("frame checksum error: " + to_string((int)m_sequence));
+          return;
+        }
+        if (flags & frame_compressed)
+        {
+          size = lz_decompress(m_packed, size, buffer, frame_size);
+          if (size == (size_t)-1)
+          {
+            fail("frame decompression error: " + to_string((int)m_sequence));
+            return;
+          }
+        }
+        m_sequence++;
+        m_size = size;
+        m_flags = flags;
+      }
+
+    void fail(const std::string& error)
+      {
+        m_failed = true;
+        m_error = error;
+      }
+
+    // test whether more input has arrived, without blocking
+    bool input_waiting(void) const
+      {
+        std::streambuf* buffer = m_device->good() ? m_device->rdbuf() : 0;
+        return buffer && buffer->in_avail() > 0;
+      }
+
+#ifdef STLPLUS_HAS_CXX11
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    // a frame has been read into the spare buffer
+    bool m_ready;
+    // the restore is waiting for a frame
+    bool m_wanted;
+    // the last frame read was a flush, so don't read ahead
+    bool m_paused;
+    bool m_stop;
+
+    void run(void)
+      {
+        for (;;)
+        {
+          unsigned spare = 0;
+          {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_changed.wait(lock, [this]{return m_stop || (!m_ready && (m_wanted || !m_paused));});
+            if (m_stop)
+              return;
+            spare = m_current ^ 1;
+          }
+          // the restore only touches the spare buffer and the results once m_ready is set
+          read(m_buffers[spare]);
+          bool last = m_failed || (m_flags & frame_end);
+          {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_ready = true;
+            m_paused = (m_flags & frame_flush) != 0;
+          }
+          m_changed.notify_all();
+          if (last)
+            return;
+        }
+      }
+#endif
+
+    // make this class uncopyable
+    frame_reader(const frame_reader&);
+    frame_reader& operator = (const frame_reader&);
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // magic numbers are allocated densely from zero, so they index a vector
+  // a magic number far past the end can only come from a corrupt dump, so it
+  // goes in a map rather than letting one bad number size the vector
+
+  class restore_magic_map
+  {
+  public:
+    enum {slack = 1024};
+
+    std::pair<bool,void*> find(unsigned magic) const
+      {
+        // an unset entry, or one past the end, is a magic number that has never been seen before
+        if (magic < m_dense.size() && m_dense[magic].first)
+          return m_dense[magic];
+        if (m_sparse.empty())
+          return std::pair<bool,void*>(false,(void*)0);
+        std::map<unsigned,void*>::const_iterator found = m_sparse.find(magic);
+        if (found == m_sparse.end())
+          return std::pair<bool,void*>(false,(void*)0);
+        return std::pair<bool,void*>(true,found->second);
+      }
+
+    void add(unsigned magic, void* pointer)
+      {
+        // entries are usually added in order but nested restores can add a later magic number first
+        if (magic >= m_dense.size())
+        {
+          if ((size_t)magic > 2 * m_dense.size() + slack)
+          {
+            m_sparse[magic] = pointer;
+            return;
+          }
+          m_dense.resize((size_t)magic + 1, std::pair<bool,void*>(false,(void*)0));
+        }
+        m_dense[magic] = std::pair<bool,void*>(true,pointer);
+      }
+
+  private:
+    std::vector<std::pair<bool,void*> > m_dense;
+    std::map<unsigned,void*> m_sparse;
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+
   class restore_context_body
   {
   public:
+    enum {buffer_size = 65536};
+    typedef std::char_traits<char> traits;
     typedef persistent* persistent_ptr;
-    typedef std::map<unsigned,void*> magic_map;
+    typedef restore_magic_map magic_map;
     typedef std::map<unsigned,restore_context::callback_data> callback_map;
     typedef std::map<unsigned,persistent_ptr> interface_map;
 
@@ -271,20 +1363,49 @@ namespace stlplus
     magic_map m_objects;
     callback_map m_callbacks;
     interface_map m_interfaces;
+    unsigned char m_buffer[buffer_size];
+    // only used by a restore from memory, in which case m_device is m_memory_stream
+    bool m_in_memory;
+    memory_device m_memory;
+    std::istream m_memory_stream;
+    // only used by a framed restore, which reads the device a frame at a time
+    frame_reader* m_frames;
 
     restore_context_body(std::istream& device)  :
-      m_max_key(0), m_little_endian(stlplus::little_endian()), m_device(&device)
+      m_max_key(0), m_little_endian(stlplus::little_endian()), m_device(&device),
+      m_in_memory(false), m_memory(0,0), m_memory_stream(&m_memory), m_frames(0)
+      {
+        initialise();
+      }
+
+    restore_context_body(const void* data, size_t size)  :
+      m_max_key(0), m_little_endian(stlplus::little_endian()), m_device(&m_memory_stream),
+      m_in_memory(true), m_memory(data,size), m_memory_stream(&m_memory), m_frames(0)
+      {
+        initialise();
+      }
+
+    void initialise(void)
       {
         // map a null pointer onto magic number zero
-        m_pointers[0] = 0;
+        pointer_add(0, 0);
         // get the dump version and see if we support it
         m_version = (unsigned char)get();
-        if (m_version != 1 && m_version != 2)
+        bool framed = (m_version & framed_version) != 0;
+        m_version &= ~framed_version;
+        if (m_version < 1 || m_version > 4)
           throw persistent_restore_failed(std::string("wrong version: ") + to_string(m_version));
+        // framed input, even from memory, is read through the device one frame at a time
+        if (framed)
+        {
+          m_in_memory = false;
+          m_frames = new frame_reader(*m_device);
+        }
       }
 
     ~restore_context_body(void)
       {
+        delete m_frames;
         // need to delete all interfaces
         // I used to use smart_ptr_clone for storing them but I want to disconnect as many dependencies as possible
         for (unsigned i = 0; i < m_interfaces.size(); i++)
@@ -306,6 +1427,12 @@ namespace stlplus
         return m_little_endian;
       }
 
+    bool framed(void) const
+      {
+        return m_frames != 0;
+      }
+
+    // unbuffered input - only used for the version number
     int get(void)
       {
         int result = m_device->get();
@@ -314,36 +1441,77 @@ namespace stlplus
         return result;
       }
 
-    std::pair<bool,void*> pointer_map(unsigned magic)
+    // refill the buffer and return the number of bytes read
+    // only bytes that are already in the device's own buffer are taken, so
+    // that unused ones can be given back by unget
+    size_t fill(void)
       {
-        magic_map::iterator found = m_pointers.find(magic);
-        if (found == m_pointers.end())
+        std::streamsize size = 0;
+        std::streambuf* buffer = m_device->good() ? m_device->rdbuf() : 0;
+        if (buffer && !traits::eq_int_type(buffer->sgetc(), traits::eof()))
         {
-          // this magic number has never been seen before
-          return std::pair<bool,void*>(false,(void*)0);
+          std::streamsize available = buffer->in_avail();
+          if (available < 1)
+            available = 1;
+          else if (available > buffer_size)
+            available = buffer_size;
+          size = buffer->sgetn((char*)m_buffer, available);
         }
-        return std::pair<bool,void*>(true,found->second);
+        if (size <= 0)
+        {
+          m_device->setstate(std::ios_base::eofbit | std::ios_base::failbit);
+          throw persistent_restore_failed(std::string("device error or premature end of file"));
+        }
+        return (size_t)size;
       }
 
-    void pointer_add(unsigned magic, void* new_pointer)
+    void read(void* data, size_t size)
       {
-        m_pointers[magic] = new_pointer;
+        if (size != 0 && !m_device->read((char*)data, (std::streamsize)size))
+          throw persistent_restore_failed(std::string("device error or premature end of file"));
       }
 
-    std::pair<bool,void*> object_map(unsigned magic)
+    // give back the unused part of the buffer so that the device is positioned after the restored data
+    // a restore from memory only has to move the position back to the first unused byte
+    // a framed restore reads whole frames so there is nothing to give back
+    void unget(const unsigned char* next, const unsigned char* end)
       {
-        magic_map::iterator found = m_objects.find(magic);
-        if (found == m_objects.end())
+        if (m_frames)
+          return;
+        if (m_in_memory)
         {
-          // this magic number has never been seen before
-          return std::pair<bool,void*>(false,(void*)0);
+          m_memory.seek(next);
+          return;
+        }
+        std::streambuf* buffer = m_device->rdbuf();
+        while (end != next)
+        {
+          if (!buffer || traits::eq_int_type(buffer->sputbackc((char)*--end), traits::eof()))
+          {
+            m_device->setstate(std::ios_base::badbit);
+            break;
+          }
         }
-        return std::pair<bool,void*>(true,found->second);
+      }
+
+    std::pair<bool,void*> pointer_map(unsigned magic)
+      {
+        return m_pointers.find(magic);
+      }
+
+    void pointer_add(unsigned magic, void* new_pointer)
+      {
+        m_pointers.add(magic, new_pointer);
+      }
+
+    std::pair<bool,void*> object_map(unsigned magic)
+      {
+        return m_objects.find(magic);
       }
 
     void object_add(unsigned magic, void* new_pointer)
       {
-        m_objects[magic] = new_pointer;
+        m_objects.add(magic, new_pointer);
       }
 
     unsigned register_callback(restore_context::create_callback create, restore_context::restore_callback restore)
@@ -390,24 +1558,91 @@ namespace stlplus
   ////////////////////////////////////////////////////////////////////////////////
 
   restore_context::restore_context(std::istream& device)  :
-    m_body(0)
+    m_body(0), m_version(0), m_next(0), m_end(0)
   {
     m_body = new restore_context_body(device);
+    m_version = m_body->version();
+    m_next = m_body->m_buffer;
+    m_end = m_next;
+  }
+
+  restore_context::restore_context(const void* data, size_t size)  :
+    m_body(0), m_version(0), m_next(0), m_end(0)
+  {
+    m_body = new restore_context_body(data,size);
+    m_version = m_body->version();
+    // read the block in place rather than copying it into the buffer, unless it is framed
+    if (m_body->framed())
+    {
+      m_next = m_body->m_buffer;
+      m_end = m_next;
+    }
+    else
+    {
+      m_next = m_body->m_memory.next();
+      m_end = m_body->m_memory.end();
+    }
   }
 
   restore_context::~restore_context(void)
   {
+    // a destructor cannot report errors, which in any case would be on the device
+    try
+    {
+      m_body->unget(m_next, m_end);
+    }
+    catch(...)
+    {
+    }
     delete m_body;
   }
 
-  const std::istream& restore_context::device(void) const
+  void restore_context::get_buffer(void)
   {
-    return m_body->device();
+    if (m_body->framed())
+    {
+      size_t size = 0;
+      m_next = m_body->m_frames->next(size);
+      m_end = m_next + size;
+      return;
+    }
+    // a restore from memory has used up the whole block, so move the device to its end to report the error
+    if (m_body->m_in_memory)
+      m_body->unget(m_end, m_end);
+    m_next = m_body->m_buffer;
+    m_end = m_next;
+    m_end += m_body->fill();
+  }
+
+  void restore_context::get_block(void* data, size_t size)
+  {
+    // use up the buffer then read the rest directly
+    size_t available = m_end - m_next;
+    memcpy(data, m_next, available);
+    m_next = m_end;
+    if (m_body->framed())
+    {
+      // framed input can only be read a frame at a time
+      unsigned char* to = (unsigned char*)data + available;
+      for (size -= available; size > 0; )
+      {
+        get_buffer();
+        size_t chunk = (size_t)(m_end - m_next) < size ? (size_t)(m_end - m_next) : size;
+        memcpy(to, m_next, chunk);
+        m_next += chunk;
+        to += chunk;
+        size -= chunk;
+      }
+      return;
+    }
+    if (m_body->m_in_memory)
+      m_body->unget(m_end, m_end);
+    m_body->read((unsigned char*)data + available, size - available);
   }
 
-  unsigned char restore_context::version(void) const
+  const std::istream& restore_context::device(void) const
   {
-    return m_body->version();
+    return m_body->device();
   }
 
   bool restore_context::little_endian(void) const
@@ -415,9 +1650,9 @@ namespace stlplus
     return m_body->little_endian();
   }
 
-  int restore_context::get(void)
+  bool restore_context::framed(void) const
   {
-    return m_body->get();
+    return m_body->framed();
   }
 
   std::pair<bool,void*> restore_context::pointer_map(unsigned magic)
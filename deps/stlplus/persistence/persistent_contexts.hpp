@@ -9,6 +9,22 @@
 
 //   Core context classes used to control the persistent dump/restore operations
 
+//   Both contexts buffer the device in blocks so that the byte-at-a-time
+//   put/get used by the dump and restore routines are inline and only touch the
+//   device once per block. Dumped output is written to the device by flush() or
+//   when the context is destroyed. A restore only takes bytes that the device's
+//   own buffer has already read, and gives back any it has not used when the
+//   context is destroyed, so the device is left positioned just after the
+//   restored data. A restore can also be done directly from a block of memory,
+//   such as a memory-mapped file, in which case the block itself is the buffer.
+
+//   A dump can optionally be framed, in which case each buffer is written as a
+//   frame with a sequence number and a CRC-32C checksum. The restore detects a
+//   framed dump, verifies each frame as it arrives and, when C++11 threads are
+//   available, reads and verifies the next frame in a background thread. A
+//   framed dump can also be compressed, each frame on its own, which large
+//   dumps do in a pool of background threads.
+
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "persistence_fixes.hpp"
@@ -16,6 +32,8 @@
 #include <iostream>
 #include <map>
 #include <typeinfo>
+#include <stddef.h>
+#include <string.h>
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -45,20 +63,43 @@ namespace stlplus
     //////////////////////////////////////////////////////////////////////////////
 
     // device must be in binary mode
+    // a framed dump is split into checksummed frames so that corruption is detected and
+    // so that it can be streamed through a pipe or socket - see persistent_contexts.cpp
+    // compression is 0 for none or a level from 1 (fastest) to 9 (smallest) and implies framed
     // exceptions: persistent_dump_failed
-    dump_context(std::ostream& device, unsigned char version = PersistentVersion) ;
+    dump_context(std::ostream& device, unsigned char version = PersistentVersion, bool framed = false, unsigned compression = 0) ;
     ~dump_context(void);
 
     // low level output used to dump a byte
     // exceptions: persistent_dump_failed
     void put(unsigned char data) ;
 
+    // low level output used to dump a block of bytes
+    // exceptions: persistent_dump_failed
+    void put_bytes(const void* data, size_t size) ;
+
+    // low level output of the first size bytes of a word, where size is at most sizeof(size_t)
+    // this copies the whole word, so it avoids a copy loop for short blocks of varying size
+    // exceptions: persistent_dump_failed
+    void put_word_bytes(const void* word, size_t size) ;
+
+    // write buffered output to the device and flush it
+    // this is done by the destructor too, but errors can only be reported from here
+    // exceptions: persistent_dump_failed
+    void flush(void) ;
+
     // access the device, for example to check the error status
     const std::ostream& device(void) const;
 
     // recover the version number of the dumped output
     unsigned char version(void) const;
 
+    // test whether the output is framed
+    bool framed(void) const;
+
+    // the compression level, zero if the output is not compressed
+    unsigned compression(void) const;
+
     // test whether the current platform uses little-endian or big-endian addressing of bytes
     // this is used in dump/restore of integers and is exported so that other routines can use it
     bool little_endian(void) const;
@@ -91,6 +132,18 @@ namespace stlplus
     friend class dump_context_body;
     dump_context_body* m_body;
 
+    // the version is tested by every integer dump so it is kept here where it is inline
+    unsigned char m_version;
+
+    // free space in the output buffer, which is owned by the body
+    unsigned char* m_next;
+    unsigned char* m_end;
+
+    // exceptions: persistent_dump_failed
+    void put_buffer(void) ;
+    // exceptions: persistent_dump_failed
+    void put_block(const void* data, size_t size) ;
+
     // disallow copying by making assignment and copy constructor private
     dump_context(const dump_context&);
     dump_context& operator=(const dump_context&);
@@ -108,18 +161,31 @@ namespace stlplus
     // device must be in binary mode
     // exceptions: persistent_restore_failed
     restore_context(std::istream& device) ;
+
+    // restore from a block of memory, for example a memory-mapped file
+    // the block is read in place and must not change or go away while the context exists
+    // device() gives access to a stream over the block, positioned after the restored data
+    // exceptions: persistent_restore_failed
+    restore_context(const void* data, size_t size) ;
     ~restore_context(void);
 
     // low level input used to restore a byte
     // exceptions: persistent_restore_failed
     int get(void) ;
 
+    // low level input used to restore a block of bytes
+    // exceptions: persistent_restore_failed
+    void get_bytes(void* data, size_t size) ;
+
     // access the device, for example to check the error status
     const std::istream& device(void) const;
 
     // access the version number of the input being restored
     unsigned char version(void) const;
 
+    // test whether the input is framed - this is detected from the input itself
+    bool framed(void) const;
+
     // test whether the current platform uses little-endian or big-endian addressing of bytes
     // this is used in dump/restore of integers
     bool little_endian(void) const;
@@ -153,6 +219,18 @@ namespace stlplus
     friend class restore_context_body;
     restore_context_body* m_body;
 
+    // the version is tested by every integer restore so it is kept here where it is inline
+    unsigned char m_version;
+
+    // unread input in the input buffer, which is owned by the body
+    const unsigned char* m_next;
+    const unsigned char* m_end;
+
+    // exceptions: persistent_restore_failed
+    void get_buffer(void) ;
+    // exceptions: persistent_restore_failed
+    void get_block(void* data, size_t size) ;
+
     typedef std::pair<unsigned,persistent*> interface_data;
 
     // disallow copying by making assignment and copy constructor private
@@ -161,6 +239,66 @@ namespace stlplus
   };
 
   ////////////////////////////////////////////////////////////////////////////////
+  // inline buffer access - the slow paths are in persistent_contexts.cpp
+
+  inline unsigned char dump_context::version(void) const
+  {
+    return m_version;
+  }
+
+  inline unsigned char restore_context::version(void) const
+  {
+    return m_version;
+  }
+
+  inline void dump_context::put(unsigned char data)
+  {
+    if (m_next == m_end)
+      put_buffer();
+    *m_next++ = data;
+  }
+
+  inline void dump_context::put_bytes(const void* data, size_t size)
+  {
+    if (size <= (size_t)(m_end - m_next))
+    {
+      memcpy(m_next, data, size);
+      m_next += size;
+    }
+    else
+      put_block(data, size);
+  }
+
+  inline void dump_context::put_word_bytes(const void* word, size_t size)
+  {
+    if (sizeof(size_t) <= (size_t)(m_end - m_next))
+    {
+      memcpy(m_next, word, sizeof(size_t));
+      m_next += size;
+    }
+    else
+      put_block(word, size);
+  }
+
+  inline int restore_context::get(void)
+  {
+    if (m_next == m_end)
+      get_buffer();
+    return *m_next++;
+  }
+
+  inline void restore_context::get_bytes(void* data, size_t size)
+  {
+    if (size <= (size_t)(m_end - m_next))
+    {
+      memcpy(data, m_next, size);
+      m_next += size;
+    }
+    else
+      get_block(data, size);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
 
 } // end namespace stlplus
 
@@ -26,8 +26,7 @@ void stlplus::dump_cstring(stlplus::dump_context& context, const char* data)
   {
     size_t size = strlen(data);
     stlplus::dump_size_t(context,size);
-    for (unsigned i = 0; i < size; i++)
-      stlplus::dump_char(context,data[i]);
+    context.put_bytes(data, size);
   }
 }
 
@@ -52,9 +51,8 @@ void stlplus::restore_cstring(restore_context& context, char*& data)
     size_t size = 0;
     stlplus::restore_size_t(context,size);
     data = new char[size+1];
-    for (size_t i = 0; i < size; i++)
-      stlplus::restore_char(context,data[i]);
     data[size] = '\0';
+    context.get_bytes(data, size);
     // add this pointer to the set of already seen objects
     context.pointer_add(magic,data);
   }
@@ -7,15 +7,10 @@
 
 ////////////////////////////////////////////////////////////////////////////////
 #include "persistent_float.hpp"
-
-////////////////////////////////////////////////////////////////////////////////
-// Macro for mapping either endian data onto little-endian addressing to make
-// my life easier in writing this code! I think better in little-endian mode
-// so the macro does nothing in that mode but maps little-endian onto
-// big-endian addressing in big-endian mode
-// TODO - make this compile-time configurable
-
-#define INDEX(index) ((context.little_endian()) ? (index) : ((bytes) - (index) - 1))
+#include <string.h>
+#ifdef _MSC_VER
+#include <stdlib.h>
+#endif
 
 /////////////////////////////////////////////////////////////////////
 // floating point types
@@ -26,34 +21,87 @@
 // the big-endian and little-endian argument applies to multi-word data so
 // this may need reworking by splitting into words and then bytes.
 
+// The byte order of the target is fixed at compile time (see
+// persistence_fixes.hpp) so a little-endian target reverses the bytes
+// and a big-endian target copies them. Where the compiler has byte-swap
+// intrinsics, the reversal of the common sizes is a single instruction.
+
 namespace stlplus
 {
 
-  static void dump_float(stlplus::dump_context& context, unsigned bytes, unsigned char* data)
+  template<unsigned bytes>
+  static inline void reverse_bytes(unsigned char* to, const unsigned char* from)
+  {
+    for (unsigned i = 0; i < bytes; i++)
+      to[i] = from[bytes - i - 1];
+  }
+
+#if defined(__GNUC__)
+  template<>
+  inline void reverse_bytes<4>(unsigned char* to, const unsigned char* from)
+  {
+    __UINT32_TYPE__ word;
+    memcpy(&word, from, 4);
+    word = __builtin_bswap32(word);
+    memcpy(to, &word, 4);
+  }
+
+  template<>
+  inline void reverse_bytes<8>(unsigned char* to, const unsigned char* from)
   {
-    unsigned i = bytes;
-    // put the size
-    context.put((unsigned char)i);
-    // and put the bytes
-    while(i--)
-      context.put(data[INDEX(i)]);
+    __UINT64_TYPE__ word;
+    memcpy(&word, from, 8);
+    word = __builtin_bswap64(word);
+    memcpy(to, &word, 8);
   }
+#elif defined(_MSC_VER)
+  template<>
+  inline void reverse_bytes<4>(unsigned char* to, const unsigned char* from)
+  {
+    unsigned long word;
+    memcpy(&word, from, 4);
+    word = _byteswap_ulong(word);
+    memcpy(to, &word, 4);
+  }
+
+  template<>
+  inline void reverse_bytes<8>(unsigned char* to, const unsigned char* from)
+  {
+    unsigned __int64 word;
+    memcpy(&word, from, 8);
+    word = _byteswap_uint64(word);
+    memcpy(to, &word, 8);
+  }
+#endif
 
-  static void restore_float(stlplus::restore_context& context, unsigned bytes, unsigned char* data)
+  template<unsigned bytes>
+  static void dump_float(stlplus::dump_context& context, unsigned char* data)
+  {
+    // put the size and then the bytes as one block
+    unsigned char buffer[bytes + 1];
+    buffer[0] = (unsigned char)bytes;
+    if (STLPLUS_LITTLE_ENDIAN)
+      reverse_bytes<bytes>(buffer + 1, data);
+    else
+      memcpy(buffer + 1, data, bytes);
+    context.put_bytes(buffer, bytes + 1);
+  }
+
+  template<unsigned bytes>
+  static void restore_float(stlplus::restore_context& context, unsigned char* data)
   {
     // get the dumped size from the file
     unsigned dumped_bytes = (unsigned)context.get();
-    // get the bytes from the file
-    unsigned i = dumped_bytes;
-    while(i--)
-    {
-      int ch = context.get();
-      if (i < bytes)
-        data[INDEX(i)] = (unsigned char)ch;
-    }
-    // however, if the dumped size was different I don't know how to map the formats, so give an error
+    // if the dumped size was different I don't know how to map the formats, so give an error
     if (dumped_bytes != bytes)
       throw stlplus::persistent_restore_failed(std::string("size mismatch"));
+    // get the bytes from the file
+    unsigned char buffer[bytes];
+    context.get_bytes(buffer, bytes);
+    if (STLPLUS_LITTLE_ENDIAN)
+      reverse_bytes<bytes>(data, buffer);
+    else
+      memcpy(data, buffer, bytes);
   }
 
 } // end namespace stlplus
@@ -63,22 +111,22 @@ namespace stlplus
 
 void stlplus::dump_float(stlplus::dump_context& context, const float& data)
 {
-  stlplus::dump_float(context, sizeof(float), (unsigned char*)&data);
+  stlplus::dump_float<sizeof(float)>(context, (unsigned char*)&data);
 }
 
 void stlplus::restore_float(restore_context& context, float& data)
 {
-  stlplus::restore_float(context, sizeof(float), (unsigned char*)&data);
+  stlplus::restore_float<sizeof(float)>(context, (unsigned char*)&data);
 }
 
 void stlplus::dump_double(stlplus::dump_context& context, const double& data)
 {
-  stlplus::dump_float(context, sizeof(double), (unsigned char*)&data);
+  stlplus::dump_float<sizeof(double)>(context, (unsigned char*)&data);
 }
 
 void stlplus::restore_double(restore_context& context, double& data)
 {
-  stlplus::restore_float(context, sizeof(double), (unsigned char*)&data);
+  stlplus::restore_float<sizeof(double)>(context, (unsigned char*)&data);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
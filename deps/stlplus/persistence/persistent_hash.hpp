@@ -12,6 +12,7 @@
 ////////////////////////////////////////////////////////////////////////////////
 #include "persistence_fixes.hpp"
 #include "persistent_contexts.hpp"
+#include "persistent_parallel.hpp"
 #include "hash.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -27,6 +28,16 @@ namespace stlplus
   template<typename K, typename T, typename H, typename E, typename RK, typename RT>
   void restore_hash(restore_context&, hash<K,T,H,E>& data, RK key_restore_fn, RT val_restore_fn);
 
+  // dump and restore in segments using several threads - see persistent_parallel.hpp
+
+  // exceptions: persistent_dump_failed
+  template<typename K, typename T, typename H, typename E, typename DK, typename DT>
+  void dump_parallel(dump_context&, const hash<K,T,H,E>& data, DK key_dump_fn, DT val_dump_fn, unsigned threads);
+
+  // exceptions: persistent_restore_failed
+  template<typename K, typename T, typename H, typename E, typename RK, typename RT>
+  void restore_parallel(restore_context&, hash<K,T,H,E>& data, RK key_restore_fn, RT val_restore_fn, unsigned threads);
+
 } // end namespace stlplus
 
   ////////////////////////////////////////////////////////////////////////////////
@@ -39,5 +39,66 @@ namespace stlplus
   }
 
   ////////////////////////////////////////////////////////////////////////////////
+  // each segment is restored into a list of its own and these are then
+  // inserted into the hash, since a hash cannot be filled in parallel
+
+  template<typename K, typename T, typename H, typename E, typename RK, typename RT>
+  class persistent_restore_hash_segment
+  {
+  public:
+    persistent_restore_hash_segment(hash<K,T,H,E>& data, RK key_fn, RT val_fn) :
+      m_data(data), m_key_fn(key_fn), m_val_fn(val_fn)
+      {
+      }
+
+    void start(unsigned segments, size_t)
+      {
+        m_data.erase();
+        m_parts.resize(segments);
+      }
+
+    void operator()(restore_context& context, unsigned segment, size_t, size_t size)
+      {
+        std::vector<std::pair<K,T> >& part = m_parts[segment];
+        part.resize(size);
+        for (size_t j = 0; j < size; j++)
+        {
+          m_key_fn(context, part[j].first);
+          m_val_fn(context, part[j].second);
+        }
+      }
+
+    void finish(void)
+      {
+        for (unsigned s = 0; s < m_parts.size(); s++)
+        {
+          std::vector<std::pair<K,T> >& part = m_parts[s];
+          for (size_t j = 0; j < part.size(); j++)
+            m_data.insert(part[j].first, part[j].second);
+          std::vector<std::pair<K,T> >().swap(part);
+        }
+      }
+
+  private:
+    hash<K,T,H,E>& m_data;
+    RK m_key_fn;
+    RT m_val_fn;
+    std::vector<std::vector<std::pair<K,T> > > m_parts;
+  };
+
+  template<typename K, typename T, typename H, typename E, typename DK, typename DT>
+  void dump_parallel(dump_context& context, const hash<K,T,H,E>& data, DK key_fn, DT val_fn, unsigned threads)
+  {
+    persistent_dump_parallel(context, data.begin(), data.size(), persistent_dump_key_value<DK,DT>(key_fn, val_fn), threads);
+  }
+
+  template<typename K, typename T, typename H, typename E, typename RK, typename RT>
+  void restore_parallel(restore_context& context, hash<K,T,H,E>& data, RK key_fn, RT val_fn, unsigned threads)
+  {
+    persistent_restore_hash_segment<K,T,H,E,RK,RT> restore_segment(data, key_fn, val_fn);
+    persistent_restore_parallel(context, restore_segment, threads);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
 
 } // end namespace stlplus
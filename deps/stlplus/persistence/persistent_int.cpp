@@ -7,19 +7,16 @@
 
 ////////////////////////////////////////////////////////////////////////////////
 #include "persistent_int.hpp"
-
-////////////////////////////////////////////////////////////////////////////////
-// Macro for mapping either endian data onto little-endian addressing to make
-// my life easier in writing this code! I think better in little-endian mode
-// so the macro does nothing in that mode but maps little-endian onto
-// big-endian addressing in big-endian mode
-// TODO - make this compile-time configurable so it's more efficient
-
-#define INDEX(index) ((context.little_endian()) ? (index) : ((bytes) - (index) - 1))
+#include <string.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <stdlib.h>
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////
 // Integer types
-// format: {size}{byte}*size
+// format (version 4): {byte}* as a LEB128 varint - see below
+// format (versions 1 to 3): {size}{byte}*size
 // size can be zero!
 //
 // A major problem is that integer types may be different sizes on different
@@ -34,96 +31,214 @@
 // In fact, the standard does not even specify the size of char (true! And
 // mind-numbingly stupid...). However, to be able to do anything at all, I've
 // had to assume that a char is 1 byte.
+//
+// All the integer types are widened into a size_t word, which is at least as
+// big as any of them. The significant bytes are then found by counting the
+// leading zeros of the word and they are put into most-significant-first
+// order with a single byte swap. The byte order of the target is fixed at
+// compile time (see persistence_fixes.hpp) so there are no per-byte tests.
+
+// fails to compile if the largest type dumped here does not fit in a word
+typedef char unsigned_long_fits_in_a_word[sizeof(unsigned long) <= sizeof(size_t) ? 1 : -1];
 
-static void dump_unsigned(stlplus::dump_context& context, unsigned bytes, unsigned char* data)
+static const unsigned word_bytes = sizeof(size_t);
+static const unsigned word_bits = sizeof(size_t) * 8;
 
+// reverse the byte order of a word
+static inline size_t swap_bytes(size_t word)
 {
-  // first skip zero bytes - this may reduce the data to zero bytes long
-  unsigned i = bytes;
-  while(i >= 1 && data[INDEX(i-1)] == 0)
-    i--;
-  // put the remaining size
-  context.put((unsigned char)i);
-  // and put the bytes
-  while(i--)
-    context.put(data[INDEX(i)]);
+#if defined(__GNUC__)
+  return (word_bytes == 8) ? (size_t)__builtin_bswap64(word) : (size_t)__builtin_bswap32((unsigned)word);
+#elif defined(_MSC_VER)
+  return (word_bytes == 8) ? (size_t)_byteswap_uint64(word) : (size_t)_byteswap_ulong((unsigned long)word);
+#else
+  size_t result = 0;
+  for (unsigned i = 0; i < word_bytes; i++)
+  {
+    result = (result << 8) | (word & 0xff);
+    word >>= 8;
+  }
+  return result;
+#endif
 }
 
-static void dump_signed(stlplus::dump_context& context, unsigned bytes, unsigned char* data)
+// the number of bits left after discarding leading zeros
+static inline unsigned significant_bits(size_t word)
+{
+  if (word == 0) return 0;
+#if defined(__GNUC__)
+  // count in a long long so that the result does not depend on the width of size_t
+  return 64 - (unsigned)__builtin_clzll((unsigned long long)word);
+#elif defined(_MSC_VER) && defined(_WIN64)
+  unsigned long index = 0;
+  _BitScanReverse64(&index, word);
+  return (unsigned)index + 1;
+#elif defined(_MSC_VER)
+  unsigned long index = 0;
+  _BitScanReverse(&index, (unsigned long)word);
+  return (unsigned)index + 1;
+#else
+  unsigned bits = 0;
+  for (; word != 0; word >>= 1)
+    bits++;
+  return bits;
+#endif
+}
 
+// put the size and the low-order bytes of the word, most significant first
+static inline void dump_word(stlplus::dump_context& context, size_t word, unsigned bytes)
 {
-  // first skip all-zero or all-one bytes but only if doing so does not change the sign
-  unsigned i = bytes;
-  if (data[INDEX(i-1)] < 128)
-  {
-    // positive number so discard leading zeros but only if the following byte is positive
-    while(i >= 2 && data[INDEX(i-1)] == 0 && data[INDEX(i-2)] < 128)
-      i--;
-  }
-  else
+  unsigned char buffer[1 + sizeof(size_t)];
+  buffer[0] = (unsigned char)bytes;
+  if (bytes > 0)
   {
-    // negative number so discard leading ones but only if the following byte is negative
-    while(i >= 2 && data[INDEX(i-1)] == 255 && data[INDEX(i-2)] >= 128)
-      i--;
+    // move the bytes to the top of the word so that they are the first bytes in big-endian order
+    word <<= (word_bytes - bytes) * 8;
+    if (STLPLUS_LITTLE_ENDIAN)
+      word = swap_bytes(word);
+    memcpy(buffer + 1, &word, sizeof(size_t));
   }
-  // put the remaining size
-  context.put((unsigned char)i);
-  // and put the bytes
-  while(i--)
-    context.put(data[INDEX(i)]);
+  context.put_bytes(buffer, bytes + 1);
 }
 
-static void restore_unsigned(stlplus::restore_context& context, unsigned bytes, unsigned char* data)
-
+// get the size and bytes into the low-order bytes of a word, sign extending if requested
+static inline size_t restore_word(stlplus::restore_context& context, unsigned type_bytes, bool is_signed)
 {
   // get the dumped size from the file
   unsigned dumped_bytes = (unsigned)context.get();
-  // zero fill any empty space
-  unsigned i = bytes;
-  for (; i > dumped_bytes; i--)
-    data[INDEX(i-1)] = 0;
-  // restore the dumped bytes but discard any that don't fit
-  while(i--)
+  if (dumped_bytes > type_bytes)
+    throw stlplus::persistent_restore_failed(std::string("integer overflow"));
+  if (dumped_bytes == 0)
+    return 0;
+  // get the dumped bytes into the top of the word
+  unsigned char buffer[sizeof(size_t)] = {0};
+  context.get_bytes(buffer, dumped_bytes);
+  size_t word = 0;
+  memcpy(&word, buffer, sizeof(size_t));
+  if (STLPLUS_LITTLE_ENDIAN)
+    word = swap_bytes(word);
+  // then shift them down, filling with copies of the sign bit for negative signed values
+  unsigned shift = (word_bytes - dumped_bytes) * 8;
+  if (shift == 0)
+    return word;
+  if (is_signed && (word >> (word_bits - 1)) != 0)
+    return (word >> shift) | (~(size_t)0 << (word_bits - shift));
+  return word >> shift;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// From version 4 integers are dumped as LEB128 varints - 7 bits per byte,
+// least significant first, with the top bit set on every byte but the last.
+// Most integers in a dump are small counts, sizes and pointer keys, which
+// now take one byte rather than a size byte plus at least one data byte.
+// Signed values are zigzag encoded first, so that 0, -1, 1, -2, 2... become
+// 0, 1, 2, 3, 4... and small negative values are small too. The restore
+// still checks that the value fits the type being restored into.
+
+static const unsigned varint_max_bytes = (sizeof(size_t) * 8 + 6) / 7;
+
+// the 7-bit group i of a word moved into byte i
+static inline size_t varint_group(size_t word, unsigned i)
+{
+  return (word << i) & ((size_t)0x7f << (8 * i));
+}
+
+static inline void dump_varint(stlplus::dump_context& context, size_t word)
+{
+  if (word < 0x80)
   {
-    int ch = context.get();
-    if (i < bytes)
-      data[INDEX(i)] = (unsigned char)ch;
-    else
-      throw stlplus::persistent_restore_failed(std::string("integer overflow"));
+    context.put((unsigned char)word);
+    return;
+  }
+  unsigned bytes = (significant_bits(word) + 6) / 7;
+  if (bytes <= word_bytes)
+  {
+    // spread the groups into the bytes of a word and set the top bit of all
+    // but the last without looping, then put the bytes in little-endian order
+    size_t spread = (word & 0x7f) | varint_group(word, 1) | varint_group(word, 2) | varint_group(word, 3);
+    if (word_bytes == 8)
+      spread |= varint_group(word, 4) | varint_group(word, 5) | varint_group(word, 6) | varint_group(word, 7);
+    spread |= (~(size_t)0 / 0xff * 0x80) & (((size_t)1 << (8 * (bytes - 1))) - 1);
+    if (!STLPLUS_LITTLE_ENDIAN)
+      spread = swap_bytes(spread);
+    context.put_word_bytes(&spread, bytes);
+    return;
   }
+  // values too big to spread in a word
+  unsigned char buffer[varint_max_bytes];
+  for (unsigned i = 0; i < bytes; i++, word >>= 7)
+    buffer[i] = (unsigned char)(word | 0x80);
+  buffer[bytes - 1] &= 0x7f;
+  context.put_bytes(buffer, bytes);
 }
 
-static void restore_signed(stlplus::restore_context& context, unsigned bytes, unsigned char* data)
-
+static inline size_t restore_varint(stlplus::restore_context& context, unsigned type_bytes)
 {
-  // get the dumped size from the file
-  unsigned dumped_bytes = (unsigned)context.get();
-  // restore the dumped bytes but discard any that don't fit
-  unsigned i = dumped_bytes;
-  while(i--)
+  // a single byte fits any type, so it needs no checks
+  size_t byte = (size_t)context.get();
+  if (byte < 0x80)
+    return byte;
+  size_t word = byte & 0x7f;
+  for (unsigned shift = 7; byte >= 0x80; shift += 7)
   {
-    int ch = context.get();
-    if (i < bytes)
-      data[INDEX(i)] = (unsigned char)ch;
-    else
+    byte = (size_t)context.get();
+    // fail if any bits would be shifted off the top of the word
+    if (shift >= word_bits || ((byte & 0x7f) >> (word_bits - shift)) != 0)
       throw stlplus::persistent_restore_failed(std::string("integer overflow"));
+    word |= (byte & 0x7f) << shift;
   }
-  // sign extend if the dumped integer was smaller
-  if (dumped_bytes < bytes)
+  if (type_bytes < word_bytes && (word >> (type_bytes * 8)) != 0)
+    throw stlplus::persistent_restore_failed(std::string("integer overflow"));
+  return word;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+static void dump_unsigned(stlplus::dump_context& context, const T& data)
+{
+  size_t word = (size_t)data;
+  if (context.version() >= 4)
+    dump_varint(context, word);
+  else
+    // skip zero bytes - this may reduce the data to zero bytes long
+    dump_word(context, word, (significant_bits(word) + 7) / 8);
+}
+
+template<typename T>
+static void dump_signed(stlplus::dump_context& context, const T& data)
+{
+  // conversion to size_t sign extends negative values
+  size_t word = (size_t)data;
+  size_t magnitude = (data < 0) ? ~word : word;
+  if (context.version() >= 4)
+    // zigzag - the sign moves to the bottom bit and the magnitude above it
+    dump_varint(context, (magnitude << 1) | (word >> (word_bits - 1)));
+  else
+    // skip all-zero or all-one bytes but keep at least one bit that matches the sign
+    dump_word(context, word, (significant_bits(magnitude) + 8) / 8);
+}
+
+template<typename T>
+static void restore_unsigned(stlplus::restore_context& context, T& data)
+{
+  if (context.version() >= 4)
+    data = (T)restore_varint(context, sizeof(T));
+  else
+    data = (T)restore_word(context, sizeof(T), false);
+}
+
+template<typename T>
+static void restore_signed(stlplus::restore_context& context, T& data)
+{
+  if (context.version() >= 4)
   {
-    if (data[INDEX(dumped_bytes-1)] < 128)
-    {
-      // positive so zero fill
-      for (i = dumped_bytes; i < bytes; i++)
-        data[INDEX(i)] = 0;
-    }
-    else
-    {
-      // negative so one fill
-      for (i = dumped_bytes; i < bytes; i++)
-        data[INDEX(i)] = 0xff;
-    }
+    // undo the zigzag - a set bottom bit inverts the rest
+    size_t word = restore_varint(context, sizeof(T));
+    data = (T)((word >> 1) ^ ((size_t)0 - (word & 1)));
   }
+  else
+    data = (T)restore_word(context, sizeof(T), true);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -162,72 +277,72 @@ void stlplus::restore_unsigned_char(restore_context& context, unsigned char& dat
 
 void stlplus::dump_short(stlplus::dump_context& context, const short& data)
 {
-  ::dump_signed(context, sizeof(short), (unsigned char*)&data);
+  ::dump_signed(context, data);
 }
 
 void stlplus::restore_short(restore_context& context, short& data)
 {
-  ::restore_signed(context, sizeof(short),(unsigned char*)&data);
+  ::restore_signed(context, data);
 }
 
 void stlplus::dump_unsigned_short(stlplus::dump_context& context, const unsigned short& data)
 {
-  ::dump_unsigned(context, sizeof(unsigned short), (unsigned char*)&data);
+  ::dump_unsigned(context, data);
 }
 
 void stlplus::restore_unsigned_short(restore_context& context, unsigned short& data)
 {
-  ::restore_unsigned(context, sizeof(unsigned short),(unsigned char*)&data);
+  ::restore_unsigned(context, data);
 }
 
 void stlplus::dump_int(stlplus::dump_context& context, const int& data)
 {
-  ::dump_signed(context, sizeof(int), (unsigned char*)&data);
+  ::dump_signed(context, data);
 }
 
 void stlplus::restore_int(restore_context& context, int& data)
 {
-  ::restore_signed(context, sizeof(int),(unsigned char*)&data);
+  ::restore_signed(context, data);
 }
 
 void stlplus::dump_unsigned(stlplus::dump_context& context, const unsigned& data)
 {
-  ::dump_unsigned(context, sizeof(unsigned), (unsigned char*)&data);
+  ::dump_unsigned(context, data);
 }
 
 void stlplus::restore_unsigned(restore_context& context, unsigned& data)
 {
-  ::restore_unsigned(context, sizeof(unsigned),(unsigned char*)&data);
+  ::restore_unsigned(context, data);
 }
 
 void stlplus::dump_long(stlplus::dump_context& context, const long& data)
 {
-  ::dump_signed(context, sizeof(long), (unsigned char*)&data);
+  ::dump_signed(context, data);
 }
 
 void stlplus::restore_long(restore_context& context, long& data)
 {
-  ::restore_signed(context, sizeof(long),(unsigned char*)&data);
+  ::restore_signed(context, data);
 }
 
 void stlplus::dump_unsigned_long(stlplus::dump_context& context, const unsigned long& data)
 {
-  ::dump_unsigned(context, sizeof(unsigned long), (unsigned char*)&data);
+  ::dump_unsigned(context, data);
 }
 
 void stlplus::restore_unsigned_long(restore_context& context, unsigned long& data)
 {
-  ::restore_unsigned(context, sizeof(unsigned long),(unsigned char*)&data);
+  ::restore_unsigned(context, data);
 }
 
 void stlplus::dump_size_t(stlplus::dump_context& context, const size_t& data)
 {
-  ::dump_unsigned(context, sizeof(size_t), (unsigned char*)&data);
+  ::dump_unsigned(context, data);
 }
 
 void stlplus::restore_size_t(restore_context& context, size_t& data)
 {
-  ::restore_unsigned(context, sizeof(size_t),(unsigned char*)&data);
+  ::restore_unsigned(context, data);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,134 @@
+////////////////////////////////////////////////////////////////////////////////
+
+//   Author:    Andy Rushton
+//   Copyright: (c) Southampton University 1999-2004
+//              (c) Andy Rushton           2004 onwards
+//   License:   BSD License, see ../docs/license.html
+
+////////////////////////////////////////////////////////////////////////////////
+#include "persistent_parallel.hpp"
+#include "persistent_int.hpp"
+#include "persistent_exceptions.hpp"
+#ifdef STLPLUS_HAS_CXX11
+#include <thread>
+#ifndef NO_STLPLUS_CONTAINERS
+#include "task_pool.hpp"
+#endif
+#endif
+
+namespace stlplus
+{
+
+  ////////////////////////////////////////////////////////////////////////////////
+
+  persistent_segment_buffer::persistent_segment_buffer(std::string& data) : m_data(data)
+  {
+  }
+
+  persistent_segment_buffer::int_type persistent_segment_buffer::overflow(int_type data)
+  {
+    if (!traits_type::eq_int_type(data, traits_type::eof()))
+      m_data += traits_type::to_char_type(data);
+    return traits_type::not_eof(data);
+  }
+
+  std::streamsize persistent_segment_buffer::xsputn(const char* data, std::streamsize size)
+  {
+    m_data.append(data, (size_t)size);
+    return size;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+
+  static unsigned parallel_threads(unsigned threads)
+  {
+#ifdef STLPLUS_HAS_CXX11
+    if (threads == 0)
+      threads = std::thread::hardware_concurrency();
+#endif
+    return threads > 0 ? threads : 1;
+  }
+
+  void persistent_run_parallel(persistent_parallel_job& job, unsigned segments, unsigned threads)
+  {
+    threads = parallel_threads(threads);
+    if (threads > segments)
+      threads = segments;
+#if defined(STLPLUS_HAS_CXX11) && !defined(NO_STLPLUS_CONTAINERS)
+    if (threads > 1)
+    {
+      // one task per segment - a segment that throws does not stop the others
+      task_pool pool(threads);
+      for (unsigned segment = 0; segment < segments; segment++)
+        pool.submit([&job, segment]() { job.run(segment); });
+      pool.wait();
+      return;
+    }
+#endif
+    for (unsigned segment = 0; segment < segments; segment++)
+      job.run(segment);
+  }
+
+  unsigned persistent_parallel_segments(size_t size, unsigned threads)
+  {
+    threads = parallel_threads(threads);
+    if (size < (size_t)threads)
+      return size > 0 ? (unsigned)size : 1;
+    return threads;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+
+  void persistent_dump_segments(dump_context& context, const std::vector<size_t>& sizes,
+                                const std::vector<std::string>& segments)
+  {
+    dump_unsigned(context, (unsigned)segments.size());
+    for (unsigned s = 0; s < segments.size(); s++)
+    {
+      dump_size_t(context, sizes[s]);
+      dump_size_t(context, segments[s].size());
+    }
+    for (unsigned s = 0; s < segments.size(); s++)
+      context.put_bytes(segments[s].data(), segments[s].size());
+  }
+
+  void persistent_restore_segments(restore_context& context, std::vector<size_t>& sizes,
+                                   std::vector<size_t>& offsets, std::string& data)
+  {
+    unsigned segments = 0;
+    restore_unsigned(context, segments);
+    sizes.clear();
+    offsets.clear();
+    offsets.push_back(0);
+    // the index comes from the input, so check that the totals do not overflow
+    size_t elements = 0;
+    for (unsigned s = 0; s < segments; s++)
+    {
+      size_t size = 0;
+      restore_size_t(context, size);
+      if (size > ~(size_t)0 - elements)
+        throw persistent_restore_failed(std::string("parallel segment index: too many elements"));
+      elements += size;
+      sizes.push_back(size);
+      size_t bytes = 0;
+      restore_size_t(context, bytes);
+      if (bytes > ~(size_t)0 - offsets.back())
+        throw persistent_restore_failed(std::string("parallel segment index: too many bytes"));
+      offsets.push_back(offsets.back() + bytes);
+    }
+    // grow the data a block at a time so that a corrupt index runs out of input
+    // rather than trying to allocate the whole thing up front
+    data.erase();
+    for (size_t remaining = offsets.back(); remaining > 0; )
+    {
+      size_t block = remaining < 65536 ? remaining : 65536;
+      size_t start = data.size();
+      data.resize(start + block);
+      context.get_bytes(&data[start], block);
+      remaining -= block;
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+
+} // end namespace stlplus
@@ -0,0 +1,114 @@
+#ifndef STLPLUS_PERSISTENT_PARALLEL
+#define STLPLUS_PERSISTENT_PARALLEL
+////////////////////////////////////////////////////////////////////////////////
+
+//   Author:    Andy Rushton
+//   Copyright: (c) Southampton University 1999-2004
+//              (c) Andy Rushton           2004 onwards
+//   License:   BSD License, see ../docs/license.html
+
+//   Parallel persistence of large containers
+
+//   The container is split into one segment per thread and each thread dumps
+//   its segment into memory as a complete dump in its own right. The segments
+//   are then written one after another after an index giving the number of
+//   elements and the number of bytes in each:
+//
+//     {segments}{elements,bytes}*segments{segment}*segments
+//
+//   The restore reads the index and the segments and then restores the
+//   segments in parallel, each into its own part of the result, which for a
+//   map or hash are then merged. The number of threads used to restore does
+//   not have to be the number used to dump. A thread count of 0 means one per
+//   processor. Without C++11 threads the segments are dumped and restored one
+//   after another, so the format is the same on every platform.
+
+//   Each segment has its own dump and restore context, so pointers to the same
+//   object from elements in different segments are restored as different
+//   objects, and the elements cannot contain polymorphic types because there
+//   is no installer to register them with.
+
+////////////////////////////////////////////////////////////////////////////////
+#include "persistence_fixes.hpp"
+#include "persistent_contexts.hpp"
+#include <map>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace stlplus
+{
+
+  // vector
+
+  // exceptions: persistent_dump_failed
+  template<typename T, typename D>
+  void dump_parallel(dump_context&, const std::vector<T>& data, D dump_fn, unsigned threads);
+
+  // exceptions: persistent_restore_failed
+  template<typename T, typename R>
+  void restore_parallel(restore_context&, std::vector<T>& data, R restore_fn, unsigned threads);
+
+  // map
+
+  // exceptions: persistent_dump_failed
+  template<typename K, typename T, typename P, typename DK, typename DT>
+  void dump_parallel(dump_context&, const std::map<K,T,P>& data, DK key_dump_fn, DT val_dump_fn, unsigned threads);
+
+  // exceptions: persistent_restore_failed
+  template<typename K, typename T, typename P, typename RK, typename RT>
+  void restore_parallel(restore_context&, std::map<K,T,P>& data, RK key_restore_fn, RT val_restore_fn, unsigned threads);
+
+  // the hash versions are in persistent_hash.hpp
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // Internals used to implement the parallel dump and restore of each container
+
+  // work split into segments that can be done in parallel
+  class persistent_parallel_job
+  {
+  public:
+    virtual ~persistent_parallel_job(void) {}
+    virtual void run(unsigned segment) = 0;
+  };
+
+  // run every segment of a job on a task_pool of up to the number of threads
+  // given (0 means one per hardware thread), or serially without one
+  // exceptions: rethrows the first exception thrown by any segment
+  void persistent_run_parallel(persistent_parallel_job& job, unsigned segments, unsigned threads);
+
+  // an output device that appends to a string, so that a segment is dumped
+  // straight into its string rather than being copied out of a stream
+  class persistent_segment_buffer : public std::streambuf
+  {
+  public:
+    persistent_segment_buffer(std::string& data);
+
+  protected:
+    int_type overflow(int_type data);
+    std::streamsize xsputn(const char* data, std::streamsize size);
+
+  private:
+    std::string& m_data;
+  };
+
+  // the number of segments to split a container of this size into
+  unsigned persistent_parallel_segments(size_t size, unsigned threads);
+
+  // write the index followed by the segments
+  // exceptions: persistent_dump_failed
+  void persistent_dump_segments(dump_context& context, const std::vector<size_t>& sizes,
+                                const std::vector<std::string>& segments);
+
+  // read the index and the segments - segment i is in data from offsets[i] to offsets[i+1]
+  // exceptions: persistent_restore_failed
+  void persistent_restore_segments(restore_context& context, std::vector<size_t>& sizes,
+                                   std::vector<size_t>& offsets, std::string& data);
+
+} // end namespace stlplus
+
+  ////////////////////////////////////////////////////////////////////////////////
+#include "persistent_parallel.tpp"
+#endif
@@ -0,0 +1,260 @@
+////////////////////////////////////////////////////////////////////////////////
+
+//   Author:    Andy Rushton
+//   Copyright: (c) Southampton University 1999-2004
+//              (c) Andy Rushton           2004 onwards
+//   License:   BSD License, see ../docs/license.html
+
+////////////////////////////////////////////////////////////////////////////////
+#include <ostream>
+#include <utility>
+
+namespace stlplus
+{
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // dump each segment of a container into a string of its own
+  // E dumps the element that an iterator points to
+
+  template<typename I, typename E>
+  class persistent_dump_job : public persistent_parallel_job
+  {
+  public:
+    std::vector<I> m_starts;
+    std::vector<size_t> m_sizes;
+    std::vector<std::string> m_segments;
+
+    persistent_dump_job(I begin, size_t size, unsigned segments, unsigned char version, E dump_element) :
+      m_version(version), m_dump_element(dump_element)
+      {
+        // step through the container once to find where each segment starts
+        for (unsigned s = 0; s < segments; s++)
+        {
+          size_t part = size / segments + (s < size % segments ? 1 : 0);
+          m_starts.push_back(begin);
+          m_sizes.push_back(part);
+          for (size_t j = 0; j < part; j++)
+            ++begin;
+        }
+        m_segments.resize(segments);
+      }
+
+    void run(unsigned segment)
+      {
+        persistent_segment_buffer buffer(m_segments[segment]);
+        std::ostream output(&buffer);
+        dump_context context(output, m_version);
+        I i = m_starts[segment];
+        for (size_t j = 0; j < m_sizes[segment]; j++, ++i)
+          m_dump_element(context, i);
+        context.flush();
+      }
+
+  private:
+    unsigned char m_version;
+    E m_dump_element;
+  };
+
+  template<typename I, typename E>
+  void persistent_dump_parallel(dump_context& context, I begin, size_t size, E dump_element, unsigned threads)
+  {
+    unsigned segments = persistent_parallel_segments(size, threads);
+    persistent_dump_job<I,E> job(begin, size, segments, context.version(), dump_element);
+    persistent_run_parallel(job, segments, threads);
+    persistent_dump_segments(context, job.m_sizes, job.m_segments);
+  }
+
+  template<typename D>
+  class persistent_dump_value
+  {
+  public:
+    persistent_dump_value(D dump_fn) : m_dump_fn(dump_fn) {}
+
+    template<typename I>
+    void operator()(dump_context& context, I i)
+      {
+        m_dump_fn(context, *i);
+      }
+
+  private:
+    D m_dump_fn;
+  };
+
+  template<typename DK, typename DT>
+  class persistent_dump_key_value
+  {
+  public:
+    persistent_dump_key_value(DK key_fn, DT val_fn) : m_key_fn(key_fn), m_val_fn(val_fn) {}
+
+    template<typename I>
+    void operator()(dump_context& context, I i)
+      {
+        m_key_fn(context, i->first);
+        m_val_fn(context, i->second);
+      }
+
+  private:
+    DK m_key_fn;
+    DT m_val_fn;
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // restore each segment from its own part of the data
+  // S restores the elements of one segment into the container, with start()
+  // called before the segments are restored and finish() after
+
+  template<typename S>
+  class persistent_restore_job : public persistent_parallel_job
+  {
+  public:
+    std::vector<size_t> m_sizes;
+    std::vector<size_t> m_offsets;
+    std::vector<size_t> m_firsts;
+    std::string m_data;
+
+    persistent_restore_job(S& restore_segment) : m_restore_segment(restore_segment) {}
+
+    void run(unsigned segment)
+      {
+        restore_context context(m_data.data() + m_offsets[segment], m_offsets[segment+1] - m_offsets[segment]);
+        m_restore_segment(context, segment, m_firsts[segment], m_sizes[segment]);
+      }
+
+  private:
+    S& m_restore_segment;
+  };
+
+  template<typename S>
+  void persistent_restore_parallel(restore_context& context, S& restore_segment, unsigned threads)
+  {
+    persistent_restore_job<S> job(restore_segment);
+    persistent_restore_segments(context, job.m_sizes, job.m_offsets, job.m_data);
+    unsigned segments = (unsigned)job.m_sizes.size();
+    size_t size = 0;
+    for (unsigned s = 0; s < segments; s++)
+    {
+      job.m_firsts.push_back(size);
+      size += job.m_sizes[s];
+    }
+    restore_segment.start(segments, size);
+    persistent_run_parallel(job, segments, threads);
+    restore_segment.finish();
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // vector - each segment is restored straight into its own range of elements
+
+  template<typename T, typename R>
+  class persistent_restore_vector_segment
+  {
+  public:
+    persistent_restore_vector_segment(std::vector<T>& data, R restore_fn) : m_data(data), m_restore_fn(restore_fn) {}
+
+    void start(unsigned, size_t size)
+      {
+        if (size > m_data.max_size())
+          throw persistent_restore_failed(std::string("parallel vector: too many elements"));
+        m_data.resize(size);
+      }
+
+    void operator()(restore_context& context, unsigned, size_t first, size_t size)
+      {
+        for (size_t i = first; i < first + size; i++)
+          m_restore_fn(context, m_data[i]);
+      }
+
+    void finish(void)
+      {
+      }
+
+  private:
+    std::vector<T>& m_data;
+    R m_restore_fn;
+  };
+
+  template<typename T, typename D>
+  void dump_parallel(dump_context& context, const std::vector<T>& data, D dump_fn, unsigned threads)
+  {
+    persistent_dump_parallel(context, data.begin(), data.size(), persistent_dump_value<D>(dump_fn), threads);
+  }
+
+  template<typename T, typename R>
+  void restore_parallel(restore_context& context, std::vector<T>& data, R restore_fn, unsigned threads)
+  {
+    persistent_restore_vector_segment<T,R> restore_segment(data, restore_fn);
+    persistent_restore_parallel(context, restore_segment, threads);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // map - each segment is restored into a map of its own and these are then
+  // merged, which is quick because the segments are in key order
+
+  template<typename K, typename T, typename P, typename RK, typename RT>
+  class persistent_restore_map_segment
+  {
+  public:
+    persistent_restore_map_segment(std::map<K,T,P>& data, RK key_fn, RT val_fn) :
+      m_data(data), m_key_fn(key_fn), m_val_fn(val_fn)
+      {
+      }
+
+    void start(unsigned segments, size_t)
+      {
+        m_data.clear();
+        m_parts.assign(segments, std::map<K,T,P>(m_data.key_comp()));
+      }
+
+    void operator()(restore_context& context, unsigned segment, size_t, size_t size)
+      {
+        std::map<K,T,P>& part = m_parts[segment];
+        for (size_t j = 0; j < size; j++)
+        {
+          K key;
+          m_key_fn(context, key);
+          typename std::map<K,T,P>::iterator i = part.insert(part.end(), std::make_pair(key, T()));
+          m_val_fn(context, i->second);
+        }
+      }
+
+    void finish(void)
+      {
+        for (unsigned s = 0; s < m_parts.size(); s++)
+        {
+          std::map<K,T,P>& part = m_parts[s];
+          if (m_data.empty())
+            m_data.swap(part);
+#if defined(STLPLUS_HAS_CXX11) && (__cplusplus >= 201703L)
+          // C++17 can move the nodes across without copying or reallocating them
+          while (!part.empty())
+            m_data.insert(m_data.end(), part.extract(part.begin()));
+#else
+          for (typename std::map<K,T,P>::iterator i = part.begin(); i != part.end(); i++)
+            m_data.insert(m_data.end(), *i);
+          part.clear();
+#endif
+        }
+      }
+
+  private:
+    std::map<K,T,P>& m_data;
+    RK m_key_fn;
+    RT m_val_fn;
+    std::vector<std::map<K,T,P> > m_parts;
+  };
+
+  template<typename K, typename T, typename P, typename DK, typename DT>
+  void dump_parallel(dump_context& context, const std::map<K,T,P>& data, DK key_fn, DT val_fn, unsigned threads)
+  {
+    persistent_dump_parallel(context, data.begin(), data.size(), persistent_dump_key_value<DK,DT>(key_fn, val_fn), threads);
+  }
+
+  template<typename K, typename T, typename P, typename RK, typename RT>
+  void restore_parallel(restore_context& context, std::map<K,T,P>& data, RK key_fn, RT val_fn, unsigned threads)
+  {
+    persistent_restore_map_segment<K,T,P,RK,RT> restore_segment(data, key_fn, val_fn);
+    persistent_restore_parallel(context, restore_segment, threads);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+
+} // end namespace stlplus
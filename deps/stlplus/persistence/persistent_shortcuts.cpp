@@ -0,0 +1,116 @@
+////////////////////////////////////////////////////////////////////////////////
+
+//   Author:    Andy Rushton
+//   Copyright: (c) Southampton University 1999-2004
+//              (c) Andy Rushton           2004 onwards
+//   License:   BSD License, see ../docs/license.html
+
+////////////////////////////////////////////////////////////////////////////////
+#include "persistent_shortcuts.hpp"
+#include "persistent_exceptions.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace stlplus
+{
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // memory-mapped file
+
+#ifdef _WIN32
+
+  persistent_mapped_file::persistent_mapped_file(const std::string& filename)  :
+    m_data(0), m_size(0), m_file(INVALID_HANDLE_VALUE), m_mapping(0)
+  {
+    m_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+                         FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (m_file == INVALID_HANDLE_VALUE)
+      throw persistent_restore_failed(std::string("cannot open file: ") + filename);
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size))
+    {
+      CloseHandle(m_file);
+      throw persistent_restore_failed(std::string("cannot read file size: ") + filename);
+    }
+    m_size = (size_t)size.QuadPart;
+    // an empty file cannot be mapped, so leave it with no contents
+    if (m_size == 0)
+      return;
+    m_mapping = CreateFileMappingA(m_file, 0, PAGE_READONLY, 0, 0, 0);
+    if (m_mapping)
+      m_data = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!m_data)
+    {
+      if (m_mapping) CloseHandle(m_mapping);
+      CloseHandle(m_file);
+      throw persistent_restore_failed(std::string("cannot map file: ") + filename);
+    }
+  }
+
+  persistent_mapped_file::~persistent_mapped_file(void)
+  {
+    if (m_data) UnmapViewOfFile(m_data);
+    if (m_mapping) CloseHandle(m_mapping);
+    CloseHandle(m_file);
+  }
+
+#else
+
+  persistent_mapped_file::persistent_mapped_file(const std::string& filename)  :
+    m_data(0), m_size(0)
+  {
+    int file = open(filename.c_str(), O_RDONLY);
+    if (file < 0)
+      throw persistent_restore_failed(std::string("cannot open file: ") + filename);
+    struct stat status;
+    if (fstat(file, &status) != 0)
+    {
+      close(file);
+      throw persistent_restore_failed(std::string("cannot read file size: ") + filename);
+    }
+    m_size = (size_t)status.st_size;
+    // an empty file cannot be mapped, so leave it with no contents
+    if (m_size != 0)
+    {
+      void* data = mmap(0, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+      if (data == MAP_FAILED)
+      {
+        close(file);
+        throw persistent_restore_failed(std::string("cannot map file: ") + filename);
+      }
+      // a restore reads the file from start to end
+      madvise(data, m_size, MADV_SEQUENTIAL);
+      m_data = data;
+    }
+    // the mapping stays valid after the file is closed
+    close(file);
+  }
+
+  persistent_mapped_file::~persistent_mapped_file(void)
+  {
+    if (m_data) munmap(const_cast<void*>(m_data), m_size);
+  }
+
+#endif
+
+  const void* persistent_mapped_file::data(void) const
+  {
+    return m_data;
+  }
+
+  size_t persistent_mapped_file::size(void) const
+  {
+    return m_size;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+
+} // end namespace stlplus
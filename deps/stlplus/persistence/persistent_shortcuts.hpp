@@ -18,9 +18,15 @@
 //   polymorphic types used in the data structure, then the callback can be set
 //   to null (i.e. 0).
 
+//   The dump functions take an optional compression level, which is 0 for an
+//   uncompressed dump or from 1 (fastest) to 9 (smallest). The restore
+//   functions detect a compressed dump for themselves.
+
 ////////////////////////////////////////////////////////////////////////////////
 #include "persistence_fixes.hpp"
 #include "persistent_contexts.hpp"
+#include <string>
+#include <stddef.h>
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -33,7 +39,8 @@ namespace stlplus
 
   // exceptions: persistent_dump_failed
   template<typename T, class D>
-  void dump_to_device(const T& source, std::ostream& result, D dump_fn, dump_context::installer installer);
+  void dump_to_device(const T& source, std::ostream& result, D dump_fn, dump_context::installer installer,
+                      unsigned compression = 0);
 
   // exceptions: persistent_restore_failed
   template<typename T, class R>
@@ -44,24 +51,67 @@ namespace stlplus
 
   // exceptions: persistent_dump_failed
   template<typename T, class D>
-  void dump_to_string(const T& source, std::string& result, D dump_fn, dump_context::installer installer);
+  void dump_to_string(const T& source, std::string& result, D dump_fn, dump_context::installer installer,
+                      unsigned compression = 0);
 
   // exceptions: persistent_restore_failed
   template<typename T, class R>
   void restore_from_string(const std::string& source, T& result, R restore_fn, restore_context::installer installer);
 
+  ////////////////////////////////////////////////////////////////////////////////
+  // block of memory - restored in place without copying
+
+  // exceptions: persistent_restore_failed
+  template<typename T, class R>
+  void restore_from_memory(const void* source, size_t size, T& result, R restore_fn, restore_context::installer installer);
+
   ////////////////////////////////////////////////////////////////////////////////
   // file IO device
 
   // exceptions: persistent_dump_failed
   template<typename T, class D>
-  void dump_to_file(const T& source, const std::string& filename, D dump_fn, dump_context::installer installer);
+  void dump_to_file(const T& source, const std::string& filename, D dump_fn, dump_context::installer installer,
+                    unsigned compression = 0);
 
   // exceptions: persistent_restore_failed
   template<typename T, class R>
   void restore_from_file(const std::string& filename, T& result, R restore_fn, restore_context::installer installer);
 
   ////////////////////////////////////////////////////////////////////////////////
+  // memory-mapped file
+  // the file is mapped read-only and restored in place, so the restore reads
+  // straight from the operating system's page cache instead of through a stream
+
+  // exceptions: persistent_restore_failed
+  template<typename T, class R>
+  void restore_from_mapped_file(const std::string& filename, T& result, R restore_fn, restore_context::installer installer);
+
+  // a read-only mapping of a whole file, used by restore_from_mapped_file
+  class persistent_mapped_file
+  {
+  public:
+    // exceptions: persistent_restore_failed
+    persistent_mapped_file(const std::string& filename) ;
+    ~persistent_mapped_file(void);
+
+    // the mapped contents - an empty file has no contents and data() is null
+    const void* data(void) const;
+    size_t size(void) const;
+
+  private:
+    const void* m_data;
+    size_t m_size;
+#ifdef _WIN32
+    void* m_file;
+    void* m_mapping;
+#endif
+
+    // make this class uncopyable
+    persistent_mapped_file(const persistent_mapped_file&);
+    persistent_mapped_file& operator = (const persistent_mapped_file&);
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
 
 } // end namespace stlplus
 
@@ -16,11 +16,13 @@ namespace stlplus
 
   template<typename T, class D>
   void dump_to_device(const T& source, std::ostream& result, D dump_fn,
-                      dump_context::installer installer)
+                      dump_context::installer installer, unsigned compression)
   {
-    dump_context context(result);
+    dump_context context(result, PersistentVersion, false, compression);
     context.register_all(installer);
     dump_fn(context, source);
+    // the destructor cannot report errors, so flush here to see them
+    context.flush();
   }
 
   template<typename T, class R>
@@ -36,10 +38,10 @@ namespace stlplus
 
   template<typename T, class D>
   void dump_to_string(const T& source, std::string& result, D dump_fn,
-                      dump_context::installer installer)
+                      dump_context::installer installer, unsigned compression)
   {
     std::ostringstream output(std::ios_base::out | std::ios_base::binary);
-    dump_to_device<T,D>(source, output, dump_fn, installer);
+    dump_to_device<T,D>(source, output, dump_fn, installer, compression);
     result = output.str();
   }
 
@@ -47,18 +49,28 @@ namespace stlplus
   void restore_from_string(const std::string& source, T& result, R restore_fn,
                            restore_context::installer installer)
   {
-    std::istringstream input(source, std::ios_base::in | std::ios_base::binary);
-    restore_from_device<T,R>(input, result, restore_fn, installer);
+    restore_from_memory<T,R>(source.data(), source.size(), result, restore_fn, installer);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+
+  template<typename T, class R>
+  void restore_from_memory(const void* source, size_t size, T& result, R restore_fn,
+                           restore_context::installer installer)
+  {
+    restore_context context(source, size);
+    context.register_all(installer);
+    restore_fn(context, result);
   }
 
   ////////////////////////////////////////////////////////////////////////////////
 
   template<typename T, class D>
   void dump_to_file(const T& source, const std::string& filename, D dump_fn,
-                    dump_context::installer installer)
+                    dump_context::installer installer, unsigned compression)
   {
     std::ofstream output(filename.c_str(), std::ios_base::out | std::ios_base::binary);
-    dump_to_device<T,D>(source, output, dump_fn, installer);
+    dump_to_device<T,D>(source, output, dump_fn, installer, compression);
   }
 
   template<typename T, class R>
@@ -71,4 +83,14 @@ namespace stlplus
 
   ////////////////////////////////////////////////////////////////////////////////
 
+  template<typename T, class R>
+  void restore_from_mapped_file(const std::string& filename, T& result, R restore_fn,
+                                restore_context::installer installer)
+  {
+    persistent_mapped_file input(filename);
+    restore_from_memory<T,R>(input.data(), input.size(), result, restore_fn, installer);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+
 } // end namespace stlplus
@@ -51,6 +51,16 @@ namespace stlplus
 
   // smart_ptr_nocopy is not made persistent because if it is uncopyable, it must be undumpable
 
+  // smart_ptr_intrusive - uses dump/restore_pointer on the contents, so aliases are found by object address
+
+  // exceptions: persistent_dump_failed
+  template<typename T, typename DE>
+  void dump_smart_ptr_intrusive(dump_context&, const smart_ptr_intrusive<T>& data, DE dump_element);
+
+  // exceptions: persistent_restore_failed
+  template<typename T, typename RE>
+  void restore_smart_ptr_intrusive(restore_context&, smart_ptr_intrusive<T>& data, RE restore_element);
+
 } // end namespace stlplus
 
   ////////////////////////////////////////////////////////////////////////////////
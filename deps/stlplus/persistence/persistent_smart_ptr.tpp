@@ -169,3 +169,28 @@ void stlplus::restore_smart_ptr_clone_interface(stlplus::restore_context& contex
 }
 
 ////////////////////////////////////////////////////////////////////////////////
+// smart_ptr_intrusive
+
+template<typename T, typename DE>
+void stlplus::dump_smart_ptr_intrusive(stlplus::dump_context& context, const stlplus::smart_ptr_intrusive<T>& data,
+                                       DE dump_element)
+
+{
+  // there is no holder, and null intrusive pointers are never aliases of each
+  // other, so the object address is enough to tell which pointers are aliases
+  stlplus::dump_pointer(context,data.pointer(),dump_element);
+}
+
+template<typename T, typename RE>
+void stlplus::restore_smart_ptr_intrusive(stlplus::restore_context& context, stlplus::smart_ptr_intrusive<T>& data,
+                                          RE restore_element)
+
+{
+  // release this alias first - restore_pointer deletes any object it is given
+  data.clear();
+  T* value = 0;
+  stlplus::restore_pointer(context,value,restore_element);
+  data.set(value);
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,481 @@
+////////////////////////////////////////////////////////////////////////////////
+
+//   Author:    Andy Rushton
+//   Copyright: (c) Southampton University 1999-2004
+//              (c) Andy Rushton           2004 onwards
+//   License:   BSD License, see ../docs/license.html
+
+////////////////////////////////////////////////////////////////////////////////
+#include "persistent_snapshot.hpp"
+#include "persistent_exceptions.hpp"
+#include <fstream>
+#include <streambuf>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#ifdef STLPLUS_SNAPSHOT_FORK
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#elif defined(STLPLUS_HAS_CXX11)
+#include <mutex>
+#include <thread>
+#endif
+
+namespace stlplus
+{
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // the state of a snapshot
+  // m_written, m_succeeded and m_error are collected from the background
+  // m_bytes is the count last reported by progress()
+
+  class persistent_snapshot_body
+  {
+  public:
+    persistent_snapshot_job* m_job;
+    std::string m_filename;
+    dump_context::installer m_installer;
+    unsigned m_compression;
+    bool m_running;
+    size_t m_bytes;
+    size_t m_written;
+    bool m_succeeded;
+    std::string m_error;
+#ifdef STLPLUS_SNAPSHOT_FORK
+    // the child process reports progress and errors through a pipe as messages:
+    //   'p' followed by the byte count written so far
+    //   'e' followed by the length and text of an error message
+    pid_t m_pid;
+    int m_pipe;
+    std::string m_messages;
+#elif defined(STLPLUS_HAS_CXX11)
+    std::thread m_thread;
+    std::mutex m_mutex;
+    bool m_thread_done;
+    size_t m_thread_written;
+    bool m_thread_succeeded;
+    std::string m_thread_error;
+#endif
+
+    persistent_snapshot_body(void) :
+      m_job(0), m_installer(0), m_compression(0), m_running(false), m_bytes(0), m_written(0), m_succeeded(false)
+#ifdef STLPLUS_SNAPSHOT_FORK
+      , m_pid(-1), m_pipe(-1)
+#elif defined(STLPLUS_HAS_CXX11)
+      , m_thread_done(false), m_thread_written(0), m_thread_succeeded(false)
+#endif
+      {
+      }
+
+    // called in the background each time a block of the dump is written
+    void report(size_t written);
+
+    // called by the caller to collect the state from the background
+    // returns true when the snapshot is done
+    bool collect(bool block);
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // dump the snapshot in the background - this is run in the child process or thread
+
+  // a file device that reports the number of bytes written as it goes
+  class snapshot_buffer : public std::streambuf
+  {
+  public:
+    snapshot_buffer(std::streambuf& file, persistent_snapshot_body& body) :
+      m_file(file), m_body(body), m_written(0)
+      {
+      }
+
+  protected:
+    int_type overflow(int_type data)
+      {
+        if (traits_type::eq_int_type(data, traits_type::eof()))
+          return traits_type::not_eof(data);
+        char byte = traits_type::to_char_type(data);
+        return xsputn(&byte, 1) == 1 ? data : traits_type::eof();
+      }
+
+    std::streamsize xsputn(const char* data, std::streamsize size)
+      {
+        std::streamsize written = m_file.sputn(data, size);
+        if (written > 0)
+        {
+          m_written += (size_t)written;
+          m_body.report(m_written);
+        }
+        return written;
+      }
+
+    int sync(void)
+      {
+        return m_file.pubsync();
+      }
+
+  private:
+    std::streambuf& m_file;
+    persistent_snapshot_body& m_body;
+    size_t m_written;
+  };
+
+  // write to a temporary file and rename it over the snapshot file once it is complete
+  static bool snapshot_dump(persistent_snapshot_body& body, std::string& error)
+  {
+    std::string temporary = body.m_filename + ".tmp";
+    try
+    {
+      std::filebuf file;
+      if (!file.open(temporary.c_str(), std::ios_base::out | std::ios_base::trunc | std::ios_base::binary))
+        throw persistent_dump_failed(std::string("cannot open file: ") + temporary);
+      snapshot_buffer buffer(file, body);
+      std::ostream output(&buffer);
+      {
+        dump_context context(output, PersistentVersion, false, body.m_compression);
+        context.register_all(body.m_installer);
+        body.m_job->dump(context);
+        context.flush();
+      }
+      if (!output || !file.close())
+        throw persistent_dump_failed(std::string("cannot write file: ") + temporary);
+#ifdef _WIN32
+      if (!MoveFileExA(temporary.c_str(), body.m_filename.c_str(), MOVEFILE_REPLACE_EXISTING))
+#else
+      if (rename(temporary.c_str(), body.m_filename.c_str()) != 0)
+#endif
+        throw persistent_dump_failed(std::string("cannot rename file: ") + temporary);
+    }
+    catch(std::exception& except)
+    {
+      error = except.what();
+      remove(temporary.c_str());
+      return false;
+    }
+    catch(...)
+    {
+      error = "unknown exception";
+      remove(temporary.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // Unix - dump in a forked child process
+
+#ifdef STLPLUS_SNAPSHOT_FORK
+
+  static bool snapshot_send(int pipe, const std::string& message)
+  {
+    for (size_t sent = 0; sent < message.size(); )
+    {
+      ssize_t written = write(pipe, message.data() + sent, message.size() - sent);
+      if (written < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        return false;
+      }
+      sent += (size_t)written;
+    }
+    return true;
+  }
+
+  static std::string snapshot_message(char type, size_t value)
+  {
+    std::string message(1 + sizeof(size_t), type);
+    memcpy(&message[1], &value, sizeof(size_t));
+    return message;
+  }
+
+  static void snapshot_blocking(int pipe, bool block)
+  {
+    int flags = fcntl(pipe, F_GETFL);
+    if (flags != -1)
+      fcntl(pipe, F_SETFL, block ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK));
+  }
+
+  void persistent_snapshot_body::report(size_t written)
+  {
+    // the pipe does not block, so if the caller has not collected earlier
+    // reports and the pipe is full this one is dropped - a message is smaller
+    // than PIPE_BUF so it is never split
+    m_written = written;
+    snapshot_send(m_pipe, snapshot_message('p', written));
+  }
+
+  bool persistent_snapshot_body::collect(bool block)
+  {
+    snapshot_blocking(m_pipe, block);
+    // read until the pipe is empty or, once the child has exited, closed
+    bool closed = false;
+    for (;;)
+    {
+      char buffer[4096];
+      ssize_t got = read(m_pipe, buffer, sizeof(buffer));
+      if (got > 0)
+        m_messages.append(buffer, (size_t)got);
+      else if (got == 0)
+      {
+        closed = true;
+        break;
+      }
+      else if (errno != EINTR)
+        break;
+    }
+    size_t next = 0;
+    while (m_messages.size() - next >= 1 + sizeof(size_t))
+    {
+      size_t value = 0;
+      memcpy(&value, m_messages.data() + next + 1, sizeof(size_t));
+      if (m_messages[next] == 'p')
+        m_written = value;
+      else
+      {
+        if (m_messages.size() - next - 1 - sizeof(size_t) < value)
+          break;
+        m_error.assign(m_messages, next + 1 + sizeof(size_t), value);
+        next += value;
+      }
+      next += 1 + sizeof(size_t);
+    }
+    m_messages.erase(0, next);
+    if (!closed)
+      return false;
+    close(m_pipe);
+    m_pipe = -1;
+    int status = 0;
+    while (waitpid(m_pid, &status, 0) == -1 && errno == EINTR) {}
+    m_pid = -1;
+    m_succeeded = m_error.empty() && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    if (!m_succeeded && m_error.empty())
+      m_error = "snapshot process failed";
+    return true;
+  }
+
+  bool persistent_snapshot::start_job(persistent_snapshot_job* job, const std::string& filename,
+                                      dump_context::installer installer, unsigned compression)
+  {
+    persistent_snapshot_body& body = *m_body;
+    body.m_filename = filename;
+    body.m_installer = installer;
+    body.m_compression = compression;
+    body.m_bytes = 0;
+    body.m_written = 0;
+    body.m_succeeded = false;
+    body.m_error.erase();
+    body.m_messages.erase();
+    int pipes[2] = {-1, -1};
+    if (pipe(pipes) != 0)
+    {
+      delete job;
+      body.m_error = "cannot create pipe";
+      return false;
+    }
+    body.m_pid = fork();
+    if (body.m_pid == 0)
+    {
+      // in the child, which dumps its copy of the data and must not return
+      close(pipes[0]);
+      body.m_job = job;
+      body.m_pipe = pipes[1];
+      snapshot_blocking(body.m_pipe, false);
+      std::string error;
+      bool succeeded = snapshot_dump(body, error);
+      // the final count and any error must get through, so wait for room in the pipe
+      snapshot_blocking(body.m_pipe, true);
+      snapshot_send(body.m_pipe, snapshot_message('p', body.m_written));
+      if (!succeeded)
+        snapshot_send(body.m_pipe, snapshot_message('e', error.size()) + error);
+      // leave without running destructors or flushing the caller's buffered output
+      _exit(succeeded ? 0 : 1);
+    }
+    // the child has its own copy of the job
+    delete job;
+    close(pipes[1]);
+    if (body.m_pid == -1)
+    {
+      close(pipes[0]);
+      body.m_error = "cannot fork snapshot process";
+      return false;
+    }
+    body.m_pipe = pipes[0];
+    fcntl(body.m_pipe, F_SETFD, FD_CLOEXEC);
+    body.m_running = true;
+    return true;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // elsewhere - dump a copy of the data in a background thread
+
+#elif defined(STLPLUS_HAS_CXX11)
+
+  void persistent_snapshot_body::report(size_t written)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_thread_written = written;
+  }
+
+  bool persistent_snapshot_body::collect(bool block)
+  {
+    if (block)
+      m_thread.join();
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_written = m_thread_written;
+    if (!m_thread_done)
+      return false;
+    m_succeeded = m_thread_succeeded;
+    m_error = m_thread_error;
+    lock.unlock();
+    if (!block)
+      m_thread.join();
+    delete m_job;
+    m_job = 0;
+    return true;
+  }
+
+  static void snapshot_thread(persistent_snapshot_body* body)
+  {
+    std::string error;
+    bool succeeded = snapshot_dump(*body, error);
+    std::lock_guard<std::mutex> lock(body->m_mutex);
+    body->m_thread_succeeded = succeeded;
+    body->m_thread_error = error;
+    body->m_thread_done = true;
+  }
+
+  bool persistent_snapshot::start_job(persistent_snapshot_job* job, const std::string& filename,
+                                      dump_context::installer installer, unsigned compression)
+  {
+    persistent_snapshot_body& body = *m_body;
+    body.m_job = job;
+    body.m_filename = filename;
+    body.m_installer = installer;
+    body.m_compression = compression;
+    body.m_bytes = 0;
+    body.m_written = 0;
+    body.m_succeeded = false;
+    body.m_error.erase();
+    body.m_thread_done = false;
+    body.m_thread_written = 0;
+    body.m_thread_succeeded = false;
+    body.m_thread_error.erase();
+    body.m_thread = std::thread(snapshot_thread, &body);
+    body.m_running = true;
+    return true;
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // otherwise - dump a copy of the data in start() and report it when polled
+
+#else
+
+  void persistent_snapshot_body::report(size_t written)
+  {
+    m_written = written;
+  }
+
+  bool persistent_snapshot_body::collect(bool)
+  {
+    return true;
+  }
+
+  bool persistent_snapshot::start_job(persistent_snapshot_job* job, const std::string& filename,
+                                      dump_context::installer installer, unsigned compression)
+  {
+    persistent_snapshot_body& body = *m_body;
+    body.m_job = job;
+    body.m_filename = filename;
+    body.m_installer = installer;
+    body.m_compression = compression;
+    body.m_bytes = 0;
+    body.m_written = 0;
+    body.m_error.erase();
+    body.m_succeeded = snapshot_dump(body, body.m_error);
+    delete job;
+    body.m_job = 0;
+    body.m_running = true;
+    return true;
+  }
+
+#endif
+
+  ////////////////////////////////////////////////////////////////////////////////
+
+  persistent_snapshot::persistent_snapshot(void) : m_body(new persistent_snapshot_body)
+  {
+  }
+
+  persistent_snapshot::~persistent_snapshot(void)
+  {
+    // the subclass has already been destroyed, so its callbacks cannot be called
+    poll(true, false);
+    delete m_body;
+  }
+
+  bool persistent_snapshot::tick(void)
+  {
+    return poll(false, true);
+  }
+
+  bool persistent_snapshot::wait(void)
+  {
+    poll(true, true);
+    return m_body->m_succeeded;
+  }
+
+  bool persistent_snapshot::poll(bool block, bool callbacks)
+  {
+    if (!m_body->m_running)
+      return false;
+    bool done = m_body->collect(block);
+    if (m_body->m_written != m_body->m_bytes)
+    {
+      m_body->m_bytes = m_body->m_written;
+      if (callbacks)
+        progress(m_body->m_bytes);
+    }
+    if (!done)
+      return true;
+    m_body->m_running = false;
+    if (callbacks)
+      finished(m_body->m_succeeded);
+    return false;
+  }
+
+  bool persistent_snapshot::running(void) const
+  {
+    return m_body->m_running;
+  }
+
+  size_t persistent_snapshot::bytes(void) const
+  {
+    return m_body->m_bytes;
+  }
+
+  bool persistent_snapshot::succeeded(void) const
+  {
+    return m_body->m_succeeded;
+  }
+
+  const std::string& persistent_snapshot::error(void) const
+  {
+    return m_body->m_error;
+  }
+
+  void persistent_snapshot::progress(size_t)
+  {
+  }
+
+  void persistent_snapshot::finished(bool)
+  {
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+
+} // end namespace stlplus
@@ -0,0 +1,113 @@
+#ifndef STLPLUS_PERSISTENT_SNAPSHOT
+#define STLPLUS_PERSISTENT_SNAPSHOT
+////////////////////////////////////////////////////////////////////////////////
+
+//   Author:    Andy Rushton
+//   Copyright: (c) Southampton University 1999-2004
+//              (c) Andy Rushton           2004 onwards
+//   License:   BSD License, see ../docs/license.html
+
+//   Background snapshots of live data to a file
+
+//   A snapshot dumps a data structure to a file while the program carries on
+//   using and changing it. On Unix the program forks and the child process
+//   dumps its copy-on-write view of the data, so the caller only pauses for
+//   the fork itself. Elsewhere the data is copied and the copy is dumped by a
+//   background thread, so the pause is the time taken to copy the data, and
+//   without C++11 threads the dump is done in start().
+
+//   The dump is written to the filename with ".tmp" appended and renamed over
+//   the filename when it is complete, so the file always holds the last
+//   complete snapshot.
+
+//   The caller polls the snapshot with tick(), or waits for it with wait(),
+//   and these call progress() as the dump is written and finished() when it
+//   is done. Subclass persistent_snapshot and override them to be told.
+
+//   The forked child must only dump the data. It should not rely on locks or
+//   other threads, because only the thread that called start() is copied
+//   into the child.
+
+////////////////////////////////////////////////////////////////////////////////
+#include "persistence_fixes.hpp"
+#include "persistent_contexts.hpp"
+#include <string>
+#include <stddef.h>
+
+#ifndef _WIN32
+#define STLPLUS_SNAPSHOT_FORK
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace stlplus
+{
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // Internals
+
+  class persistent_snapshot_body;
+
+  // the part of a snapshot that knows the type of the data
+  class persistent_snapshot_job
+  {
+  public:
+    virtual ~persistent_snapshot_job(void) {}
+    virtual void dump(dump_context& context) = 0;
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+
+  class persistent_snapshot
+  {
+  public:
+    persistent_snapshot(void);
+    // waits for a snapshot that is still running, but without calling progress() or finished()
+    virtual ~persistent_snapshot(void);
+
+    // start a snapshot of the data in the background
+    // returns false if a snapshot is already running or could not be started
+    template<typename T, class D>
+    bool start(const T& data, const std::string& filename, D dump_fn, dump_context::installer installer,
+               unsigned compression = 0);
+
+    // collect progress without blocking, calling progress() and finished() as required
+    // returns true while the snapshot is still running
+    bool tick(void);
+
+    // block until the snapshot is done, calling progress() and finished() as required
+    // returns true if the snapshot succeeded
+    bool wait(void);
+
+    // state of the current or last snapshot
+    bool running(void) const;
+    size_t bytes(void) const;
+    bool succeeded(void) const;
+    const std::string& error(void) const;
+
+    // callbacks - the defaults do nothing
+    // progress is called with the number of bytes written so far
+    virtual void progress(size_t bytes);
+    // finished is called once when the snapshot has been written or has failed
+    virtual void finished(bool succeeded);
+
+  private:
+    friend class persistent_snapshot_body;
+    persistent_snapshot_body* m_body;
+
+    bool start_job(persistent_snapshot_job* job, const std::string& filename,
+                   dump_context::installer installer, unsigned compression);
+    bool poll(bool block, bool callbacks);
+
+    // make this class uncopyable
+    persistent_snapshot(const persistent_snapshot&);
+    persistent_snapshot& operator = (const persistent_snapshot&);
+  };
+
+  ////////////////////////////////////////////////////////////////////////////////
+
+} // end namespace stlplus
+
+  ////////////////////////////////////////////////////////////////////////////////
+#include "persistent_snapshot.tpp"
+#endif
@@ -0,0 +1,48 @@
+////////////////////////////////////////////////////////////////////////////////
+
+//   Author:    Andy Rushton
+//   Copyright: (c) Southampton University 1999-2004
+//              (c) Andy Rushton           2004 onwards
+//   License:   BSD License, see ../docs/license.html
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace stlplus
+{
+
+  ////////////////////////////////////////////////////////////////////////////////
+
+  template<typename T, class D>
+  class persistent_snapshot_data : public persistent_snapshot_job
+  {
+  public:
+    persistent_snapshot_data(const T& data, D dump_fn) : m_data(data), m_dump_fn(dump_fn) {}
+
+    void dump(dump_context& context)
+      {
+        m_dump_fn(context, m_data);
+      }
+
+  private:
+#ifdef STLPLUS_SNAPSHOT_FORK
+    // the forked child has its own copy-on-write view of the data
+    const T& m_data;
+#else
+    // the background thread dumps a copy so that the caller can carry on changing the data
+    T m_data;
+#endif
+    D m_dump_fn;
+  };
+
+  template<typename T, class D>
+  bool persistent_snapshot::start(const T& data, const std::string& filename, D dump_fn,
+                                  dump_context::installer installer, unsigned compression)
+  {
+    if (running())
+      return false;
+    return start_job(new persistent_snapshot_data<T,D>(data, dump_fn), filename, installer, compression);
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+
+} // end namespace stlplus
@@ -0,0 +1,34 @@
+#ifndef STLPLUS_PERSISTENT_SPARSE_MATRIX
+#define STLPLUS_PERSISTENT_SPARSE_MATRIX
+////////////////////////////////////////////////////////////////////////////////
+
+//   Author:    Andy Rushton
+//   Copyright: (c) Southampton University 1999-2004
+//              (c) Andy Rushton           2004 onwards
+//   License:   BSD License, see ../docs/license.html
+
+//   Persistence of STLplus sparse_matrix
+
+////////////////////////////////////////////////////////////////////////////////
+#include "persistence_fixes.hpp"
+#include "persistent_contexts.hpp"
+#include "sparse_matrix.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace stlplus
+{
+
+  // exceptions: persistent_dump_failed
+  template<typename T, typename DT>
+  void dump_sparse_matrix(dump_context&, const sparse_matrix<T>& data, DT dump_fn);
+
+  // exceptions: persistent_restore_failed
+  template<typename T, typename RT>
+  void restore_sparse_matrix(restore_context&, sparse_matrix<T>& data, RT restore_fn);
+
+} // end namespace stlplus
+
+  ////////////////////////////////////////////////////////////////////////////////
+#include "persistent_sparse_matrix.tpp"
+#endif
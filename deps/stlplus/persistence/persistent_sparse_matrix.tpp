@@ -0,0 +1,92 @@
+////////////////////////////////////////////////////////////////////////////////
+
+//   Author:    Andy Rushton
+//   Copyright: (c) Southampton University 1999-2004
+//              (c) Andy Rushton           2004 onwards
+//   License:   BSD License, see ../docs/license.html
+
+////////////////////////////////////////////////////////////////////////////////
+#include "persistent_int.hpp"
+#include <stdexcept>
+
+namespace stlplus
+{
+
+  ////////////////////////////////////////////////////////////////////////////////
+  // the compressed sparse row arrays are dumped as they are, so the stored
+  // elements only are dumped and restoring does not need to sort them again
+
+  template<typename T, typename DT>
+  void dump_sparse_matrix(dump_context& context, const sparse_matrix<T>& data,
+                          DT dump_fn)
+  {
+    unsigned rows = data.rows();
+    unsigned cols = data.columns();
+    unsigned nonzeros = data.nonzeros();
+    dump_unsigned(context, rows);
+    dump_unsigned(context, cols);
+    dump_unsigned(context, nonzeros);
+    for (unsigned r = 1; r <= rows; r++)
+      dump_unsigned(context, data.row_starts()[r]);
+    for (unsigned i = 0; i < nonzeros; i++)
+    {
+      dump_unsigned(context, data.column_indices()[i]);
+      dump_fn(context, data.values()[i]);
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+
+  template<typename T, typename RT>
+  void restore_sparse_matrix(restore_context& context, sparse_matrix<T>& data,
+                             RT restore_fn)
+  {
+    unsigned rows = 0;
+    restore_unsigned(context, rows);
+    unsigned cols = 0;
+    restore_unsigned(context, cols);
+    unsigned nonzeros = 0;
+    restore_unsigned(context, nonzeros);
+    // the sizes come from the input, so check them before they are used and grow
+    // the arrays as the elements arrive, so that a corrupt dump runs out of input
+    // rather than allocating arrays that it cannot fill
+    if (rows == ~0u)
+      throw persistent_restore_failed(std::string("sparse_matrix: too many rows"));
+    if (rows == 0 || cols == 0 ? nonzeros != 0 :
+        nonzeros / cols > rows || (nonzeros / cols == rows && nonzeros % cols != 0))
+      throw persistent_restore_failed(std::string("sparse_matrix: too many elements"));
+    std::vector<unsigned> starts;
+    starts.push_back(0);
+    for (unsigned r = 1; r <= rows; r++)
+    {
+      unsigned start = 0;
+      restore_unsigned(context, start);
+      if (start < starts.back() || start > nonzeros)
+        throw persistent_restore_failed(std::string("sparse_matrix: row starts are not in order"));
+      starts.push_back(start);
+    }
+    if (starts.back() != nonzeros)
+      throw persistent_restore_failed(std::string("sparse_matrix: row starts are inconsistent"));
+    std::vector<unsigned> columns;
+    std::vector<T> values;
+    for (unsigned i = 0; i < nonzeros; i++)
+    {
+      unsigned column = 0;
+      restore_unsigned(context, column);
+      columns.push_back(column);
+      values.push_back(T());
+      restore_fn(context, values.back());
+    }
+    try
+    {
+      data.adopt(rows, cols, starts, columns, values);
+    }
+    catch(const std::invalid_argument& exception)
+    {
+      throw persistent_restore_failed(exception.what());
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////////////////////
+
+} // end namespace stlplus
@@ -17,6 +17,7 @@
 #include "persistent_foursome.hpp"
 #include "persistent_hash.hpp"
 #include "persistent_matrix.hpp"
+#include "persistent_sparse_matrix.hpp"
 #include "persistent_ntree.hpp"
 #include "persistent_smart_ptr.hpp"
 #include "persistent_triple.hpp"
@@ -9,17 +9,33 @@
 #include "persistent_string.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
+// the format is the same as dump_basic_string with dump_char, but the
+// characters are transferred as one block
 
 void stlplus::dump_string(stlplus::dump_context& context, const std::string& data)
 
 {
-  stlplus::dump_basic_string(context, data, stlplus::dump_char);
+  size_t size = data.size();
+  stlplus::dump_size_t(context, size);
+  context.put_bytes(data.data(), size);
 }
 
 void stlplus::restore_string(stlplus::restore_context& context, std::string& data)
 
 {
-  stlplus::restore_basic_string(context, data, stlplus::restore_char);
+  data.erase();
+  size_t size = 0;
+  stlplus::restore_size_t(context, size);
+  // grow the string a block at a time so that a corrupt size runs out of input
+  // rather than trying to allocate the whole thing up front
+  while (size > 0)
+  {
+    size_t block = size < 65536 ? size : 65536;
+    size_t start = data.size();
+    data.resize(start + block);
+    context.get_bytes(&data[start], block);
+    size -= block;
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -21,6 +21,14 @@ namespace stlplus
 
   // vector
 
+  // From format version 3, a vector of a basic arithmetic type that is dumped
+  // with the standard function for its element type (e.g. dump_double) is
+  // written as one raw block in the machine's own layout, with a layout byte
+  // saying how big the elements are and which way round their bytes go. The
+  // restore reads the block straight into the vector when the layout
+  // matches and converts element by element when it does not. Other element
+  // functions, and dumps in earlier versions, use one call per element.
+
   // exceptions: persistent_dump_failed
   template<typename T, typename D>
   void dump_vector(dump_context&, const std::vector<T>& data, D dump_fn);
@@ -8,16 +8,127 @@
 
 ////////////////////////////////////////////////////////////////////////////////
 #include "persistent_int.hpp"
+#include "persistent_float.hpp"
 
 namespace stlplus
 {
 
+  ////////////////////////////////////////////////////////////////////////////////
+  // raw block transfer of basic types
+  // format: size layout { data }
+  // layout is 0 if the elements are dumped one at a time, otherwise the
+  // element size in bits 0-6 and a 1 in bit 7 if the data is big-endian
+
+  enum persistent_raw_kind {persistent_raw_none, persistent_raw_unsigned, persistent_raw_signed, persistent_raw_float};
+
+  template<typename T>
+  struct persistent_raw
+  {
+    enum {kind = persistent_raw_none};
+    template<typename F> static bool standard(F) {return false;}
+  };
+
+  // the standard functions are recognised by comparing them with the function
+  // passed in - anything else, including functors, disables the raw format
+#define STLPLUS_PERSISTENT_RAW(type, raw_kind, dump_fn, restore_fn)     \
+  template<>                                                            \
+  struct persistent_raw<type>                                           \
+  {                                                                     \
+    enum {kind = raw_kind};                                             \
+    static bool standard(void (*fn)(dump_context&, const type&))        \
+      {return fn == dump_fn;}                                           \
+    static bool standard(void (*fn)(restore_context&, type&))           \
+      {return fn == restore_fn;}                                        \
+    template<typename F> static bool standard(F) {return false;}        \
+  }
+
+  // char is dumped as unsigned char, and a single byte never needs extending anyway
+  STLPLUS_PERSISTENT_RAW(char, persistent_raw_unsigned, dump_char, restore_char);
+  STLPLUS_PERSISTENT_RAW(signed char, persistent_raw_signed, dump_signed_char, restore_signed_char);
+  STLPLUS_PERSISTENT_RAW(unsigned char, persistent_raw_unsigned, dump_unsigned_char, restore_unsigned_char);
+  STLPLUS_PERSISTENT_RAW(short, persistent_raw_signed, dump_short, restore_short);
+  STLPLUS_PERSISTENT_RAW(unsigned short, persistent_raw_unsigned, dump_unsigned_short, restore_unsigned_short);
+  STLPLUS_PERSISTENT_RAW(int, persistent_raw_signed, dump_int, restore_int);
+  STLPLUS_PERSISTENT_RAW(unsigned, persistent_raw_unsigned, dump_unsigned, restore_unsigned);
+  STLPLUS_PERSISTENT_RAW(long, persistent_raw_signed, dump_long, restore_long);
+  STLPLUS_PERSISTENT_RAW(unsigned long, persistent_raw_unsigned, dump_unsigned_long, restore_unsigned_long);
+  STLPLUS_PERSISTENT_RAW(float, persistent_raw_float, dump_float, restore_float);
+  STLPLUS_PERSISTENT_RAW(double, persistent_raw_float, dump_double, restore_double);
+
+#undef STLPLUS_PERSISTENT_RAW
+
+  // convert one element that was dumped with a different size or byte order
+  template<typename T>
+  static void persistent_raw_convert(const unsigned char* raw, unsigned raw_bytes, bool raw_big_endian,
+                                     bool little_endian, T& data)
+  {
+    const unsigned bytes = sizeof(T);
+    if ((int)persistent_raw<T>::kind == (int)persistent_raw_float && raw_bytes != bytes)
+      throw persistent_restore_failed(std::string("size mismatch"));
+    // collect the bytes least significant first
+    unsigned char value[sizeof(T)];
+    unsigned common = raw_bytes < bytes ? raw_bytes : bytes;
+    for (unsigned i = 0; i < common; i++)
+      value[i] = raw[raw_big_endian ? raw_bytes - i - 1 : i];
+    // extend to the size of T, or check that the bytes that do not fit are only extension
+    unsigned char fill = ((int)persistent_raw<T>::kind == (int)persistent_raw_signed && common > 0 && value[common-1] >= 128) ? 0xff : 0;
+    for (unsigned i = common; i < bytes; i++)
+      value[i] = fill;
+    for (unsigned i = common; i < raw_bytes; i++)
+      if (raw[raw_big_endian ? raw_bytes - i - 1 : i] != fill)
+        throw persistent_restore_failed(std::string("integer overflow"));
+    unsigned char* result = (unsigned char*)&data;
+    for (unsigned i = 0; i < bytes; i++)
+      result[little_endian ? i : bytes - i - 1] = value[i];
+  }
+
+  // the widest element that can be converted - enough for a 128-bit integer
+  enum {persistent_raw_max_bytes = 16};
+
+  template<typename T>
+  static void restore_vector_raw(restore_context& context, std::vector<T>& data, size_t size, unsigned layout)
+  {
+    unsigned raw_bytes = layout & 0x7f;
+    bool raw_big_endian = (layout & 0x80) != 0;
+    // check the element size before sizing the vector, since an empty element would
+    // let a corrupt size allocate without reading any input
+    if (raw_bytes == 0 || raw_bytes > persistent_raw_max_bytes)
+      throw persistent_restore_failed(std::string("bad element size"));
+    data.resize(size);
+    if (raw_bytes == sizeof(T) && raw_big_endian != context.little_endian())
+    {
+      // same layout so read straight into the vector
+      if (size != 0)
+        context.get_bytes(&data[0], size * sizeof(T));
+    }
+    else
+    {
+      unsigned char raw[persistent_raw_max_bytes];
+      for (size_t i = 0; i < size; i++)
+      {
+        context.get_bytes(raw, raw_bytes);
+        persistent_raw_convert(raw, raw_bytes, raw_big_endian, context.little_endian(), data[i]);
+      }
+    }
+  }
+
   ////////////////////////////////////////////////////////////////////////////////
 
   template<typename T, typename D>
   void dump_vector(dump_context& context, const std::vector<T>& data, D dump_fn)
   {
     dump_size_t(context,data.size());
+    if ((int)persistent_raw<T>::kind != (int)persistent_raw_none && context.version() >= 3)
+    {
+      if (persistent_raw<T>::standard(dump_fn))
+      {
+        context.put((unsigned char)(sizeof(T) | (context.little_endian() ? 0 : 0x80)));
+        if (!data.empty())
+          context.put_bytes(&data[0], data.size() * sizeof(T));
+        return;
+      }
+      context.put(0);
+    }
     for (size_t i = 0; i < data.size(); i++)
       dump_fn(context,data[i]);
   }
@@ -27,6 +138,17 @@ namespace stlplus
   {
     size_t size = 0;
     restore_size_t(context,size);
+    if ((int)persistent_raw<T>::kind != (int)persistent_raw_none && context.version() >= 3)
+    {
+      // a raw block was dumped by the standard function for T, so restoring it
+      // does not need restore_fn
+      unsigned layout = (unsigned)context.get();
+      if (layout != 0)
+      {
+        restore_vector_raw(context, data, size, layout);
+        return;
+      }
+    }
     data.resize(size);
     for (size_t i = 0; i < size; i++)
       restore_fn(context,data[i]);
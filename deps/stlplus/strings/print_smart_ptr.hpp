@@ -44,6 +44,13 @@ namespace stlplus
                               const std::string& prefix = "(",
                               const std::string& suffix = ")");
 
+  template<typename T, typename S>
+  void print_smart_ptr_intrusive(std::ostream& device,
+                                 const smart_ptr_intrusive<T>& value,
+                                 S print_fn,
+                                 const std::string& null_string = "<null>",
+                                 const std::string& prefix = "(",
+                                 const std::string& suffix = ")");
 
 } // end namespace stlplus
 
@@ -70,4 +70,24 @@ namespace stlplus
     }
   }
 
+  template<typename T, typename S>
+  void print_smart_ptr_intrusive(std::ostream& device,
+                                 const smart_ptr_intrusive<T>& value,
+                                 S print_fn,
+                                 const std::string& null_string,
+                                 const std::string& prefix,
+                                 const std::string& suffix)
+  {
+    if (value)
+    {
+      device << prefix;
+      print_fn(device, *value);
+      device << suffix;
+    }
+    else
+    {
+      device << null_string;
+    }
+  }
+
 } // end namespace stlplus
@@ -0,0 +1,37 @@
+#ifndef STLPLUS_PRINT_SPARSE_MATRIX
+#define STLPLUS_PRINT_SPARSE_MATRIX
+////////////////////////////////////////////////////////////////////////////////
+
+//   Author:    Andy Rushton
+//   Copyright: (c) Southampton University 1999-2004
+//              (c) Andy Rushton           2004 onwards
+//   License:   BSD License, see ../docs/license.html
+
+//   Generate a string representation of a sparse matrix
+
+//   Only the stored elements are printed, in row-major order, each in the
+//   form row<index_separator>column<value_separator>value
+
+////////////////////////////////////////////////////////////////////////////////
+#include "strings_fixes.hpp"
+#include "sparse_matrix.hpp"
+#include <string>
+#include <iostream>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace stlplus
+{
+
+  template<typename T, typename S>
+  void print_sparse_matrix(std::ostream& device,
+                           const sparse_matrix<T>& values,
+                           S print_fn,
+                           const std::string& index_separator = ",",
+                           const std::string& value_separator = "=",
+                           const std::string& entry_separator = "|");
+
+} // end namespace stlplus
+
+#include "print_sparse_matrix.tpp"
+#endif
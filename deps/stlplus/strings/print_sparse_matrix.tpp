@@ -0,0 +1,35 @@
+////////////////////////////////////////////////////////////////////////////////
+
+//   Author:    Andy Rushton
+//   Copyright: (c) Southampton University 1999-2004
+//              (c) Andy Rushton           2004 onwards
+//   License:   BSD License, see ../docs/license.html
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace stlplus
+{
+
+  ////////////////////////////////////////////////////////////////////////////////
+
+  template<typename T, typename S>
+  void print_sparse_matrix(std::ostream& device, const sparse_matrix<T>& values,
+                           S print_fn,
+                           const std::string& index_separator,
+                           const std::string& value_separator,
+                           const std::string& entry_separator)
+  {
+    bool first = true;
+    for (unsigned r = 0; r < values.rows(); r++)
+    {
+      for (unsigned i = values.row_starts()[r]; i < values.row_starts()[r+1]; i++)
+      {
+        if (!first) device << entry_separator;
+        first = false;
+        device << r << index_separator << values.column_indices()[i] << value_separator;
+        print_fn(device, values.values()[i]);
+      }
+    }
+  }
+
+} // end namespace stlplus
@@ -16,6 +16,7 @@
 #include "print_foursome.hpp"
 #include "print_hash.hpp"
 #include "print_matrix.hpp"
+#include "print_sparse_matrix.hpp"
 #include "print_ntree.hpp"
 #include "print_smart_ptr.hpp"
 #include "print_triple.hpp"
@@ -40,6 +40,12 @@ namespace stlplus
                                           const std::string& prefix = "(",
                                           const std::string& suffix = ")");
 
+  template<typename T, typename S>
+  std::string smart_ptr_intrusive_to_string(const smart_ptr_intrusive<T>& value,
+                                            S to_string_fn,
+                                            const std::string& null_string = "<null>",
+                                            const std::string& prefix = "(",
+                                            const std::string& suffix = ")");
 
 } // end namespace stlplus
 
@@ -40,4 +40,14 @@ namespace stlplus
     return value ? (prefix + to_string_fn(*value) + suffix) : null_string;
   }
 
+  template<typename T, typename S>
+  std::string smart_ptr_intrusive_to_string(const smart_ptr_intrusive<T>& value,
+                                            S to_string_fn,
+                                            const std::string& null_string,
+                                            const std::string& prefix,
+                                            const std::string& suffix)
+  {
+    return value ? (prefix + to_string_fn(*value) + suffix) : null_string;
+  }
+
 } // end namespace stlplus
@@ -8,7 +8,12 @@
 #include "string_int.hpp"
 #include "build.hpp"
 #include <vector>
+#include <map>
 #include <iostream>
+#include <algorithm>
+#ifdef STLPLUS_HAS_CXX11
+#include <atomic>
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -86,8 +91,113 @@ bool select_natural (const string_int_graph& graph, string_int_graph::const_arc_
   return *arc >= 0;
 }
 
-static void test (string_int_graph& graph)
+// weights are the magnitude of the arc data, since backward arcs are negative
+double weight_magnitude (const string_int_graph& graph, string_int_graph::const_arc_iterator arc)
 {
+  int value = *arc;
+  if (value < 0) value = -value;
+  return value;
+}
+
+// admissible A* estimate - every arc in the test graphs weighs at least 1
+double estimate_one (const string_int_graph& graph, string_int_graph::const_iterator node, string_int_graph::const_iterator target)
+{
+  return node == target ? 0.0 : 1.0;
+}
+
+double path_weight (const string_int_graph& graph, const string_int_graph::arc_vector& path)
+{
+  double result = 0.0;
+  for (unsigned i = 0; i < path.size(); i++)
+    result += weight_magnitude(graph, path[i].constify());
+  return result;
+}
+
+#ifdef STLPLUS_HAS_CXX11
+// nodes and arcs with a stricter alignment than operator new provides
+struct alignas(64) aligned_value
+{
+  unsigned m_value;
+  aligned_value(unsigned value = 0) : m_value(value) {}
+};
+typedef stlplus::digraph<aligned_value,aligned_value> aligned_graph;
+
+static bool test_alignment (void)
+{
+  aligned_graph graph;
+  std::vector<aligned_graph::iterator> nodes;
+  for (unsigned i = 0; i < 100; i++)
+    nodes.push_back(graph.insert(aligned_value(i)));
+  for (unsigned i = 1; i < nodes.size(); i++)
+    graph.arc_insert(nodes[i-1], nodes[i], aligned_value(i));
+  bool result = true;
+  for (aligned_graph::iterator n = graph.begin(); n != graph.end(); n++)
+    if (reinterpret_cast<size_t>(&*n) % alignof(aligned_value) != 0)
+      result = false;
+  for (aligned_graph::arc_iterator a = graph.arc_begin(); a != graph.arc_end(); a++)
+    if (reinterpret_cast<size_t>(&*a) % alignof(aligned_value) != 0)
+      result = false;
+  if (!result)
+    std::cout << "ERROR: over-aligned nodes or arcs are misaligned" << std::endl;
+  return result;
+}
+#endif
+
+// records the order in which parallel_execute runs the nodes
+// each node has a slot in the order vector, looked up in a map that is built
+// beforehand, so the workers only read the map and each writes its own slot
+#ifdef STLPLUS_HAS_CXX11
+typedef std::atomic<unsigned> execution_counter;
+#else
+typedef unsigned execution_counter;
+#endif
+typedef std::map<string_int_graph::iterator,unsigned> node_slots;
+typedef std::vector<unsigned> execution_order;
+
+class record_execution
+{
+public:
+  const node_slots* m_slots;
+  execution_order* m_order;
+  execution_counter* m_counter;
+
+  record_execution(const node_slots& slots, execution_order& order, execution_counter& counter) :
+    m_slots(&slots), m_order(&order), m_counter(&counter)
+    {
+    }
+
+  void operator() (string_int_graph& graph, string_int_graph::iterator node)
+    {
+      (*m_order)[m_slots->find(node)->second] = (*m_counter)++;
+    }
+};
+
+// run parallel_execute and check that every node was run once and after all of its selected fanin
+static bool test_execute (string_int_graph& graph, unsigned threads, string_int_graph::arc_select_fn select)
+{
+  node_slots slots;
+  for (string_int_graph::iterator n = graph.begin(); n != graph.end(); n++)
+  {
+    unsigned slot = (unsigned)slots.size();
+    slots[n] = slot;
+  }
+  execution_order order(slots.size(), string_int_graph::npos());
+  execution_counter counter(0);
+  graph.parallel_execute(record_execution(slots, order, counter), threads, select);
+  bool result = counter == graph.size();
+  for (string_int_graph::arc_iterator a = graph.arc_begin(); a != graph.arc_end(); a++)
+    if (!select || select(graph, a.constify()))
+      if (order[slots[graph.arc_from(a)]] >= order[slots[graph.arc_to(a)]])
+        result = false;
+  for (unsigned i = 0; i < order.size(); i++)
+    if (order[i] == string_int_graph::npos())
+      result = false;
+  return result;
+}
+
+static bool test (string_int_graph& graph)
+{
+  bool result = true;
   for (string_int_graph::iterator i = graph.begin(); i != graph.end(); i++)
   {
     for (string_int_graph::iterator j = graph.begin(); j != graph.end(); j++)
@@ -108,9 +218,51 @@ static void test (string_int_graph& graph)
         std::cout << "  " << *i << " has a path to " << *j << std::endl;
         std::cout << "  " << "paths from " << *i << " to " << *j << " are: " << graph.all_paths(i, j) << std::endl;
         std::cout << "  " << "shortest path from " << *i << " to " << *j << " is: " << graph.shortest_path(i, j) << std::endl;
+        // check the weighted algorithms against the lightest of all the paths
+        string_int_graph::path_vector paths = graph.all_paths(i, j);
+        // check the path enumerator against all_paths, with and without limits
+        unsigned enumerated = 0;
+        unsigned short_paths = 0;
+        for (unsigned p = 0; p < paths.size(); p++)
+          if (paths[p].size() <= 2)
+            short_paths++;
+        for (string_int_graph::path_enumerator e = graph.paths(i, j); e.next(); enumerated++)
+          if (enumerated >= paths.size() || graph.deconstify_arcs(e.path()) != paths[enumerated])
+            enumerated = paths.size()+1;
+        string_int_graph::path_enumerator first = graph.paths(i, j, 0, 0, 1);
+        string_int_graph::path_enumerator limited = graph.paths(i, j, 0, 2);
+        while (limited.next())
+          if (limited.path().size() > 2)
+            short_paths = paths.size()+1;
+        if (enumerated != paths.size() || !first.next() || first.next() || first.count() != 1 || limited.count() != short_paths)
+        {
+          std::cout << "  ERROR path enumeration from " << *i << " to " << *j << " does not match all_paths" << std::endl;
+          result = false;
+        }
+        double lightest = -1.0;
+        for (unsigned p = 0; p < paths.size(); p++)
+          if (lightest < 0.0 || path_weight(graph, paths[p]) < lightest)
+            lightest = path_weight(graph, paths[p]);
+        if (i != j)
+        {
+          string_int_graph::arc_vector dijkstra = graph.weighted_shortest_path(i, j, weight_magnitude);
+          string_int_graph::arc_vector astar = graph.astar_path(i, j, weight_magnitude, estimate_one);
+          std::cout << "  " << "weighted shortest path from " << *i << " to " << *j << " is: " << dijkstra << std::endl;
+          if (path_weight(graph, dijkstra) != lightest || path_weight(graph, astar) != lightest)
+          {
+            std::cout << "  ERROR weighted paths from " << *i << " to " << *j << " are not the lightest" << std::endl;
+            result = false;
+          }
+        }
       }
     }
     std::cout << "  " << "shortest paths for " << *i << " less than " << 4 << " are: " << graph.shortest_paths(i, select_less_than_4) << std::endl;
+    std::cout << "  " << "weighted shortest paths for " << *i << " are: " << graph.weighted_shortest_paths(i, weight_magnitude) << std::endl;
+    if (graph.weighted_shortest_paths(i, weight_magnitude).size() != graph.reachable_nodes(i).size())
+    {
+      std::cout << "  ERROR weighted shortest paths for " << *i << " do not match reachable nodes" << std::endl;
+      result = false;
+    }
     std::cout << "  " << "reachable nodes from " << *i << " are: " << graph.reachable_nodes(i) << std::endl;
     std::cout << "  " << "nodes which can reach " << *i << " are: " << graph.reaching_nodes(i) << std::endl;
   }
@@ -120,6 +272,63 @@ static void test (string_int_graph& graph)
     std::cout << ", errors = " << sort.second;
   std::cout << std::endl;
   std::cout << "  " << "DAG sort: " << graph.dag_sort(select_natural) << std::endl;
+  // check that every selected arc that was not broken goes forward in the sort
+  for (string_int_graph::arc_iterator a = graph.arc_begin(); a != graph.arc_end(); a++)
+  {
+    if (!select_natural(graph, a.constify())) continue;
+    if (std::find(sort.second.begin(), sort.second.end(), a) != sort.second.end()) continue;
+    if (std::find(sort.first.begin(), sort.first.end(), graph.arc_from(a)) >=
+        std::find(sort.first.begin(), sort.first.end(), graph.arc_to(a)))
+    {
+      std::cout << "  ERROR arc " << a << " goes backwards in the sort" << std::endl;
+      result = false;
+    }
+  }
+  // levels are antichains - every selected arc goes to a later level
+  string_int_graph::component_vector levels = graph.levels(select_natural);
+  std::cout << "  " << "levels:";
+  for (unsigned l = 0; l < levels.size(); l++)
+    std::cout << " [" << levels[l] << "]";
+  std::cout << std::endl;
+  std::map<string_int_graph::iterator,unsigned> level_of;
+  for (unsigned l = 0; l < levels.size(); l++)
+    for (unsigned n = 0; n < levels[l].size(); n++)
+      level_of[levels[l][n]] = l;
+  if (level_of.size() != graph.size())
+  {
+    std::cout << "  ERROR levels do not contain every node" << std::endl;
+    result = false;
+  }
+  for (string_int_graph::arc_iterator a = graph.arc_begin(); a != graph.arc_end(); a++)
+  {
+    if (!select_natural(graph, a.constify())) continue;
+    if (level_of[graph.arc_from(a)] >= level_of[graph.arc_to(a)])
+    {
+      std::cout << "  ERROR arc " << a << " does not go to a later level" << std::endl;
+      result = false;
+    }
+  }
+  if (!test_execute(graph, 2, select_natural))
+  {
+    std::cout << "  ERROR parallel execution out of order" << std::endl;
+    result = false;
+  }
+  // strongly connected components
+  string_int_graph::component_vector components = graph.strongly_connected_components();
+  std::cout << "  " << "strongly connected components:";
+  for (unsigned c = 0; c < components.size(); c++)
+    std::cout << " [" << components[c] << "]";
+  std::cout << std::endl;
+  string_int_graph::condensation condensed = graph.condense();
+  if (condensed.size() != components.size() || condensed.dag_sort().size() != condensed.size())
+  {
+    std::cout << "  ERROR condensation is not a DAG of the components" << std::endl;
+    result = false;
+  }
+  for (string_int_graph::condensation::arc_iterator a = condensed.arc_begin(); a != condensed.arc_end(); a++)
+    std::cout << "  " << "condensed arc from " << (*condensed.arc_from(a)).size() << " nodes to "
+              << (*condensed.arc_to(a)).size() << " nodes contains " << *a << std::endl;
+  return result;
 }
 
 void dump_string_int_graph(stlplus::dump_context& context, const string_int_graph& graph)
@@ -289,7 +498,78 @@ int main(int argc, char* argv[])
     result &= graph.report();
     // check the integrity of this graph and its iterators
     // this also tests other functions especially the sort and dag_sort functions
-    test(graph.m_graph);
+    result &= test(graph.m_graph);
+
+    // the graph has cycles unless the backward arcs are ignored
+    if (!graph.m_graph.levels().empty())
+    {
+      std::cout << "ERROR: levels of a graph with cycles" << std::endl;
+      result = false;
+    }
+    try
+    {
+      test_execute(graph.m_graph, 2, 0);
+      std::cout << "ERROR: parallel execution of a graph with cycles" << std::endl;
+      result = false;
+    }
+    catch(const std::invalid_argument&)
+    {
+    }
+
+    // a larger DAG to keep several threads busy
+    string_int_graph lattice;
+    std::vector<string_int_graph::iterator> lattice_nodes;
+    for (unsigned n = 0; n < 2000; n++)
+    {
+      lattice_nodes.push_back(lattice.insert(stlplus::unsigned_to_string(n)));
+      if (n >= 1) lattice.arc_insert(lattice_nodes[n-1], lattice_nodes[n], 1);
+      if (n >= 7 && n % 3 == 0) lattice.arc_insert(lattice_nodes[n-7], lattice_nodes[n], 7);
+      if (n >= 50 && n % 5 == 0) lattice.arc_insert(lattice_nodes[n/2], lattice_nodes[n], 2);
+    }
+    // with and without some of the arcs ignored
+    if (!test_execute(lattice, 4, select_less_than_4) || !test_execute(lattice, 0, 0) || !test_execute(lattice, 1, 0))
+    {
+      std::cout << "ERROR: parallel execution of the lattice out of order" << std::endl;
+      result = false;
+    }
+
+    // build the same graph in one go
+    std::vector<std::string> built_data;
+    for (unsigned n = 1; n <= 5; n++)
+      built_data.push_back("built" + stlplus::unsigned_to_string(n));
+    string_int_graph::edge_vector built_edges;
+    built_edges.push_back(stlplus::make_triple(0u, 1u, 1));
+    built_edges.push_back(stlplus::make_triple(1u, 3u, 2));
+    built_edges.push_back(stlplus::make_triple(3u, 2u, 3));
+    built_edges.push_back(stlplus::make_triple(0u, 2u, 4));
+    built_edges.push_back(stlplus::make_triple(2u, 4u, 5));
+    built_edges.push_back(stlplus::make_triple(4u, 3u, -6));
+    built_edges.push_back(stlplus::make_triple(3u, 3u, -7));
+    string_int_graph built;
+    string_int_graph::node_vector built_nodes = built.build(built_data, built_edges);
+    std::cout << "### built graph:" << std::endl << built;
+    if (built.size() != 5 || built.arc_size() != 7 || built.fanout(built_nodes[0]) != 2 || built.fanin(built_nodes[3]) != 3 ||
+        built.dag_sort(select_natural).size() != 5)
+    {
+      std::cout << "ERROR: built graph does not match the inserted graph" << std::endl;
+      result = false;
+    }
+    result &= test(built);
+    built_edges.push_back(stlplus::make_triple(0u, 5u, 8));
+    try
+    {
+      built.build(built_data, built_edges);
+      std::cout << "ERROR: built graph with an edge to a missing node" << std::endl;
+      result = false;
+    }
+    catch(const std::out_of_range&)
+    {
+      if (built.size() != 5 || built.arc_size() != 7)
+      {
+        std::cout << "ERROR: failed build changed the graph" << std::endl;
+        result = false;
+      }
+    }
 
     // test the persistence of this graph
     std::cout << "dumping to file" << std::endl;
@@ -300,7 +580,7 @@ int main(int argc, char* argv[])
     std::cout << "after restore from file:" << std::endl;
     result &= graph2.report();
     // check the integrity of the restored graph and its iterators
-    test(graph2.m_graph);
+    result &= test(graph2.m_graph);
 
     // merging graphs
     // create an empty graph to merge into
@@ -361,6 +641,20 @@ int main(int argc, char* argv[])
     target.arc_insert(source1_node2, source2_node1, 1221);
     // and print the result
     std::cout << "target after merge of source2:\n" << target;
+    // the weighted algorithms depend on the node indices still being consistent after the merge
+    if (target.weighted_shortest_path(source1_node1, source2_node2, weight_magnitude).size() != 3)
+    {
+      std::cout << "ERROR: no weighted path across the merged graphs" << std::endl;
+      result = false;
+    }
+    // and after erasing a node
+    target.erase(target.insert("erased node"));
+    target.erase(source1_node1);
+    if (target.size() != 3 || target.weighted_shortest_paths(source1_node2, weight_magnitude).size() != 2)
+    {
+      std::cout << "ERROR: weighted paths wrong after erase" << std::endl;
+      result = false;
+    }
 
     if (!source1.empty())
     {
@@ -373,6 +667,10 @@ int main(int argc, char* argv[])
       result = false;
     }
 
+#ifdef STLPLUS_HAS_CXX11
+    result &= test_alignment();
+#endif
+
     // clear the graph and check that safe iterators are handled correctly
     if (!source2_node1.valid())
     {
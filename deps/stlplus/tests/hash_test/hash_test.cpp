@@ -3,6 +3,7 @@
 #include "persistent_string.hpp"
 #include "persistent_int.hpp"
 #include "persistent_shortcuts.hpp"
+#include "persistent_snapshot.hpp"
 #include "string_int.hpp"
 #include "string_string.hpp"
 #include "string_pair.hpp"
@@ -17,6 +18,7 @@
 #define NUMBER 1000
 #define DATA "hash_test.tmp"
 #define MASTER "hash_test.dump"
+#define SNAPSHOT "hash_test.snapshot"
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -56,6 +58,17 @@ void restore_int_string_hash(stlplus::restore_context& context, int_string_hash&
   stlplus::restore_hash(context, data, stlplus::restore_int, stlplus::restore_string);
 }
 
+// the segments are dumped by four threads and restored by three
+void dump_int_string_hash_parallel(stlplus::dump_context& context, const int_string_hash& data)
+{
+  stlplus::dump_parallel(context, data, stlplus::dump_int, stlplus::dump_string, 4);
+}
+
+void restore_int_string_hash_parallel(stlplus::restore_context& context, int_string_hash& data)
+{
+  stlplus::restore_parallel(context, data, stlplus::restore_int, stlplus::restore_string, 3);
+}
+
 bool compare(const int_string_hash& left, const int_string_hash& right)
 {
   bool result = true;
@@ -80,6 +93,28 @@ bool compare(const int_string_hash& left, const int_string_hash& right)
   return result;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// a snapshot that records its callbacks
+
+class test_snapshot : public stlplus::persistent_snapshot
+{
+public:
+  size_t m_progress;
+  unsigned m_finished;
+
+  test_snapshot(void) : m_progress(0), m_finished(0) {}
+
+  void progress(size_t bytes)
+    {
+      m_progress = bytes;
+    }
+
+  void finished(bool)
+    {
+      m_finished++;
+    }
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 
 int main(int argc, char* argv[])
@@ -117,6 +152,45 @@ int main(int argc, char* argv[])
       result &= compare(data,master);
     }
 
+    // dump and restore in parallel segments
+    std::cerr << "restoring parallel" << std::endl;
+    std::string parallel;
+    stlplus::dump_to_string(data,parallel,dump_int_string_hash_parallel,0);
+    int_string_hash parallel_restored;
+    stlplus::restore_from_string(parallel,parallel_restored,restore_int_string_hash_parallel,0);
+    result &= compare(data,parallel_restored);
+
+    // snapshot in the background while the data is changed
+    std::cerr << "restoring snapshot" << std::endl;
+    int_string_hash original = data;
+    test_snapshot snapshot;
+    if (!snapshot.start(data,SNAPSHOT,dump_int_string_hash,0))
+    {
+      std::cerr << "error: snapshot did not start: " << snapshot.error() << std::endl;
+      result = false;
+    }
+    data[NUMBER] = "changed";
+    while (snapshot.tick()) {}
+    if (!snapshot.succeeded() || snapshot.m_finished != 1 ||
+        snapshot.m_progress != snapshot.bytes() || snapshot.bytes() != stlplus::file_size(SNAPSHOT))
+    {
+      std::cerr << "error: snapshot failed: " << snapshot.error() << std::endl;
+      result = false;
+    }
+    data.erase(NUMBER);
+    int_string_hash snapshot_restored;
+    stlplus::restore_from_file(SNAPSHOT,snapshot_restored,restore_int_string_hash,0);
+    result &= compare(original,snapshot_restored);
+
+    // a snapshot that cannot be written reports the failure
+    test_snapshot bad_snapshot;
+    bad_snapshot.start(data,"no_such_directory/" SNAPSHOT,dump_int_string_hash,0);
+    if (bad_snapshot.wait() || bad_snapshot.m_finished != 1 || bad_snapshot.error().empty())
+    {
+      std::cerr << "error: failed snapshot not reported" << std::endl;
+      result = false;
+    }
+
     // try erasing an element by iterator
     unsigned size = data.size();
     std::cerr << "erasing " << *data.begin() << std::endl;
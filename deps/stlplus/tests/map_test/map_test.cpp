@@ -2,6 +2,7 @@
 #include <map>
 #include "persistent_contexts.hpp"
 #include "persistent_map.hpp"
+#include "persistent_parallel.hpp"
 #include "persistent_string.hpp"
 #include "persistent_int.hpp"
 #include "persistent_shortcuts.hpp"
@@ -30,6 +31,17 @@ void restore_int_string_map(stlplus::restore_context& context, int_string_map& d
   stlplus::restore_map(context, data, stlplus::restore_int, stlplus::restore_string);
 }
 
+// the segments are dumped by four threads and restored by three
+void dump_int_string_map_parallel(stlplus::dump_context& context, const int_string_map& data)
+{
+  stlplus::dump_parallel(context, data, stlplus::dump_int, stlplus::dump_string, 4);
+}
+
+void restore_int_string_map_parallel(stlplus::restore_context& context, int_string_map& data)
+{
+  stlplus::restore_parallel(context, data, stlplus::restore_int, stlplus::restore_string, 3);
+}
+
 bool compare(const int_string_map& left, const int_string_map& right)
 {
   bool result = true;
@@ -96,6 +108,14 @@ int main(int argc, char* argv[])
       stlplus::restore_from_file(MASTER,master,restore_int_string_map,0);
       result &= compare(data,master);
     }
+
+    // dump and restore in parallel segments
+    std::cerr << "restoring parallel" << std::endl;
+    std::string parallel;
+    stlplus::dump_to_string(data,parallel,dump_int_string_map_parallel,0);
+    int_string_map parallel_restored;
+    stlplus::restore_from_string(parallel,parallel_restored,restore_int_string_map_parallel,0);
+    result &= compare(data,parallel_restored);
   }
   catch(std::exception& except)
   {
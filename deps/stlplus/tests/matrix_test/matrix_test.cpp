@@ -1,4 +1,5 @@
 #include <string>
+#include <cstdlib>
 #include "persistent_matrix.hpp"
 #include "persistent_string.hpp"
 #include "persistent_shortcuts.hpp"
@@ -65,6 +66,63 @@ bool compare(const string_matrix& left, const string_matrix& right)
   return result;
 }
 
+// transpose an int matrix of the given shape, which is done a tile at a time, and check every element
+
+bool check_transpose(unsigned rows, unsigned cols)
+{
+  stlplus::matrix<int> data(rows, cols);
+  for (unsigned r = 0; r < rows; r++)
+    for (unsigned c = 0; c < cols; c++)
+      data(r,c) = r * 1000 + c;
+  data.transpose();
+  bool result = data.rows() == cols && data.columns() == rows;
+  for (unsigned r = 0; result && r < cols; r++)
+    for (unsigned c = 0; c < rows; c++)
+      if (data(r,c) != (int)(c * 1000 + r))
+        result = false;
+  if (!result)
+    std::cerr << "ERROR: transpose of " << rows << "*" << cols << " int matrix failed" << std::endl;
+  return result;
+}
+
+// check the blocked matrix product against the textbook triple loop
+// the elements are small integers so the double arithmetic is exact
+
+typedef stlplus::matrix<double> double_matrix;
+
+double_matrix random_matrix(unsigned rows, unsigned cols)
+{
+  double_matrix result(rows, cols);
+  for (unsigned r = 0; r < rows; r++)
+    for (unsigned c = 0; c < cols; c++)
+      result(r,c) = (double)(rand() % 19) - 9.0;
+  return result;
+}
+
+bool check_multiply(unsigned m, unsigned n, unsigned p, unsigned threads)
+{
+  double_matrix left = random_matrix(m, n);
+  double_matrix right = random_matrix(n, p);
+  double_matrix expected(m, p);
+  for (unsigned i = 0; i < m; i++)
+    for (unsigned j = 0; j < p; j++)
+    {
+      double sum = 0.0;
+      for (unsigned k = 0; k < n; k++)
+        sum += left(i,k) * right(k,j);
+      expected(i,j) = sum;
+    }
+  double_matrix product = stlplus::multiply(left, right, threads);
+  bool result = product.rows() == m && product.columns() == p;
+  for (unsigned i = 0; result && i < m; i++)
+    for (unsigned j = 0; j < p; j++)
+      if (product(i,j) != expected(i,j))
+        result = false;
+  if (!result)
+    std::cerr << "ERROR: multiply of " << m << "*" << n << " by " << n << "*" << p << " with " << threads << " threads failed" << std::endl;
+  return result;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 int main(int argc, char* argv[])
@@ -101,6 +159,168 @@ int main(int argc, char* argv[])
       stlplus::restore_from_file(MASTER,master,restore_string_matrix,0);
       result &= compare(data,master);
     }
+
+    // the storage is contiguous and row-major
+    std::cerr << "checking storage" << std::endl;
+    if (data.stride() != C || data.row_span(1) != data.data() + C || data.data()[C+2] != data(1,2) ||
+        (reinterpret_cast<std::size_t>(data.data()) % string_matrix::alignment) != 0)
+    {
+      std::cerr << "ERROR: matrix storage is not contiguous and aligned" << std::endl;
+      result = false;
+    }
+
+    // resizing keeps the elements in the intersection of the old and new shapes
+    std::cerr << "resizing" << std::endl;
+    string_matrix resized = data;
+    resized.resize(R+2, C-5, "new");
+    resized.resize(R-1, C-5, "unused");
+    resized.resize(R-1, C+1, "new");
+    for (unsigned r = 0; r < resized.rows(); r++)
+      for (unsigned c = 0; c < resized.columns(); c++)
+        if (resized(r,c) != (c < C-5 ? data(r,c) : std::string("new")))
+        {
+          std::cerr << "ERROR: resized (" << r << "," << c << ") = \"" << resized(r,c) << "\"" << std::endl;
+          result = false;
+        }
+
+    // transposing twice gets back to the original
+    std::cerr << "transposing" << std::endl;
+    string_matrix transposed = data;
+    transposed.transpose();
+    if (transposed.rows() != C || transposed.columns() != R || transposed(3,7) != data(7,3))
+    {
+      std::cerr << "ERROR: transpose failed" << std::endl;
+      result = false;
+    }
+    transposed.transpose();
+    transposed = transposed;
+    result &= compare(data,transposed);
+    string_matrix square(C,C);
+    for (unsigned r = 0; r < C; r++)
+      for (unsigned c = 0; c < C; c++)
+        square(r,c) = stlplus::dformat("%d:%d",r,c);
+    square.transpose();
+    if (square(3,17) != "17:3" || square(17,3) != "3:17" || square(5,5) != "5:5")
+    {
+      std::cerr << "ERROR: square transpose failed" << std::endl;
+      result = false;
+    }
+    result &= check_transpose(70, 70);
+    result &= check_transpose(64, 64);
+    result &= check_transpose(45, 100);
+    result &= check_transpose(1, 33);
+
+    // fills of an arithmetic matrix
+    std::cerr << "filling" << std::endl;
+    stlplus::matrix<double> numbers(5, 7, 2.5);
+    numbers.fill_row(1, 0.0);
+    numbers.fill_column(2, -1.0);
+    numbers.fill_leading_diagonal(1.0);
+    numbers.fill_trailing_diagonal(3.0);
+    for (unsigned r = 0; r < 5; r++)
+      for (unsigned c = 0; c < 7; c++)
+      {
+        double expected = c == 6-r ? 3.0 : c == r ? 1.0 : c == 2 ? -1.0 : r == 1 ? 0.0 : 2.5;
+        if (numbers(r,c) != expected)
+        {
+          std::cerr << "ERROR: filled (" << r << "," << c << ") = " << numbers(r,c) << " should be " << expected << std::endl;
+          result = false;
+        }
+      }
+    numbers.make_identity(1.0);
+    if (numbers(4,4) != 1.0 || numbers(4,3) != 0.0 || numbers(0,6) != 0.0)
+    {
+      std::cerr << "ERROR: make_identity failed" << std::endl;
+      result = false;
+    }
+
+    // arithmetic
+    std::cerr << "arithmetic" << std::endl;
+    result &= check_multiply(1, 1, 1, 1);
+    result &= check_multiply(37, 53, 29, 1);
+    result &= check_multiply(64, 300, 48, 1);
+    result &= check_multiply(301, 263, 270, 4);
+    result &= check_multiply(130, 20, 517, 0);
+    double_matrix a = random_matrix(6, 9);
+    double_matrix b = random_matrix(6, 9);
+    double_matrix sum = a + b;
+    double_matrix difference = a - b;
+    double_matrix product = a * b;
+    double_matrix scaled = b;
+    stlplus::axpy(3.0, a, scaled);
+    std::vector<double> x(9), y(6, 1.0);
+    for (unsigned k = 0; k < 9; k++)
+      x[k] = k;
+    stlplus::gemv(2.0, a, x, 3.0, y);
+    for (unsigned r = 0; r < 6; r++)
+    {
+      double dot = 0.0;
+      for (unsigned c = 0; c < 9; c++)
+      {
+        dot += a(r,c) * x[c];
+        if (sum(r,c) != a(r,c) + b(r,c) || difference(r,c) != a(r,c) - b(r,c) ||
+            product(r,c) != a(r,c) * b(r,c) || scaled(r,c) != b(r,c) + 3.0 * a(r,c))
+        {
+          std::cerr << "ERROR: element-wise arithmetic failed at (" << r << "," << c << ")" << std::endl;
+          result = false;
+        }
+      }
+      if (y[r] != 2.0 * dot + 3.0)
+      {
+        std::cerr << "ERROR: gemv failed at row " << r << std::endl;
+        result = false;
+      }
+    }
+    // chained expressions are evaluated in one pass, including into one of their own operands
+    double_matrix c = random_matrix(6, 9);
+    double_matrix d = random_matrix(6, 9);
+    double_matrix chained = a*b + c - d;
+    double_matrix accumulated = c;
+    accumulated += a*b - d;
+    accumulated *= a + b;
+    double_matrix aliased = a;
+    aliased = aliased*b + aliased;
+    for (unsigned r = 0; r < 6; r++)
+      for (unsigned col = 0; col < 9; col++)
+      {
+        double expected = a(r,col)*b(r,col) + c(r,col) - d(r,col);
+        if (chained(r,col) != expected || accumulated(r,col) != expected * (a(r,col) + b(r,col)) ||
+            aliased(r,col) != a(r,col)*b(r,col) + a(r,col))
+        {
+          std::cerr << "ERROR: matrix expression failed at (" << r << "," << col << ")" << std::endl;
+          result = false;
+        }
+      }
+    try
+    {
+      double_matrix mismatched = a + b * random_matrix(9, 6);
+      std::cerr << "ERROR: expression of mismatched matrices did not throw" << std::endl;
+      result = false;
+    }
+    catch(std::invalid_argument&)
+    {
+    }
+
+    // the result may be one of the operands
+    double_matrix operand = random_matrix(20, 20);
+    double_matrix squared = stlplus::multiply(operand, operand);
+    stlplus::multiply(operand, operand, operand);
+    for (unsigned r = 0; r < 20; r++)
+      for (unsigned c = 0; c < 20; c++)
+        if (operand(r,c) != squared(r,c))
+        {
+          std::cerr << "ERROR: multiply into an operand failed at (" << r << "," << c << ")" << std::endl;
+          result = false;
+        }
+    try
+    {
+      stlplus::multiply(a, b);
+      std::cerr << "ERROR: multiply of mismatched matrices did not throw" << std::endl;
+      result = false;
+    }
+    catch(std::invalid_argument&)
+    {
+    }
   }
   catch(std::exception& except)
   {
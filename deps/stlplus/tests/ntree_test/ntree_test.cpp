@@ -7,6 +7,7 @@
 #include "print_vector.hpp"
 #include "print_map.hpp"
 #include "print_string.hpp"
+#include "string_int.hpp"
 #include "build.hpp"
 #include <string>
 #include <map>
@@ -219,6 +220,135 @@ bool compare(const mapped_tree& left, const mapped_tree& right)
   return compare(left.m_tree,right.m_tree);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// check the recorded subtree sizes and depths against a count of the tree
+
+unsigned check_sizes_r(const string_tree& tree, const string_tree::const_iterator& node, unsigned depth, bool& result)
+{
+  unsigned size = 1;
+  for (unsigned i = 0; i < tree.children(node); i++)
+  {
+    string_tree::const_iterator child = tree.child(node,i);
+    size += check_sizes_r(tree, child, depth+1, result);
+    // the recorded offsets must match the children array, as must the siblings
+    string_tree::const_iterator next = tree.next_sibling(child);
+    string_tree::const_iterator prev = tree.prev_sibling(child);
+    if (tree.child_offset(node, child) != i ||
+        (i+1 < tree.children(node) ? next != tree.child(node,i+1) : !next.end()) ||
+        (i > 0 ? prev != tree.child(node,i-1) : !prev.end()))
+    {
+      std::cerr << "ERROR: child " << i << " of node \"" << *node << "\" has offset " << tree.child_offset(node, child) << std::endl;
+      result = false;
+    }
+  }
+  if (tree.size(node) != size || tree.depth(node) != depth)
+  {
+    std::cerr << "ERROR: node \"" << *node << "\" has size " << tree.size(node) << " depth " << tree.depth(node)
+              << ", should be size " << size << " depth " << depth << std::endl;
+    result = false;
+  }
+  return size;
+}
+
+bool check_sizes(const string_tree& tree)
+{
+  bool result = true;
+  unsigned size = tree.empty() ? 0 : check_sizes_r(tree, tree.root(), 1, result);
+  if (tree.size() != size)
+  {
+    std::cerr << "ERROR: tree has size " << tree.size() << ", should be " << size << std::endl;
+    result = false;
+  }
+  return result;
+}
+
+// check a flat tree against the prefix traversal of the tree it was made from
+
+bool check_flat(const string_tree& tree)
+{
+  bool result = true;
+  stlplus::flat_ntree<std::string> flat = tree.compact();
+  if (flat.size() != tree.size())
+  {
+    std::cerr << "ERROR: flat tree has size " << flat.size() << ", should be " << tree.size() << std::endl;
+    return false;
+  }
+  std::map<std::string,unsigned> positions;
+  unsigned node = 0;
+  for (string_tree::const_prefix_iterator i = tree.prefix_begin(); i != tree.prefix_end(); i++, node++)
+  {
+    positions[*i] = node;
+    string_tree::const_iterator parent = tree.parent(i.simplify());
+    unsigned flat_parent = parent.end() ? stlplus::flat_ntree<std::string>::npos() : positions[*parent];
+    if (flat[node] != *i || flat.parent(node) != flat_parent || flat.size(node) != tree.size(i.simplify()) ||
+        flat.children(node) != tree.children(i.simplify()))
+    {
+      std::cerr << "ERROR: flat node " << node << " \"" << flat[node] << "\" does not match \"" << *i << "\"" << std::endl;
+      result = false;
+    }
+  }
+  return result;
+}
+
+// callbacks for the parallel traversals
+
+struct mark_node
+{
+  void operator()(string_tree& tree, const string_tree::iterator& node) const
+  {
+    *node += "!";
+  }
+};
+
+struct node_name
+{
+  std::string operator()(const string_tree& tree, const string_tree::const_iterator& node) const
+  {
+    return *node + " ";
+  }
+};
+
+struct concatenate
+{
+  std::string operator()(const std::string& left, const std::string& right) const
+  {
+    return left + right;
+  }
+};
+
+struct has_digit_seven
+{
+  bool operator()(const string_tree&, const string_tree::const_iterator& node) const
+  {
+    return node->find('7') != std::string::npos;
+  }
+};
+
+struct either_true
+{
+  bool operator()(bool left, bool right) const
+  {
+    return left || right;
+  }
+};
+
+bool check_parallel(string_tree& tree, unsigned threads, unsigned cutoff)
+{
+  bool result = true;
+  std::string expected;
+  for (string_tree::prefix_iterator i = tree.prefix_begin(); i != tree.prefix_end(); i++)
+    expected += *i + "! ";
+  tree.parallel_for_each(tree.root(), mark_node(), threads, cutoff);
+  std::string reduced = tree.parallel_reduce<std::string>(tree.root(), node_name(), concatenate(), threads, cutoff);
+  if (reduced != expected)
+  {
+    std::cerr << "ERROR: parallel traversal with " << threads << " threads and cutoff " << cutoff
+              << " gave \"" << reduced.substr(0,100) << "...\"" << std::endl;
+    result = false;
+  }
+  return result;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 int main(int argc, char* argv[])
@@ -257,6 +387,8 @@ int main(int argc, char* argv[])
 
     data.add_mappings();
     std::cerr << "tree = " << std::endl << data;
+    result &= check_sizes(data.m_tree);
+    result &= check_flat(data.m_tree);
 
     // get breadth-first traversal
     std::cerr << "breadth-first traversal = " << data.m_tree.breadth_first_traversal() << std::endl;
@@ -388,6 +520,91 @@ int main(int argc, char* argv[])
     string_tree branch = data.m_tree.cut(left);
     std::cerr << "cut left = " << std::endl << branch;
     std::cerr << "cut remainder = " << std::endl << data.m_tree;
+    result &= check_sizes(branch);
+    result &= check_sizes(data.m_tree);
+
+    // sizes and depths after the other modifications
+    string_tree sized;
+    string_tree::iterator sized_root = sized.insert("a");
+    string_tree::iterator sized_b = sized.insert(sized_root, "b");
+    sized.insert(sized_b, "c");
+    sized.insert(sized_root, 0, branch);
+    result &= check_sizes(sized);
+    string_tree::iterator sized_pushed = sized.push(sized_b, "pushed");
+    sized.push(sized_root, "new root");
+    result &= check_sizes(sized);
+    sized.pop(sized.parent(sized_pushed), sized.child_offset(sized.parent(sized_pushed), sized_pushed));
+    result &= check_sizes(sized);
+    string_tree grafted = branch;
+    sized.move(sized_b, grafted);
+    result &= check_sizes(sized);
+    string_tree sized_cut = sized.cut(sized_b);
+    result &= check_sizes(sized);
+    result &= check_sizes(sized_cut);
+    result &= check_flat(sized);
+    result &= check_flat(sized_cut);
+    sized.erase_child(sized.root(), 0);
+    result &= check_sizes(sized);
+    if (!sized.next_sibling(sized.root()).end() || !sized.prev_sibling(sized.root()).end())
+    {
+      std::cerr << "ERROR: root has a sibling" << std::endl;
+      result = false;
+    }
+    string_tree sized_copy = sized_cut.subtree(sized_cut.child(sized_cut.root(), 0));
+    result &= check_sizes(sized_copy);
+    if (sized_cut.size() != 5 || sized_copy.size() != 1)
+    {
+      std::cerr << "ERROR: wrong sizes after cut and subtree" << std::endl;
+      result = false;
+    }
+
+    // parallel traversals of a larger irregular tree, with a cutoff small enough to split it
+    string_tree big;
+    std::vector<string_tree::iterator> big_nodes;
+    big_nodes.push_back(big.insert("0"));
+    unsigned random = 1;
+    for (unsigned i = 1; i < 5000; i++)
+    {
+      random = random * 1664525 + 1013904223;
+      big_nodes.push_back(big.append(big_nodes[random % i], stlplus::unsigned_to_string(i)));
+    }
+    result &= check_parallel(big, 4, 16);
+    result &= check_parallel(big, 0, 1024);
+    result &= check_parallel(big, 1, 1);
+    // a wide tree whose leaves are grouped into tasks rather than each having one
+    string_tree wide;
+    string_tree::iterator wide_root = wide.insert("root");
+    for (unsigned i = 0; i < 5000; i++)
+      wide.append(wide_root, stlplus::unsigned_to_string(i));
+    result &= check_parallel(wide, 4, 64);
+    result &= check_parallel(wide, 2, 0);
+    big.reorder(big.root(), 0, big.children(big.root())-1);
+    big.swap(big.root(), 1, big.children(big.root())-2);
+    big.pop(big.root(), 2);
+    result &= check_sizes(big);
+    string_tree::iterator big_child = big.child(big.root(), 0);
+    std::string subtree_reduced = big.parallel_reduce<std::string>(big_child, node_name(), concatenate(), 2, 8);
+    std::string subtree_expected;
+    string_tree big_subtree = big.subtree(big_child);
+    for (string_tree::prefix_iterator i = big_subtree.prefix_begin(); i != big_subtree.prefix_end(); i++)
+      subtree_expected += *i + " ";
+    if (subtree_reduced != subtree_expected)
+    {
+      std::cerr << "ERROR: parallel reduce of a subtree was wrong" << std::endl;
+      result = false;
+    }
+    // each part's result is written by a different task, including when the result is a bool
+    if (!big.parallel_reduce<bool>(big.root(), has_digit_seven(), either_true(), 4, 16) ||
+        big.parallel_reduce<bool>(big_child, has_digit_seven(), either_true(), 4, 1) != (subtree_expected.find('7') != std::string::npos))
+    {
+      std::cerr << "ERROR: parallel reduce to a bool was wrong" << std::endl;
+      result = false;
+    }
+    if (string_tree().parallel_reduce<std::string>(string_tree().root(), node_name(), concatenate()) != std::string())
+    {
+      std::cerr << "ERROR: parallel reduce of an empty tree was not empty" << std::endl;
+      result = false;
+    }
 
   }
   catch(std::exception& except)
@@ -61,6 +61,17 @@ void restore_string_ptr_pair(stlplus::restore_context& context, string_ptr_pair&
   stlplus::restore_pair(context, data, restore_string_ptr, restore_string_ptr);
 }
 
+// a hand-made dump of an aliased pair using magic keys far from zero
+void dump_sparse_magic_pair(stlplus::dump_context& context, const std::string& data)
+{
+  unsigned magic = 0xfffffff0u;
+  stlplus::dump_unsigned(context, magic);
+  stlplus::dump_unsigned(context, magic+1);
+  stlplus::dump_string(context, data);
+  stlplus::dump_unsigned(context, magic);
+  stlplus::dump_unsigned(context, magic+1);
+}
+
 bool compare (string_ptr_pair& left, string_ptr_pair& right)
 {
   return ((*left.first) == (*right.first)) && ((*left.second) == (*right.second));
@@ -185,6 +196,18 @@ int main (int argc, char* argv[])
         errors++;
     }
 
+    // magic keys far from zero restore without sizing anything from them
+    std::string sparse_dump;
+    stlplus::dump_to_string(std::string("sparse"), sparse_dump, dump_sparse_magic_pair, 0);
+    string_ptr_pair p4;
+    stlplus::restore_from_string(sparse_dump, p4, restore_string_ptr_pair, 0);
+    print("p4 = restore(sparse magic keys)", p4);
+    if (!p4.first.aliases(p4.second) || *p4.first != "sparse")
+    {
+      std::cerr << "error: sparse magic keys restored wrongly" << std::endl;
+      errors++;
+    }
+
     if (errors == 0)
       std::cerr << "No errors were found - test SUCCEEDED" << std::endl;
     else
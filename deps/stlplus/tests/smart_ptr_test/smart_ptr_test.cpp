@@ -61,6 +61,57 @@ void restore_string_ptr_pair(stlplus::restore_context& context, string_ptr_pair&
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// an object that carries its own alias count for smart_ptr_intrusive
+
+class counted_string : public stlplus::smart_ptr_counted
+{
+public:
+  std::string m_value;
+
+  counted_string(const std::string& value = std::string()) : m_value(value) {}
+};
+
+typedef stlplus::smart_ptr_intrusive<counted_string> counted_ptr;
+
+std::string string_of_counted(const counted_string& data)
+{
+  return data.m_value;
+}
+
+void dump_counted_string(stlplus::dump_context& context, const counted_string& data)
+{
+  stlplus::dump_string(context, data.m_value);
+}
+
+void restore_counted_string(stlplus::restore_context& context, counted_string& data)
+{
+  stlplus::restore_string(context, data.m_value);
+}
+
+void dump_counted_ptr(stlplus::dump_context& context, const counted_ptr& data)
+{
+  stlplus::dump_smart_ptr_intrusive(context, data, dump_counted_string);
+}
+
+void restore_counted_ptr(stlplus::restore_context& context, counted_ptr& data)
+{
+  stlplus::restore_smart_ptr_intrusive(context, data, restore_counted_string);
+}
+
+typedef std::pair<counted_ptr,counted_ptr> counted_ptr_pair;
+
+void dump_counted_ptr_pair(stlplus::dump_context& context, const counted_ptr_pair& data)
+{
+  stlplus::dump_pair(context, data, dump_counted_ptr, dump_counted_ptr);
+}
+
+void restore_counted_ptr_pair(stlplus::restore_context& context, counted_ptr_pair& data)
+{
+  stlplus::restore_pair(context, data, restore_counted_ptr, restore_counted_ptr);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 static const char* DATA = "data.tmp";
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -152,6 +203,103 @@ int main (int argc, char* argv[])
         errors++;
       }
     }
+#ifdef STLPLUS_HAS_CXX11
+    // make_smart puts the object in the same allocation as the holder
+    string_ptr m1 = stlplus::make_smart<std::string>(3, 'x');
+    print("created m1 = make_smart(3,'x')", m1);
+    if (!m1 || *m1 != "xxx" || m1.alias_count() != 1)
+    {
+      std::cerr << "error: make_smart did not construct the object" << std::endl;
+      errors++;
+    }
+    string_ptr m2 = m1;
+    // replacing the embedded object is seen through every alias
+    m2 = new std::string("yyy");
+    print("m2 = new string(yyy)", m2);
+    if (!m1.aliases(m2) || *m1 != "yyy")
+    {
+      std::cerr << "error: m1 does not see the replacement made through m2" << std::endl;
+      errors++;
+    }
+    m2 = stlplus::make_smart<std::string>("zzz");
+    m2.make_unique();
+    m2.clear();
+    if (!m2.null())
+    {
+      std::cerr << "error: m2 not null after clear" << std::endl;
+      errors++;
+    }
+    string_ptr_pair mp = std::make_pair(m1, m1);
+    stlplus::dump_to_file(mp, DATA, dump_string_ptr_pair, 0);
+    string_ptr_pair mr(stlplus::make_smart<std::string>(), stlplus::make_smart<std::string>());
+    stlplus::restore_from_file(DATA, mr, restore_string_ptr_pair, 0);
+    print("mr = dump/restore(make_pair(m1,m1))", mr);
+    if (!mr.first.aliases(mr.second) || *mr.first != "yyy")
+    {
+      std::cerr << "error: restored make_smart pair is wrong" << std::endl;
+      errors++;
+    }
+    stlplus::smart_ptr_nocopy<std::vector<int> > n1 = stlplus::make_smart_nocopy<std::vector<int> >(10, 1);
+    if (n1->size() != 10)
+    {
+      std::cerr << "error: make_smart_nocopy did not construct the object" << std::endl;
+      errors++;
+    }
+#endif
+
+    // smart_ptr_intrusive keeps the count in the object
+    counted_ptr i0;
+    if (i0 || i0.alias_count() != 0)
+    {
+      std::cerr << "error: default smart_ptr_intrusive not null" << std::endl;
+      errors++;
+    }
+    counted_ptr i1(new counted_string("one"));
+    counted_ptr i2(i1);
+    // a raw pointer to a managed object becomes another alias
+    counted_ptr i3(i1.pointer());
+    std::cout << "created i1, i2, i3 aliases = " << i1.alias_count() << std::endl;
+    if (!i1.aliases(i2) || !i1.aliases(i3) || i1.alias_count() != 3)
+    {
+      std::cerr << "error: i1, i2 and i3 should be three aliases" << std::endl;
+      errors++;
+    }
+    // unlike smart_ptr, resetting one alias does not change the others
+    i3 = new counted_string("three");
+    i2.clear();
+    if (i1->m_value != "one" || i1.alias_count() != 1 || !i2.null() || i3->m_value != "three")
+    {
+      std::cerr << "error: resetting i2 and i3 affected i1" << std::endl;
+      errors++;
+    }
+    i1 = i1;
+    i2.copy(i1);
+    if (i1.aliases(i2) || i2->m_value != "one" || i2.alias_count() != 1)
+    {
+      std::cerr << "error: i2 is not a unique copy of i1" << std::endl;
+      errors++;
+    }
+    try
+    {
+      *i0;
+      std::cerr << "error: null smart_ptr_intrusive dereferenced" << std::endl;
+      errors++;
+    }
+    catch(stlplus::null_dereference&)
+    {
+    }
+    counted_ptr_pair ip = std::make_pair(i1, i1);
+    stlplus::dump_to_file(ip, DATA, dump_counted_ptr_pair, 0);
+    counted_ptr_pair ir;
+    stlplus::restore_from_file(DATA, ir, restore_counted_ptr_pair, 0);
+    std::cout << "ir = dump/restore(make_pair(i1,i1)) = "
+              << stlplus::smart_ptr_intrusive_to_string(ir.first, string_of_counted) << " aliases = " << ir.first.alias_count() << std::endl;
+    if (!ir.first.aliases(ir.second) || ir.first.alias_count() != 2 || ir.first->m_value != "one")
+    {
+      std::cerr << "error: restored intrusive pair is wrong" << std::endl;
+      errors++;
+    }
+
     if (errors == 0)
       std::cerr << "No errors were found - test SUCCEEDED" << std::endl;
     else
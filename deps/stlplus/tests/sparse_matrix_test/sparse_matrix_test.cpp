@@ -0,0 +1,218 @@
+#include <string>
+#include <cstdlib>
+#include "persistent_sparse_matrix.hpp"
+#include "persistent_float.hpp"
+#include "persistent_shortcuts.hpp"
+#include "print_sparse_matrix.hpp"
+#include "print_float.hpp"
+#include "file_system.hpp"
+#include "build.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+#define R 200
+#define C 300
+#define DATA "sparse_matrix_test.tmp"
+#define MASTER "sparse_matrix_test.dump"
+
+////////////////////////////////////////////////////////////////////////////////
+
+typedef stlplus::sparse_matrix<double> sparse;
+
+void print_value(std::ostream& str, const double& value)
+{
+  stlplus::print_double(str, value);
+}
+
+std::ostream& operator<< (std::ostream& str, const sparse& data)
+{
+  stlplus::print_sparse_matrix(str, data, print_value);
+  return str;
+}
+
+void dump_sparse(stlplus::dump_context& context, const sparse& data)
+{
+  stlplus::dump_sparse_matrix(context, data, stlplus::dump_double);
+}
+
+void restore_sparse(stlplus::restore_context& context, sparse& data)
+{
+  stlplus::restore_sparse_matrix(context, data, stlplus::restore_double);
+}
+
+// a corrupt dump header giving the number of rows, columns and nonzeros
+void dump_header(stlplus::dump_context& context, const std::vector<unsigned>& header)
+{
+  for (unsigned i = 0; i < header.size(); i++)
+    stlplus::dump_unsigned(context, header[i]);
+}
+
+bool corrupt_rejected(unsigned rows, unsigned cols, unsigned nonzeros)
+{
+  std::vector<unsigned> header;
+  header.push_back(rows);
+  header.push_back(cols);
+  header.push_back(nonzeros);
+  std::string dumped;
+  stlplus::dump_to_string(header,dumped,dump_header,0);
+  try
+  {
+    sparse restored;
+    stlplus::restore_from_string(dumped,restored,restore_sparse,0);
+  }
+  catch(stlplus::persistent_restore_failed&)
+  {
+    return true;
+  }
+  return false;
+}
+
+bool compare(const sparse& left, const sparse& right)
+{
+  if (left.rows() != right.rows() || left.columns() != right.columns() ||
+      left.row_starts() != right.row_starts() || left.column_indices() != right.column_indices() ||
+      left.values() != right.values())
+  {
+    std::cerr << "ERROR: sparse matrices are different" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int main(void)
+{
+  bool result = true;
+  std::cerr << stlplus::build() << " testing " << R << "*" << C << " sparse matrix" << std::endl;
+
+  try
+  {
+    // build the sample data structure from entries in no particular order,
+    // some of them for the same element, about one element in fifty stored
+    std::cerr << "building" << std::endl;
+    sparse::entry_vector entries;
+    stlplus::matrix<double> dense(R, C, 0.0);
+    unsigned random = 1;
+    for (unsigned i = 0; i < R*C/50; i++)
+    {
+      random = random * 1664525 + 1013904223;
+      unsigned r = (random >> 8) % R;
+      unsigned c = (random >> 4) % C;
+      double value = (double)(i % 17) + 1.0;
+      entries.push_back(sparse::entry_type(r, c, value));
+      dense(r,c) += value;
+    }
+    sparse data(R, C, entries);
+    std::cerr << "stored " << data.nonzeros() << " of " << entries.size() << " entries" << std::endl;
+
+    // elements and conversions match the dense equivalent
+    for (unsigned r = 0; r < R; r++)
+      for (unsigned c = 0; c < C; c++)
+        if (data(r,c) != dense(r,c))
+        {
+          std::cerr << "ERROR: element (" << r << "," << c << ") is " << data(r,c) << " should be " << dense(r,c) << std::endl;
+          result = false;
+        }
+    result &= compare(data, sparse(dense));
+    result &= compare(data, sparse(R, C, data.entries()));
+    stlplus::matrix<double> converted = data.to_matrix();
+    for (unsigned r = 0; r < R; r++)
+      for (unsigned c = 0; c < C; c++)
+        if (converted(r,c) != dense(r,c))
+        {
+          std::cerr << "ERROR: converted element (" << r << "," << c << ") is wrong" << std::endl;
+          result = false;
+        }
+
+    // the product with a vector matches the dense product, single and multi-threaded
+    std::vector<double> x(C), expected, y1, y4;
+    for (unsigned c = 0; c < C; c++)
+      x[c] = (double)(c % 5);
+    stlplus::gemv(1.0, dense, x, 0.0, expected);
+    stlplus::multiply(data, x, y1, 1);
+    stlplus::multiply(data, x, y4, 4);
+    if (y1 != expected || y4 != expected)
+    {
+      std::cerr << "ERROR: sparse matrix-vector product is wrong" << std::endl;
+      result = false;
+    }
+
+    // bad input is rejected without changing the matrix
+    try
+    {
+      entries.push_back(sparse::entry_type(R, 0, 1.0));
+      data.build(R, C, entries);
+      std::cerr << "ERROR: out of range entry did not throw" << std::endl;
+      result = false;
+    }
+    catch(std::out_of_range&)
+    {
+    }
+    try
+    {
+      std::vector<unsigned> starts(R+1, 0), columns(1, 0);
+      std::vector<double> values(1, 1.0);
+      data.adopt(R, C, starts, columns, values);
+      std::cerr << "ERROR: inconsistent arrays did not throw" << std::endl;
+      result = false;
+    }
+    catch(std::invalid_argument&)
+    {
+    }
+    result &= compare(data, sparse(dense));
+
+    sparse small(3, 4, sparse::entry_vector(1, sparse::entry_type(1, 2, 2.5)));
+    std::cerr << "small = " << small << std::endl;
+    if (small.nonzeros() != 1 || small(1,2) != 2.5 || small(2,1) != 0.0)
+    {
+      std::cerr << "ERROR: small sparse matrix is wrong" << std::endl;
+      result = false;
+    }
+
+    // now dump to the file
+    std::cerr << "dumping" << std::endl;
+    stlplus::dump_to_file(data,DATA,dump_sparse,0);
+
+    // now restore the same file and compare
+    std::cerr << "restoring" << std::endl;
+    sparse restored;
+    stlplus::restore_from_file(DATA,restored,restore_sparse,0);
+    result &= compare(data,restored);
+
+    // compare with the master dump if present
+    if (!stlplus::file_exists(MASTER))
+      stlplus::file_copy(DATA,MASTER);
+    else
+    {
+      std::cerr << "restoring master" << std::endl;
+      sparse master;
+      stlplus::restore_from_file(MASTER,master,restore_sparse,0);
+      result &= compare(data,master);
+    }
+
+    // sizes from a corrupt dump are rejected before anything is sized from them
+    std::cerr << "restoring corrupt dumps" << std::endl;
+    if (!corrupt_rejected(~0u, 1, 0) || !corrupt_rejected(3, 2, 7) || !corrupt_rejected(0, 5, 1))
+    {
+      std::cerr << "ERROR: corrupt sparse matrix restored" << std::endl;
+      result = false;
+    }
+  }
+  catch(std::exception& except)
+  {
+    std::cerr << "caught standard exception " << except.what() << std::endl;
+    result = false;
+  }
+  catch(...)
+  {
+    std::cerr << "caught unknown exception" << std::endl;
+    result = false;
+  }
+
+  if (!result)
+    std::cerr << "test failed" << std::endl;
+  else
+    std::cerr << "test passed" << std::endl;
+  return result ? 0 : 1;
+}
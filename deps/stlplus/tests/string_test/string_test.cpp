@@ -5,6 +5,8 @@
 #include "string_float.hpp"
 #include "string_int.hpp"
 #include "version.hpp"
+#include <sstream>
+#include <fstream>
 
 #define DATA "string_test.tmp"
 #define MASTER "string_test.dump"
@@ -66,6 +68,176 @@ int main(int argc, char* argv[])
 
     // short-term tests just to check new features
 
+    // several dumps on one device, including a string larger than the context buffers,
+    // each restore must leave the device positioned just after its own data
+    std::string large;
+    for (unsigned i = 0; i < 200000; i++)
+      large += (char)(i % 251);
+    std::stringstream device(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+    stlplus::dump_to_device(original, device, stlplus::dump_string, 0);
+    stlplus::dump_to_device(large, device, stlplus::dump_string, 0);
+    device << "trailer";
+    std::string restored_original;
+    std::string restored_large;
+    std::string trailer;
+    stlplus::restore_from_device(device, restored_original, stlplus::restore_string, 0);
+    stlplus::restore_from_device(device, restored_large, stlplus::restore_string, 0);
+    device >> trailer;
+    if (restored_original != original || restored_large != large || trailer != "trailer")
+    {
+      std::cerr << "ERROR: consecutive restores from one device are wrong" << std::endl;
+      result = false;
+    }
+
+    // a truncated dump must fail cleanly
+    std::string truncated;
+    stlplus::dump_to_string(large, truncated, stlplus::dump_string, 0);
+    truncated.resize(truncated.size() / 2);
+    try
+    {
+      stlplus::restore_from_string(truncated, restored_large, stlplus::restore_string, 0);
+      std::cerr << "ERROR: restore of truncated dump succeeded" << std::endl;
+      result = false;
+    }
+    catch(stlplus::persistent_restore_failed&)
+    {
+    }
+
+    // restore in place from a memory-mapped file, both the small and the large string
+    std::string mapped;
+    stlplus::restore_from_mapped_file(DATA, mapped, stlplus::restore_string, 0);
+    if (mapped != original)
+    {
+      std::cerr << "ERROR: restore from mapped file is wrong" << std::endl;
+      result = false;
+    }
+    stlplus::dump_to_file(large, DATA, stlplus::dump_string, 0);
+    stlplus::restore_from_mapped_file(DATA, mapped, stlplus::restore_string, 0);
+    if (mapped != large)
+    {
+      std::cerr << "ERROR: restore of large string from mapped file is wrong" << std::endl;
+      result = false;
+    }
+
+    // an empty file has nothing to map and must fail cleanly
+    std::ofstream empty(DATA);
+    empty.close();
+    try
+    {
+      stlplus::restore_from_mapped_file(DATA, mapped, stlplus::restore_string, 0);
+      std::cerr << "ERROR: restore from empty mapped file succeeded" << std::endl;
+      result = false;
+    }
+    catch(stlplus::persistent_restore_failed&)
+    {
+    }
+
+    // framed dumps, consecutive on one device with a trailer after them
+    std::stringstream framed(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+    {
+      stlplus::dump_context context(framed, stlplus::PersistentVersion, true);
+      stlplus::dump_string(context, large);
+    }
+    {
+      // a flush part way through must not stop the restore reading the rest
+      stlplus::dump_context context(framed, stlplus::PersistentVersion, true);
+      stlplus::dump_string(context, original);
+      context.flush();
+      stlplus::dump_string(context, large);
+    }
+    framed << "trailer";
+    std::string framed_dump = framed.str();
+    trailer.erase();
+    restored_large.erase();
+    {
+      stlplus::restore_context context(framed);
+      if (!context.framed())
+      {
+        std::cerr << "ERROR: framed dump not detected" << std::endl;
+        result = false;
+      }
+      stlplus::restore_string(context, restored_large);
+    }
+    {
+      stlplus::restore_context context(framed);
+      stlplus::restore_string(context, restored_original);
+      stlplus::restore_string(context, mapped);
+    }
+    framed >> trailer;
+    if (restored_large != large || restored_original != original || mapped != large || trailer != "trailer")
+    {
+      std::cerr << "ERROR: consecutive framed restores from one device are wrong" << std::endl;
+      result = false;
+    }
+
+    // a restore that stops at a flush leaves the device after it rather than waiting
+    // for the end frame, which the writer only sends once it has had a reply
+    std::stringstream exchange(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+    {
+      stlplus::dump_context request(exchange, stlplus::PersistentVersion, true);
+      stlplus::dump_string(request, original);
+      request.flush();
+      restored_original.erase();
+      {
+        stlplus::restore_context reply(exchange);
+        stlplus::restore_string(reply, restored_original);
+      }
+      if (restored_original != original || !exchange.good())
+      {
+        std::cerr << "ERROR: framed restore read past a flush" << std::endl;
+        result = false;
+      }
+    }
+
+    // a framed dump restores from memory too and one corrupt byte must be detected
+    stlplus::restore_from_string(framed_dump, restored_large, stlplus::restore_string, 0);
+    if (restored_large != large)
+    {
+      std::cerr << "ERROR: framed restore from memory is wrong" << std::endl;
+      result = false;
+    }
+    framed_dump[framed_dump.size() / 4] ^= 0x10;
+    try
+    {
+      stlplus::restore_from_string(framed_dump, restored_large, stlplus::restore_string, 0);
+      std::cerr << "ERROR: restore of corrupt framed dump succeeded" << std::endl;
+      result = false;
+    }
+    catch(stlplus::persistent_restore_failed& except)
+    {
+      std::cerr << "corrupt framed dump: " << except.what() << std::endl;
+    }
+
+    // compressed dumps at the fastest and smallest levels, large enough to be compressed
+    // by threads and starting with random data that does not compress at all
+    std::string redundant;
+    unsigned random = 12345;
+    for (unsigned i = 0; i < 100000; i++)
+    {
+      random = random * 1103515245 + 12345;
+      redundant += (char)(random >> 16);
+    }
+    for (unsigned i = 0; i < 600000; i++)
+      redundant += stlplus::int_to_string(i % 1000) + ",";
+    for (unsigned level = 1; level <= 9; level += 8)
+    {
+      std::string compressed;
+      stlplus::dump_to_string(redundant, compressed, stlplus::dump_string, 0, level);
+      std::cerr << "compression level " << level << ": " << redundant.size() << " to " << compressed.size() << " bytes" << std::endl;
+      if (compressed.size() > redundant.size() / 2)
+      {
+        std::cerr << "ERROR: compressed dump is too large" << std::endl;
+        result = false;
+      }
+      restored.erase();
+      stlplus::restore_from_string(compressed, restored, stlplus::restore_string, 0);
+      if (restored != redundant)
+      {
+        std::cerr << "ERROR: restore of compressed dump is wrong" << std::endl;
+        result = false;
+      }
+    }
+
     // conversions to/from double
     std::string version = stlplus::version();
     double double_version = stlplus::string_to_double(version);
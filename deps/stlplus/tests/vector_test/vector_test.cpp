@@ -0,0 +1,370 @@
+#include "persistence.hpp"
+#include "file_system.hpp"
+#include "build.hpp"
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <limits.h>
+
+#define NUMBER 1000
+#define DATA "vector_test.tmp"
+#define MASTER "vector_test.dump"
+
+////////////////////////////////////////////////////////////////////////////////
+// vectors of basic types are dumped as a raw block, other vectors one element at a time
+
+typedef std::vector<int> int_vector;
+typedef std::vector<double> double_vector;
+typedef std::vector<std::string> string_vector;
+
+struct sample
+{
+  int_vector m_ints;
+  double_vector m_doubles;
+  string_vector m_strings;
+  // dumped with a non-standard element function so the raw format is not used
+  int_vector m_custom;
+};
+
+void dump_int_offset(stlplus::dump_context& context, const int& data)
+{
+  stlplus::dump_int(context, data + 1);
+}
+
+void restore_int_offset(stlplus::restore_context& context, int& data)
+{
+  stlplus::restore_int(context, data);
+  data -= 1;
+}
+
+void dump_sample(stlplus::dump_context& context, const sample& data)
+{
+  stlplus::dump_vector(context, data.m_ints, stlplus::dump_int);
+  stlplus::dump_vector(context, data.m_doubles, stlplus::dump_double);
+  stlplus::dump_vector(context, data.m_strings, stlplus::dump_string);
+  stlplus::dump_vector(context, data.m_custom, dump_int_offset);
+}
+
+void restore_sample(stlplus::restore_context& context, sample& data)
+{
+  stlplus::restore_vector(context, data.m_ints, stlplus::restore_int);
+  stlplus::restore_vector(context, data.m_doubles, stlplus::restore_double);
+  stlplus::restore_vector(context, data.m_strings, stlplus::restore_string);
+  stlplus::restore_vector(context, data.m_custom, restore_int_offset);
+}
+
+// the segments are dumped by four threads and restored by three
+void dump_sample_parallel(stlplus::dump_context& context, const sample& data)
+{
+  stlplus::dump_parallel(context, data.m_ints, stlplus::dump_int, 4);
+  stlplus::dump_parallel(context, data.m_doubles, stlplus::dump_double, 4);
+  stlplus::dump_parallel(context, data.m_strings, stlplus::dump_string, 4);
+  stlplus::dump_parallel(context, data.m_custom, dump_int_offset, 4);
+}
+
+void restore_sample_parallel(stlplus::restore_context& context, sample& data)
+{
+  stlplus::restore_parallel(context, data.m_ints, stlplus::restore_int, 3);
+  stlplus::restore_parallel(context, data.m_doubles, stlplus::restore_double, 3);
+  stlplus::restore_parallel(context, data.m_strings, stlplus::restore_string, 3);
+  stlplus::restore_parallel(context, data.m_custom, restore_int_offset, 3);
+}
+
+bool compare(const sample& left, const sample& right)
+{
+  bool result = true;
+  if (left.m_ints != right.m_ints)
+  {
+    std::cerr << "int vectors are different" << std::endl;
+    result = false;
+  }
+  if (left.m_doubles != right.m_doubles)
+  {
+    std::cerr << "double vectors are different" << std::endl;
+    result = false;
+  }
+  if (left.m_strings != right.m_strings)
+  {
+    std::cerr << "string vectors are different" << std::endl;
+    result = false;
+  }
+  if (left.m_custom != right.m_custom)
+  {
+    std::cerr << "custom vectors are different" << std::endl;
+    result = false;
+  }
+  return result;
+}
+
+void restore_int_vector_parallel(stlplus::restore_context& context, int_vector& data)
+{
+  stlplus::restore_parallel(context, data, stlplus::restore_int, 3);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// restore a hand-made raw block with a different element size and byte order
+
+void restore_int_vector(stlplus::restore_context& context, int_vector& data)
+{
+  stlplus::restore_vector(context, data, stlplus::restore_int);
+}
+
+bool check_converted(const std::string& dumped, const int_vector& expected)
+{
+  int_vector restored;
+  stlplus::restore_from_string(dumped, restored, restore_int_vector, 0);
+  return restored == expected;
+}
+
+bool converted_rejected(const std::string& dumped)
+{
+  try
+  {
+    int_vector restored;
+    stlplus::restore_from_string(dumped, restored, restore_int_vector, 0);
+  }
+  catch(stlplus::persistent_restore_failed&)
+  {
+    return true;
+  }
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// integers are dumped one at a time by non-standard element functions, so
+// each is written in the integer format of the version being dumped
+
+typedef std::vector<long> long_vector;
+
+void dump_long_element(stlplus::dump_context& context, const long& data)
+{
+  stlplus::dump_long(context, data);
+}
+
+void restore_long_element(stlplus::restore_context& context, long& data)
+{
+  stlplus::restore_long(context, data);
+}
+
+void restore_int_element(stlplus::restore_context& context, int& data)
+{
+  stlplus::restore_int(context, data);
+}
+
+void restore_long_vector(stlplus::restore_context& context, long_vector& data)
+{
+  stlplus::restore_vector(context, data, restore_long_element);
+}
+
+void restore_int_element_vector(stlplus::restore_context& context, int_vector& data)
+{
+  stlplus::restore_vector(context, data, restore_int_element);
+}
+
+std::string dump_longs(const long_vector& data, unsigned char version)
+{
+  std::ostringstream output(std::ios_base::out | std::ios_base::binary);
+  {
+    stlplus::dump_context context(output, version);
+    stlplus::dump_vector(context, data, dump_long_element);
+    context.flush();
+  }
+  return output.str();
+}
+
+bool check_longs(const long_vector& data, unsigned char version)
+{
+  long_vector restored;
+  stlplus::restore_from_string(dump_longs(data, version), restored, restore_long_vector, 0);
+  return restored == data;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int main(void)
+{
+  bool result = true;
+  std::cerr << stlplus::build() << " testing " << NUMBER << " vector elements" << std::endl;
+
+  try
+  {
+    // build the sample data structure
+    std::cerr << "building" << std::endl;
+    sample data;
+    for (unsigned k = 0; k < NUMBER; k++)
+    {
+      int value = (int)(k * 2654435761u);
+      data.m_ints.push_back(value);
+      data.m_doubles.push_back(value / 7.0);
+      data.m_strings.push_back(std::string(k % 17, (char)('a' + k % 26)));
+      data.m_custom.push_back(-value);
+    }
+    std::cerr << "dumping" << std::endl;
+    stlplus::dump_to_file(data,DATA,dump_sample,0);
+
+    // now restore the same file and compare
+    std::cerr << "restoring" << std::endl;
+    sample restored;
+    stlplus::restore_from_file(DATA,restored,restore_sample,0);
+    result &= compare(data,restored);
+
+    // the per-element format of version 2 is still written on request and restored
+    std::cerr << "restoring version 2" << std::endl;
+    std::ostringstream old_output(std::ios_base::out | std::ios_base::binary);
+    {
+      stlplus::dump_context context(old_output, 2);
+      dump_sample(context, data);
+      context.flush();
+    }
+    sample old_restored;
+    stlplus::restore_from_string(old_output.str(),old_restored,restore_sample,0);
+    result &= compare(data,old_restored);
+
+    // compare with the master dump if present
+    if (!stlplus::file_exists(MASTER))
+      stlplus::file_copy(DATA,MASTER);
+    else
+    {
+      std::cerr << "restoring master" << std::endl;
+      sample master;
+      stlplus::restore_from_file(MASTER,master,restore_sample,0);
+      result &= compare(data,master);
+    }
+
+    // dump and restore in parallel segments
+    std::cerr << "restoring parallel" << std::endl;
+    std::string parallel;
+    stlplus::dump_to_string(data,parallel,dump_sample_parallel,0);
+    sample parallel_restored;
+    stlplus::restore_from_string(parallel,parallel_restored,restore_sample_parallel,0);
+    result &= compare(data,parallel_restored);
+
+    // a segment index whose byte counts wrap around to zero is rejected
+    std::ostringstream corrupt_output(std::ios_base::out | std::ios_base::binary);
+    {
+      stlplus::dump_context context(corrupt_output);
+      stlplus::dump_unsigned(context, 2);
+      stlplus::dump_size_t(context, 0);
+      stlplus::dump_size_t(context, ~(size_t)0);
+      stlplus::dump_size_t(context, 1);
+      stlplus::dump_size_t(context, 1);
+      context.flush();
+    }
+    try
+    {
+      int_vector corrupt_restored;
+      stlplus::restore_from_string(corrupt_output.str(), corrupt_restored, restore_int_vector_parallel, 0);
+      std::cerr << "corrupt segment index restored" << std::endl;
+      result = false;
+    }
+    catch(stlplus::persistent_restore_failed&)
+    {
+    }
+
+    // integers either side of each varint byte boundary survive both integer formats
+    std::cerr << "restoring integers" << std::endl;
+    long_vector longs;
+    for (unsigned bits = 0; bits < sizeof(long) * 8 - 1; bits++)
+    {
+      long boundary = 1L << bits;
+      longs.push_back(boundary - 1);
+      longs.push_back(boundary);
+      longs.push_back(-boundary);
+      longs.push_back(-boundary - 1);
+    }
+    longs.push_back(LONG_MAX);
+    longs.push_back(LONG_MIN);
+    if (!check_longs(longs, 3) || !check_longs(longs, 4))
+    {
+      std::cerr << "integers restored wrongly" << std::endl;
+      result = false;
+    }
+    // small integers take one byte each rather than two
+    long_vector small;
+    for (long i = -64; i < 64; i++)
+      small.push_back(i);
+    if (dump_longs(small, 4).size() >= dump_longs(small, 3).size())
+    {
+      std::cerr << "varint integers are not smaller" << std::endl;
+      result = false;
+    }
+    // a value that does not fit the type restored into is an error
+    long_vector too_big(1, (long)INT_MAX + 1);
+    if (sizeof(long) > sizeof(int))
+    {
+      try
+      {
+        int_vector restored_int;
+        stlplus::restore_from_string(dump_longs(too_big, 4), restored_int, restore_int_element_vector, 0);
+        std::cerr << "overflowing integer restored" << std::endl;
+        result = false;
+      }
+      catch(stlplus::persistent_restore_failed&)
+      {
+      }
+    }
+
+    // raw blocks written by another machine - version 3, size 3, then the layout byte
+    // 2-byte big-endian elements are sign extended
+    std::cerr << "restoring converted blocks" << std::endl;
+    const char big_short[] = {3, 1, 3, (char)0x82, 0x00, 0x01, (char)0xff, (char)0xfe, 0x7f, (char)0xff};
+    int_vector expected;
+    expected.push_back(1);
+    expected.push_back(-2);
+    expected.push_back(32767);
+    if (!check_converted(std::string(big_short, sizeof(big_short)), expected))
+    {
+      std::cerr << "big-endian short elements restored wrongly" << std::endl;
+      result = false;
+    }
+    // 16-byte little-endian elements are truncated if the extra bytes are only sign extension
+    std::string wide("\x03\x01\x02\x10", 4);
+    wide += std::string("\xfe", 1) + std::string(15, '\xff');
+    wide += std::string("\x05", 1) + std::string(15, '\0');
+    expected.clear();
+    expected.push_back(-2);
+    expected.push_back(5);
+    if (!check_converted(wide, expected))
+    {
+      std::cerr << "wide elements restored wrongly" << std::endl;
+      result = false;
+    }
+    // but fail if they do not fit
+    wide[wide.size() - 1] = 1;
+    try
+    {
+      check_converted(wide, expected);
+      std::cerr << "overflowing element restored" << std::endl;
+      result = false;
+    }
+    catch(stlplus::persistent_restore_failed&)
+    {
+    }
+    // and an element size of zero or one too wide to check is rejected before the vector is sized
+    const char empty_elements[] = {3, 4, (char)0xff, (char)0xff, (char)0xff, (char)0xff, (char)0x80};
+    const char wider_elements[] = {3, 1, 1, 0x11};
+    if (!converted_rejected(std::string(empty_elements, sizeof(empty_elements))) ||
+        !converted_rejected(std::string(wider_elements, sizeof(wider_elements))))
+    {
+      std::cerr << "bad element size restored" << std::endl;
+      result = false;
+    }
+  }
+  catch(std::exception& except)
+  {
+    std::cerr << "caught standard exception " << except.what() << std::endl;
+    result = false;
+  }
+  catch(...)
+  {
+    std::cerr << "caught unknown exception" << std::endl;
+    result = false;
+  }
+
+  if (!result)
+    std::cerr << "test failed" << std::endl;
+  else
+    std::cerr << "test passed" << std::endl;
+  return result ? 0 : 1;
+}